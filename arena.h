@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include <sys/mman.h>
+
+#include "matrix.h"
+
+// 测试缓冲区的内存池：一次预留所需的最大容量，用大页支撑并预先触摸所有页，
+// 之后每个规模只在池内按64字节对齐顺序切分(reset后重新切分)，
+// 计时不再包含新分配内存的缺页中断，大数组的结果也不再混入4KB页的TLB缺失
+//
+// 页面来源按请求依次回退：1GB大页(MAP_HUGETLB) -> 2MB大页(MAP_HUGETLB) -> 透明大页(madvise) -> 4KB页。
+// MAP_HUGETLB需要事先在/proc/sys/vm/nr_hugepages(或hugepages-1048576kB)中预留大页；
+// 透明大页需要/sys/kernel/mm/transparent_hugepage/enabled为always或madvise。
+// 请求4KB页时对区域设置MADV_NOHUGEPAGE，保证对比时确实是4KB页
+
+enum PageBacking {
+    PAGES_4K,
+    PAGES_THP,   // 透明大页，由内核尽量用2MB页支撑
+    PAGES_2M,    // hugetlbfs 2MB大页
+    PAGES_1G     // hugetlbfs 1GB大页
+};
+
+inline const char* page_backing_name(PageBacking backing) {
+    switch (backing) {
+        case PAGES_THP: return "thp";
+        case PAGES_2M: return "2m";
+        case PAGES_1G: return "1g";
+        default: return "4k";
+    }
+}
+
+// 解析 4k|thp|2m|1g，无法识别时返回false
+inline bool parse_page_backing(const char* text, PageBacking& backing) {
+    for (PageBacking b : {PAGES_4K, PAGES_THP, PAGES_2M, PAGES_1G}) {
+        if (strcmp(text, page_backing_name(b)) == 0) {
+            backing = b;
+            return true;
+        }
+    }
+    return false;
+}
+
+const size_t HUGE_2M = (size_t)2 << 20;
+const size_t HUGE_1G = (size_t)1 << 30;
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+// /proc/self/smaps中包含addr的映射里由透明大页支撑的字节数
+inline size_t thp_backed_bytes(const void* addr) {
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    uintptr_t target = (uintptr_t)addr;
+    bool inside = false;
+    while (std::getline(smaps, line)) {
+        unsigned long begin, end;
+        if (sscanf(line.c_str(), "%lx-%lx ", &begin, &end) == 2 && line.find(':') > line.find(' ')) {
+            inside = target >= begin && target < end;
+        } else if (inside && line.compare(0, 14, "AnonHugePages:") == 0) {
+            return (size_t)atoll(line.c_str() + 14) << 10;
+        }
+    }
+    return 0;
+}
+
+class BufferArena {
+public:
+    BufferArena(size_t capacity, PageBacking requested) : requested_(requested) {
+        if (capacity == 0) capacity = CACHE_LINE;
+        capacity_ = capacity;
+        if (requested == PAGES_1G && map_hugetlb(HUGE_1G, 30)) return;
+        if (requested >= PAGES_2M && map_hugetlb(HUGE_2M, 21)) return;
+        map_anonymous(requested != PAGES_4K);
+    }
+
+    ~BufferArena() {
+        if (mapping_ != nullptr) munmap(mapping_, mapping_bytes_);
+    }
+
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+
+    // 实际得到的页面；请求透明大页但内核没有用大页支撑时为PAGES_4K
+    PageBacking backing() const { return backing_; }
+    PageBacking requested() const { return requested_; }
+    size_t capacity() const { return capacity_; }
+    size_t used() const { return offset_; }
+
+    // 顺序切出count个double，64字节对齐；容量不足时抛出bad_alloc
+    double* alloc(size_t count) {
+        size_t bytes = round_up(count * sizeof(double));
+        if (offset_ + bytes > capacity_) throw std::bad_alloc();
+        double* p = (double*)(base_ + offset_);
+        offset_ += bytes;
+        return p;
+    }
+
+    // 丢弃全部切分，内存(及已建立的页表项)保留给下一个规模使用
+    void reset() { offset_ = 0; }
+
+    std::string summary() const {
+        char buffer[160];
+        if (backing_ == PAGES_THP || (requested_ == PAGES_THP && backing_ == PAGES_4K)) {
+            snprintf(buffer, sizeof(buffer), "请求%s, 实际%s(透明大页%.0f%%), 容量%.1fMB", page_backing_name(requested_),
+                     page_backing_name(backing_), 100.0 * thp_bytes_ / mapping_bytes_, capacity_ / 1048576.0);
+        } else {
+            snprintf(buffer, sizeof(buffer), "请求%s, 实际%s, 容量%.1fMB", page_backing_name(requested_),
+                     page_backing_name(backing_), capacity_ / 1048576.0);
+        }
+        return buffer;
+    }
+
+    // 每段切分的大小向上取整到缓存行，预估容量时对每个缓冲区使用同样的取整
+    static size_t round_up(size_t bytes) {
+        bytes = (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+        return bytes == 0 ? CACHE_LINE : bytes;
+    }
+
+private:
+    bool map_hugetlb(size_t page, int shift) {
+        size_t bytes = (capacity_ + page - 1) / page * page;
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+        if (p == MAP_FAILED) return false;
+        mapping_ = p;
+        mapping_bytes_ = bytes;
+        base_ = (char*)p;
+        backing_ = page == HUGE_1G ? PAGES_1G : PAGES_2M;
+        prefault();
+        return true;
+    }
+
+    // 普通匿名映射；透明大页要求区域按2MB对齐，多映射2MB后把起点对齐
+    void map_anonymous(bool huge) {
+        mapping_bytes_ = (capacity_ + HUGE_2M - 1) / HUGE_2M * HUGE_2M + HUGE_2M;
+        void* p = mmap(nullptr, mapping_bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) throw std::bad_alloc();
+        mapping_ = p;
+        base_ = (char*)(((uintptr_t)p + HUGE_2M - 1) / HUGE_2M * HUGE_2M);
+        madvise(mapping_, mapping_bytes_, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+        prefault();
+        thp_bytes_ = huge ? thp_backed_bytes(base_) : 0;
+        backing_ = thp_bytes_ > 0 ? PAGES_THP : PAGES_4K;
+    }
+
+    // 预先写入每一页，缺页中断和清零都发生在计时之前
+    void prefault() {
+        memset(base_, 0, capacity_);
+    }
+
+    PageBacking requested_;
+    PageBacking backing_ = PAGES_4K;
+    void* mapping_ = nullptr;
+    size_t mapping_bytes_ = 0;
+    char* base_ = nullptr;
+    size_t capacity_ = 0;
+    size_t offset_ = 0;
+    size_t thp_bytes_ = 0;
+};
+
+// 从内存池中分配连续布局的矩阵，填充部分清零；free_matrix不会释放它
+inline Matrix arena_matrix(BufferArena& arena, int n) {
+    Matrix m;
+    m.n = n;
+    m.layout = LAYOUT_CONTIGUOUS;
+    m.ld = padded_ld(n);
+    m.data = arena.alloc((size_t)n * m.ld);
+    m.external = true;
+    memset(m.data, 0, (size_t)n * m.ld * sizeof(double));
+    return m;
+}
+
+// 连续布局从内存池分配；旧布局仍逐行new(它要对比的正是原始的分配方式)，用free_matrix释放
+inline Matrix alloc_matrix(BufferArena& arena, int n, MatrixLayout layout) {
+    return layout == LAYOUT_LEGACY ? alloc_matrix(n, layout) : arena_matrix(arena, n);
+}
+
+// n x n连续布局矩阵在内存池中占用的字节数
+inline size_t arena_matrix_bytes(int n) {
+    return BufferArena::round_up((size_t)n * padded_ld(n) * sizeof(double));
+}
+
+// count个double在内存池中占用的字节数
+inline size_t arena_array_bytes(size_t count) {
+    return BufferArena::round_up(count * sizeof(double));
+}
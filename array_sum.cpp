@@ -1,20 +1,28 @@
 #include <iostream>
 #include <fstream>
-#include <chrono>
 #include <iomanip>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <vector>
 #include <algorithm>
+#include <sstream>
+#include <random>
+#include <cmath>
 
-using namespace std;
+#include "cache_topology.h"
+#include "cli_options.h"
+#include "file_stream.h"
+#include "sum_parallel.h"
+#include "sum_scan.h"
+#include "sum_simd.h"
+#include "sum_stats.h"
+#include "sum_unroll.h"
+#include "bench_harness.h"
+#include "roofline.h"
+#include "kernel_registry.h"
 
-// 高精度计时函数，返回秒
-double get_time() {
-    return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(
-        chrono::high_resolution_clock::now().time_since_epoch()).count()) / 1.0e9;
-}
+using namespace std;
 
 // 生成测试数据
 void generate_data(double* arr, int n) {
@@ -24,7 +32,7 @@ void generate_data(double* arr, int n) {
 }
 
 // 平凡求和算法
-double sum_naive(double* arr, int n) {
+double sum_naive(const double* arr, int n) {
     double sum = 0.0;
     for (int i = 0; i < n; i++) {
         sum += arr[i];
@@ -33,7 +41,7 @@ double sum_naive(double* arr, int n) {
 }
 
 // 两路链式求和算法
-double sum_two_way(double* arr, int n) {
+double sum_two_way(const double* arr, int n) {
     double sum1 = 0.0;
     double sum2 = 0.0;
     int i;
@@ -69,74 +77,193 @@ double sum_reduction(double* arr, int n) {
     return arr[0];
 }
 
-// 4路循环展开
-double sum_unroll4(double* arr, int n) {
-    double sum = 0.0;
-    int i = 0;
+// 非破坏性树形规约 - 与sum_reduction的加法顺序完全相同，结果逐位一致，但不修改输入也不分配内存
+// 记第k轮规约前的长度为m[k](m[0]=n, m[k+1]=m[k]/2)，第k轮后的第i个值为V(k+1,i)=V(k,i)+V(k,i+m[k+1])。
+// 连续的一段V(k+1,[s,s+b))只依赖V(k,[s,s+b))和V(k,[s+m[k+1],s+m[k+1]+b))两段连续数据，
+// 因此可以按块递归计算：每层只需一个固定大小的缓冲区，栈深度为O(log n)
+const int TREE_BLOCK = 512;       // 递归到长度不超过TREE_BLOCK的那一层后，在缓冲区中按原算法完成
+const int TREE_MAX_LEVELS = 32;
+
+// 单个值V(k,j)，用于奇数长度时额外加到V(k+1,0)上的那个元素
+double tree_value(const double* arr, const int* m, int k, int j) {
+    if (k == 0) return arr[j];
+    double v = tree_value(arr, m, k - 1, j) + tree_value(arr, m, k - 1, j + m[k]);
+    if (j == 0 && m[k - 1] % 2 == 1) {
+        v += tree_value(arr, m, k - 1, m[k - 1] - 1);
+    }
+    return v;
+}
+
+// out[0..b) = V(k,[s,s+b))，scratch[k]为第k层的缓冲区
+void tree_block(const double* arr, const int* m, int k, int s, int b, double* out,
+                double (*scratch)[TREE_BLOCK]) {
+    const double* lo;
+    const double* hi;
+    if (k == 1) {
+        lo = arr + s;
+        hi = arr + s + m[1];
+    } else {
+        tree_block(arr, m, k - 1, s, b, out, scratch);
+        tree_block(arr, m, k - 1, s + m[k], b, scratch[k], scratch);
+        lo = out;
+        hi = scratch[k];
+    }
+    for (int i = 0; i < b; i++) {
+        out[i] = lo[i] + hi[i];
+    }
+    // 处理奇数
+    if (s == 0 && m[k - 1] % 2 == 1) {
+        out[0] += tree_value(arr, m, k - 1, m[k - 1] - 1);
+    }
+}
+
+double sum_tree(const double* arr, int n) {
+    if (n <= 0) return 0.0;
+    
+    // 每个线程一份固定缓冲区，调用时不分配内存；scratch[0]存放顶层结果
+    static thread_local double scratch[TREE_MAX_LEVELS + 1][TREE_BLOCK];
     
-    // 4路循环展开
-    for (; i + 3 < n; i += 4) {
-        sum += arr[i] + arr[i+1] + arr[i+2] + arr[i+3];
+    int m[TREE_MAX_LEVELS + 1];
+    int levels = 0;
+    m[0] = n;
+    while (m[levels] > TREE_BLOCK) {
+        m[levels + 1] = m[levels] / 2;
+        levels++;
     }
     
-    // 处理剩余元素
-    for (; i < n; i++) {
-        sum += arr[i];
+    int b = m[levels];
+    if (levels == 0) {
+        memcpy(scratch[0], arr, b * sizeof(double));
+    } else {
+        tree_block(arr, m, levels, 0, b, scratch[0], scratch);
     }
     
-    return sum;
+    // 剩余的轮次与sum_reduction相同，在缓冲区中原地进行
+    return sum_reduction(scratch[0], b);
+}
+
+// 4路循环展开，由编译期展开的模板内核生成(单个累加器，加法顺序与手写版本相同)
+double sum_unroll4(const double* arr, int n) {
+    return sum_unrolled<4, 1>(arr, n);
 }
 
 // 8路循环展开
-double sum_unroll8(double* arr, int n) {
-    double sum = 0.0;
-    int i = 0;
-    
-    // 8路循环展开
-    for (; i + 7 < n; i += 8) {
-        sum += arr[i] + arr[i+1] + arr[i+2] + arr[i+3] +
-               arr[i+4] + arr[i+5] + arr[i+6] + arr[i+7];
+double sum_unroll8(const double* arr, int n) {
+    return sum_unrolled<8, 1>(arr, n);
+}
+
+// 分块两两求和：长度不超过PAIRWISE_BLOCK的块用向量化求和，块和再两两相加
+// 误差界约为(PAIRWISE_BLOCK/向量通道数 + log2(n/PAIRWISE_BLOCK)) * eps，而顺序求和为n * eps；
+// 块足够大时递归开销可以忽略，速度接近sum_simd
+const int PAIRWISE_BLOCK = 256;
+
+double sum_pairwise(const double* arr, int n) {
+    if (n <= PAIRWISE_BLOCK) {
+        return sum_simd(arr, n);
     }
-    
-    // 处理剩余元素
-    for (; i < n; i++) {
-        sum += arr[i];
+    // 左半取整到块大小，使除最后一块外每块都是满的
+    int half = (n / 2 + PAIRWISE_BLOCK - 1) / PAIRWISE_BLOCK * PAIRWISE_BLOCK;
+    return sum_pairwise(arr, half) + sum_pairwise(arr + half, n - half);
+}
+
+// 精确求和(Shewchuk算法，与Python math.fsum相同)，作为误差计算的参考值
+// partials保存互不重叠的若干double，其和精确等于已处理元素之和，最后正确舍入为一个double
+double sum_exact(const double* arr, int n) {
+    vector<double> partials;
+    for (int i = 0; i < n; i++) {
+        double x = arr[i];
+        size_t k = 0;
+        for (size_t j = 0; j < partials.size(); j++) {
+            double y = partials[j];
+            if (abs(x) < abs(y)) swap(x, y);
+            double hi = x + y;
+            double lo = y - (hi - x);
+            if (lo != 0.0) partials[k++] = lo;
+            x = hi;
+        }
+        partials.resize(k);
+        partials.push_back(x);
     }
-    
-    return sum;
+    if (partials.empty()) return 0.0;
+
+    // 从最大的部分和开始累加，直到出现不精确的加法
+    int k = (int)partials.size() - 1;
+    double hi = partials[k];
+    double lo = 0.0;
+    while (k > 0) {
+        double x = hi;
+        double y = partials[--k];
+        hi = x + y;
+        lo = y - (hi - x);
+        if (lo != 0.0) break;
+    }
+    // 恰好位于两个double中点时，根据更低位的符号决定舍入方向
+    if (k > 0 && ((lo < 0.0 && partials[k-1] < 0.0) || (lo > 0.0 && partials[k-1] > 0.0))) {
+        double y = lo * 2.0;
+        double x = hi + y;
+        if (y == x - hi) hi = x;
+    }
+    return hi;
+}
+
+// 用bench_run测一个求和内核，结果写入volatile变量，避免调用被优化掉
+BenchStats bench_sum(SumKernel kernel, const double* arr, int n, const BenchOptions& options) {
+    volatile double sink = 0.0;
+    return bench_run([&] { sink = kernel(arr, n); }, options);
+}
+
+// 单次求和时间换算为带宽(GB/s)，每次求和读取n个double
+double bandwidth_gbs(int n, double seconds) {
+    return (double)n * sizeof(double) / seconds / 1.0e9;
 }
 
 // 测试基础求和算法
-void test_basic_sum(int* sizes, int sizes_count, int test_count, const char* output_file) {
+// 用bench_run计时(预热、自适应重复、扣除计时开销)，时间列为单次调用的中位数，
+// 每个算法另有最小值/均值/分位数/标准差等统计列，完整统计同时写入同名的JSON文件
+void test_basic_sum(int* sizes, int sizes_count, const BenchOptions& options, const char* output_file) {
     ofstream out_file(output_file);
     if (!out_file.is_open()) {
         cout << "无法创建文件: " << output_file << endl;
         return;
     }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    // 输入数组和递归规约用的副本都从内存池中分配，容量按最大规模一次预留
+    int max_n = 0;
+    for (int i = 0; i < sizes_count; i++) {
+        if (sizes[i] > max_n) max_n = sizes[i];
+    }
+    BufferArena arena(2 * arena_array_bytes(max_n), options.pages);
     
     // 写入CSV文件头
-    out_file << "数组大小,平凡算法(秒),两路链式(秒),递归(秒),两路链式加速比,递归加速比,结果正确性" << endl;
+    write_topology_header(out_file);
+    out_file << "# 内存池: " << arena.summary() << endl;
+    out_file << "数组大小,平凡算法(秒),两路链式(秒),递归(秒),两路链式加速比,递归加速比,结果正确性,树形规约(秒),树形规约加速比";
+    write_bench_csv_header(out_file, "平凡算法");
+    write_bench_csv_header(out_file, "两路链式");
+    write_bench_csv_header(out_file, "递归");
+    write_bench_csv_header(out_file, "树形规约");
+    write_perf_csv_header(out_file, "平凡算法");
+    write_perf_csv_header(out_file, "两路链式");
+    write_perf_csv_header(out_file, "递归");
+    write_perf_csv_header(out_file, "树形规约");
+    out_file << endl;
     
     // 控制台表头
-    cout << "\n基础求和算法性能比较 (每规模测试" << test_count << "次):" << endl;
+    cout << "\n基础求和算法性能比较 (单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "内存池: " << arena.summary() << endl;
     cout << "规模\t平凡算法(秒)\t两路链式(秒)\t递归(秒)\t两路链式加速比\t递归加速比\t结果正确性" << endl;
-    cout << "-------\t-----------\t-----------\t--------\t--------------\t-----------\t----------" << endl;
     
     for (int i = 0; i < sizes_count; i++) {
         int n = sizes[i];
-        cout << "测试数组大小: " << n << " (" << test_count << "次)" << endl;
         
-        // 动态分配测试数组
-        double* arr = new double[n];
+        // 从内存池中切出测试数组
+        arena.reset();
+        double* arr = arena.alloc(n);
         generate_data(arr, n);
         
-        // 调整迭代次数，对大规模数据减少迭代
-        int actual_test_count = test_count;
-        if (n > 1000000) actual_test_count = (test_count > 10) ? 10 : test_count;
-        if (n > 10000000) actual_test_count = (test_count > 5) ? 5 : test_count;
-        
-        cout << "  调整后测试次数: " << actual_test_count << endl;
-        
         // 先验证结果正确性（只需验证一次）
         double naive_result = sum_naive(arr, n);
         double two_way_result = sum_two_way(arr, n);
@@ -145,287 +272,1141 @@ void test_basic_sum(int* sizes, int sizes_count, int test_count, const char* out
         
         // 验证规约算法正确性 - 为规约算法创建数组副本
         bool correct_recursive = false;
-        double* arr_copy = new double[n];
+        double* arr_copy = arena.alloc(n);
         memcpy(arr_copy, arr, n * sizeof(double));
         double recursive_result = sum_reduction(arr_copy, n);
         correct_recursive = abs(naive_result - recursive_result) < 1e-10;
-        delete[] arr_copy;
-        
-        // 测试平凡算法 - 累计所有测试时间
-        double total_time_naive = 0.0;
-        for (int t = 0; t < actual_test_count; t++) {
-            double start_time = get_time();
-            volatile double res = sum_naive(arr, n);
-            total_time_naive += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == actual_test_count-1) {
-                cout << "  平凡算法进度: " << t+1 << "/" << actual_test_count << endl;
-            }
-        }
         
-        // 测试两路链式算法 - 累计所有测试时间
-        double total_time_two_way = 0.0;
-        for (int t = 0; t < actual_test_count; t++) {
-            double start_time = get_time();
-            volatile double res = sum_two_way(arr, n);
-            total_time_two_way += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == actual_test_count-1) {
-                cout << "  两路链式算法进度: " << t+1 << "/" << actual_test_count << endl;
-            }
-        }
+        // 树形规约与递归规约的加法顺序相同，结果应逐位一致，且不能修改输入
+        double tree_result = sum_tree(arr, n);
+        bool correct_tree = tree_result == recursive_result && naive_result == sum_naive(arr, n);
         
-        // 测试递归算法 - 累计所有测试时间
-        // 为每次测试创建数组副本
-        double total_time_recursive = 0.0;
-        double* arr_temp = new double[n]; // 用于递归算法的临时数组
-        
-        for (int t = 0; t < actual_test_count; t++) {
-            // 为每次测试创建数组副本
-            memcpy(arr_temp, arr, n * sizeof(double));
-            
-            double start_time = get_time();
-            volatile double res = sum_reduction(arr_temp, n);
-            total_time_recursive += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == actual_test_count-1) {
-                cout << "  递归算法进度: " << t+1 << "/" << actual_test_count << endl;
-            }
-        }
-        
-        delete[] arr_temp; // 释放临时数组
+        BenchStats naive = bench_sum(sum_naive, arr, n, options);
+        BenchStats two_way = bench_sum(sum_two_way, arr, n, options);
+        // 递归算法原地修改数组，每个样本之前(不计时)恢复副本
+        volatile double sink = 0.0;
+        BenchStats recursive = bench_run([&] { sink = sum_reduction(arr_copy, n); },
+                                         [&] { memcpy(arr_copy, arr, n * sizeof(double)); }, true, options);
+        // 树形规约不修改输入，无需每次复制数组
+        BenchStats tree = bench_sum(sum_tree, arr, n, options);
+        report.add("basic", "naive", n, naive);
+        roofline.add("basic", "naive", n, sum_work(n), naive.median);
+        report.add("basic", "two_way", n, two_way);
+        roofline.add("basic", "two_way", n, sum_work(n), two_way.median);
+        report.add("basic", "reduction", n, recursive);
+        roofline.add("basic", "reduction", n, sum_work(n), recursive.median);
+        report.add("basic", "tree", n, tree);
+        roofline.add("basic", "tree", n, sum_work(n), tree.median);
         
         // 计算加速比
-        double speedup_two_way = total_time_naive / total_time_two_way;
-        double speedup_recursive = total_time_naive / total_time_recursive;
+        double speedup_two_way = naive.median / two_way.median;
+        double speedup_recursive = naive.median / recursive.median;
+        double speedup_tree = naive.median / tree.median;
         
         string correctness = "";
-        if (correct_two_way && correct_recursive) {
+        if (correct_two_way && correct_recursive && correct_tree) {
             correctness = "正确";
         } else {
             correctness = "错误";
             if (!correct_two_way) correctness += "-两路";
             if (!correct_recursive) correctness += "-递归";
+            if (!correct_tree) correctness += "-树形";
         }
         
         // 输出结果到控制台
         cout << n << "\t" 
-             << fixed << setprecision(6) << total_time_naive << "\t\t" 
-             << total_time_two_way << "\t\t"
-             << total_time_recursive << "\t\t"
-             << setprecision(2) << speedup_two_way << "x\t\t"
+             << scientific << setprecision(3) << naive.median << "\t" 
+             << two_way.median << "\t"
+             << recursive.median << "\t"
+             << fixed << setprecision(2) << speedup_two_way << "x\t\t"
              << speedup_recursive << "x\t\t"
              << correctness << endl;
+        cout << "  树形规约: " << scientific << setprecision(3) << tree.median << "秒, 加速比 "
+             << fixed << setprecision(2) << speedup_tree << "x" << endl;
         
         // 写入CSV文件
         out_file << n << "," 
-                 << fixed << setprecision(6) << total_time_naive << "," 
-                 << total_time_two_way << ","
-                 << total_time_recursive << ","
-                 << setprecision(3) << speedup_two_way << ","
+                 << scientific << setprecision(6) << naive.median << "," 
+                 << two_way.median << ","
+                 << recursive.median << ","
+                 << fixed << setprecision(3) << speedup_two_way << ","
                  << speedup_recursive << ","
-                 << correctness << endl;
-        
-        // 释放内存
-        delete[] arr;
+                 << correctness << ","
+                 << scientific << setprecision(6) << tree.median << ","
+                 << fixed << setprecision(3) << speedup_tree;
+        write_bench_csv(out_file, naive);
+        write_bench_csv(out_file, two_way);
+        write_bench_csv(out_file, recursive);
+        write_bench_csv(out_file, tree);
+        write_perf_csv(out_file, naive.counters, n);
+        write_perf_csv(out_file, two_way.counters, n);
+        write_perf_csv(out_file, recursive.counters, n);
+        write_perf_csv(out_file, tree.counters, n);
+        out_file << endl;
     }
     
+    report.write_csv_note(out_file);
     out_file.close();
-    cout << "基础算法测试结果已保存到: " << output_file << endl;
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "基础算法测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
 }
 
-// 测试进阶求和算法
-void test_advanced_sum(int* sizes, int sizes_count, int test_count, const char* output_file) {
+// 测试进阶求和算法：平凡算法、编译期展开内核的参数网格(展开路数 x 累加器个数)和各指令集的向量化求和
+// 记录每个规模的最优展开配置；4路/8路展开即单累加器的4路/8路配置，单独保留这两列
+// 时间均为bench_run给出的单次调用中位数，带宽按中位数计算
+void test_advanced_sum(int* sizes, int sizes_count, const BenchOptions& options, const char* output_file) {
     ofstream out_file(output_file);
     if (!out_file.is_open()) {
         cout << "无法创建文件: " << output_file << endl;
         return;
     }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    int max_n = 0;
+    for (int i = 0; i < sizes_count; i++) {
+        if (sizes[i] > max_n) max_n = sizes[i];
+    }
+    BufferArena arena(arena_array_bytes(max_n), options.pages);
+    // 网格中配置很多，每个配置的计时时间上限取总上限的1/4
+    BenchOptions grid_options = options;
+    grid_options.max_seconds = options.max_seconds / 4;
     
-    // 写入CSV文件头
-    out_file << "数组大小,平凡算法(秒),4路展开(秒),8路展开(秒),4路展开加速比,8路展开加速比,结果正确性" << endl;
+    const vector<UnrolledSum>& grid = sum_unroll_grid();
+    int grid_size = grid.size();
+    int index4 = 0, index8 = 0;
+    for (int c = 0; c < grid_size; c++) {
+        if (grid[c].unroll == 4 && grid[c].accumulators == 1) index4 = c;
+        if (grid[c].unroll == 8 && grid[c].accumulators == 1) index8 = c;
+    }
+    
+    // 写入CSV文件头，最后是网格中每个配置的时间
+    write_topology_header(out_file);
+    out_file << "# 内存池: " << arena.summary() << endl;
+    out_file << "数组大小,平凡算法(秒),4路展开(秒),8路展开(秒),4路展开加速比,8路展开加速比,结果正确性,"
+             << "SSE2(秒),AVX2(秒),AVX-512(秒),"
+             << "平凡算法(GB/s),4路展开(GB/s),8路展开(GB/s),SSE2(GB/s),AVX2(GB/s),AVX-512(GB/s),"
+             << "最优展开路数,最优累加器个数,最优展开(秒),最优展开加速比,最优展开(GB/s)";
+    for (const UnrolledSum& config : grid) {
+        out_file << "," << config.unroll << "路" << config.accumulators << "累加器(秒)";
+    }
+    write_bench_csv_header(out_file, "平凡算法");
+    write_bench_csv_header(out_file, "最优展开");
+    write_perf_csv_header(out_file, "平凡算法");
+    write_perf_csv_header(out_file, "最优展开");
+    out_file << endl;
+    
+    // 本机不支持的指令集在CSV中留空
+    const SimdLevel simd_levels[] = {SIMD_SSE2, SIMD_AVX2, SIMD_AVX512};
+    const int simd_count = 3;
+    cout << "本机最宽SIMD指令集: " << simd_level_name(detect_simd_level()) << endl;
     
     // 控制台表头
-    cout << "\n进阶求和算法性能比较 (每规模测试" << test_count << "次):" << endl;
-    cout << "规模\t平凡算法(秒)\t4路展开(秒)\t8路展开(秒)\t4路展开加速比\t8路展开加速比\t结果正确性" << endl;
-    cout << "-------\t-----------\t-----------\t-----------\t--------------\t--------------\t----------" << endl;
+    cout << "\n进阶求和算法性能比较 (单次调用中位数, " << grid_size << "种展开配置):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "内存池: " << arena.summary() << endl;
+    cout << "规模\t平凡算法(秒)\t4路展开(秒)\t8路展开(秒)\t最优配置\t最优(秒)\t最优加速比\t结果正确性" << endl;
     
+    double* times = new double[grid_size];
+    BenchStats* stats = new BenchStats[grid_size];
     for (int i = 0; i < sizes_count; i++) {
         int n = sizes[i];
-        cout << "测试数组大小: " << n << " (" << test_count << "次)" << endl;
         
-        // 动态分配测试数组
-        double* arr = new double[n];
+        // 从内存池中切出测试数组
+        arena.reset();
+        double* arr = arena.alloc(n);
         generate_data(arr, n);
         
-        // 调整迭代次数，对大规模数据减少迭代
-        int actual_test_count = test_count;
-        if (n > 1000000) actual_test_count = (test_count > 10) ? 10 : test_count;
-        if (n > 10000000) actual_test_count = (test_count > 5) ? 5 : test_count;
-        
-        cout << "  调整后测试次数: " << actual_test_count << endl;
-        
         // 先验证结果正确性（只需验证一次）
         double naive_result = sum_naive(arr, n);
-        double unroll4_result = sum_unroll4(arr, n);
-        double unroll8_result = sum_unroll8(arr, n);
-        
-        bool correct_unroll4 = abs(naive_result - unroll4_result) < 1e-10;
-        bool correct_unroll8 = abs(naive_result - unroll8_result) < 1e-10;
-        
-        // 测试平凡算法 - 累计所有测试时间
-        double total_time_naive = 0.0;
-        for (int t = 0; t < actual_test_count; t++) {
-            double start_time = get_time();
-            volatile double res = sum_naive(arr, n);
-            total_time_naive += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == actual_test_count-1) {
-                cout << "  平凡算法进度: " << t+1 << "/" << actual_test_count << endl;
+        bool correct_unroll = true;
+        for (int c = 0; c < grid_size; c++) {
+            if (abs(naive_result - grid[c].kernel(arr, n)) >= 1e-10) {
+                correct_unroll = false;
+                cout << "  " << grid[c].unroll << "路" << grid[c].accumulators << "累加器结果错误" << endl;
             }
         }
-        
-        // 测试4路循环展开 - 累计所有测试时间
-        double total_time_unroll4 = 0.0;
-        for (int t = 0; t < actual_test_count; t++) {
-            double start_time = get_time();
-            volatile double res = sum_unroll4(arr, n);
-            total_time_unroll4 += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == actual_test_count-1) {
-                cout << "  4路展开算法进度: " << t+1 << "/" << actual_test_count << endl;
+        bool correct_simd = true;
+        for (int k = 0; k < simd_count; k++) {
+            SumKernel kernel = sum_kernel_for(simd_levels[k]);
+            if (kernel != nullptr && abs(naive_result - kernel(arr, n)) >= 1e-10) {
+                correct_simd = false;
             }
         }
         
-        // 测试8路循环展开 - 累计所有测试时间
-        double total_time_unroll8 = 0.0;
-        for (int t = 0; t < actual_test_count; t++) {
-            double start_time = get_time();
-            volatile double res = sum_unroll8(arr, n);
-            total_time_unroll8 += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == actual_test_count-1) {
-                cout << "  8路展开算法进度: " << t+1 << "/" << actual_test_count << endl;
-            }
+        BenchStats naive = bench_sum(sum_naive, arr, n, options);
+        report.add("advanced", "naive", n, naive);
+        roofline.add("advanced", "naive", n, sum_work(n), naive.median);
+        double time_naive = naive.median;
+        
+        // 扫描展开参数网格
+        int best = 0;
+        for (int c = 0; c < grid_size; c++) {
+            stats[c] = bench_sum(grid[c].kernel, arr, n, grid_options);
+            times[c] = stats[c].median;
+            if (times[c] < times[best]) best = c;
+            string name = to_string(grid[c].unroll) + "x" + to_string(grid[c].accumulators);
+            report.add("advanced", name.c_str(), n, stats[c]);
+            roofline.add("advanced", name.c_str(), n, sum_work(n), stats[c].median);
+        }
+        double time_unroll4 = times[index4];
+        double time_unroll8 = times[index8];
+        
+        // 测试各指令集的向量化求和，不支持的记为0
+        double time_simd[simd_count];
+        for (int k = 0; k < simd_count; k++) {
+            SumKernel kernel = sum_kernel_for(simd_levels[k]);
+            time_simd[k] = 0.0;
+            if (kernel == nullptr) continue;
+            BenchStats simd = bench_sum(kernel, arr, n, options);
+            report.add("advanced", simd_level_name(simd_levels[k]), n, simd);
+            roofline.add("advanced", simd_level_name(simd_levels[k]), n, sum_work(n), simd.median);
+            time_simd[k] = simd.median;
         }
         
         // 计算加速比
-        double speedup_unroll4 = total_time_naive / total_time_unroll4;
-        double speedup_unroll8 = total_time_naive / total_time_unroll8;
+        double speedup_unroll4 = time_naive / time_unroll4;
+        double speedup_unroll8 = time_naive / time_unroll8;
+        double speedup_best = time_naive / times[best];
         
         string correctness = "";
-        if (correct_unroll4 && correct_unroll8) {
+        if (correct_unroll && correct_simd) {
             correctness = "正确";
         } else {
             correctness = "错误";
-            if (!correct_unroll4) correctness += "-4路";
-            if (!correct_unroll8) correctness += "-8路";
+            if (!correct_unroll) correctness += "-展开";
+            if (!correct_simd) correctness += "-SIMD";
         }
         
         // 输出结果到控制台
         cout << n << "\t" 
-             << fixed << setprecision(6) << total_time_naive << "\t\t" 
-             << total_time_unroll4 << "\t\t"
-             << total_time_unroll8 << "\t\t"
-             << setprecision(2) << speedup_unroll4 << "x\t\t"
-             << speedup_unroll8 << "x\t\t"
+             << scientific << setprecision(3) << time_naive << "\t" 
+             << time_unroll4 << "\t"
+             << time_unroll8 << "\t"
+             << grid[best].unroll << "路" << grid[best].accumulators << "累加器\t"
+             << times[best] << "\t"
+             << fixed << setprecision(2) << speedup_best << "x\t\t"
              << correctness << endl;
+        cout << "  带宽(GB/s): 平凡 " << bandwidth_gbs(n, time_naive)
+             << ", 4路 " << bandwidth_gbs(n, time_unroll4)
+             << ", 8路 " << bandwidth_gbs(n, time_unroll8);
+        for (int k = 0; k < simd_count; k++) {
+            cout << ", " << simd_level_name(simd_levels[k]) << " ";
+            if (time_simd[k] > 0) {
+                cout << bandwidth_gbs(n, time_simd[k]);
+            } else {
+                cout << "-";
+            }
+        }
+        cout << endl;
         
         // 写入CSV文件
         out_file << n << "," 
-                 << fixed << setprecision(6) << total_time_naive << "," 
-                 << total_time_unroll4 << ","
-                 << total_time_unroll8 << ","
-                 << setprecision(3) << speedup_unroll4 << ","
+                 << scientific << setprecision(6) << time_naive << "," 
+                 << time_unroll4 << ","
+                 << time_unroll8 << ","
+                 << fixed << setprecision(3) << speedup_unroll4 << ","
                  << speedup_unroll8 << ","
-                 << correctness << endl;
+                 << correctness;
+        out_file << scientific << setprecision(6);
+        for (int k = 0; k < simd_count; k++) {
+            out_file << ",";
+            if (time_simd[k] > 0) out_file << time_simd[k];
+        }
+        out_file << fixed << setprecision(3)
+                 << "," << bandwidth_gbs(n, time_naive)
+                 << "," << bandwidth_gbs(n, time_unroll4)
+                 << "," << bandwidth_gbs(n, time_unroll8);
+        for (int k = 0; k < simd_count; k++) {
+            out_file << ",";
+            if (time_simd[k] > 0) out_file << bandwidth_gbs(n, time_simd[k]);
+        }
+        out_file << "," << grid[best].unroll << "," << grid[best].accumulators << ","
+                 << scientific << setprecision(6) << times[best] << ","
+                 << fixed << setprecision(3) << speedup_best << ","
+                 << bandwidth_gbs(n, times[best]);
+        out_file << scientific << setprecision(6);
+        for (int c = 0; c < grid_size; c++) {
+            out_file << "," << times[c];
+        }
+        write_bench_csv(out_file, naive);
+        write_bench_csv(out_file, stats[best]);
+        write_perf_csv(out_file, naive.counters, n);
+        write_perf_csv(out_file, stats[best].counters, n);
+        out_file << fixed << endl;
+    }
+    delete[] times;
+    delete[] stats;
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "进阶算法测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// 精度测试用的数据分布；generate_data的小整数在各种加法顺序下都精确，测不出误差
+enum DataDistribution {
+    DIST_UNIFORM,     // [0,1)均匀分布，全为正数，误差随n线性增长
+    DIST_WIDE_RANGE,  // 随机符号，数量级在1e-10到1e10之间对数均匀分布
+    DIST_CANCEL,      // 成对的±1e8级大数相互抵消，只剩[0,1)的小残差，条件数约1e8
+    DIST_COUNT
+};
+
+const char* distribution_name(DataDistribution dist) {
+    switch (dist) {
+        case DIST_UNIFORM: return "均匀[0,1)";
+        case DIST_WIDE_RANGE: return "宽动态范围";
+        case DIST_CANCEL: return "正负抵消";
+        default: return "unknown";
+    }
+}
+
+// JSON中使用的分布名
+const char* distribution_key(DataDistribution dist) {
+    switch (dist) {
+        case DIST_UNIFORM: return "uniform";
+        case DIST_WIDE_RANGE: return "wide_range";
+        case DIST_CANCEL: return "cancel";
+        default: return "unknown";
+    }
+}
+
+// 固定种子，使不同机器、不同次运行的误差可以直接比较
+void generate_distribution(double* arr, int n, DataDistribution dist) {
+    mt19937_64 rng(12345 + n);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    if (dist == DIST_UNIFORM) {
+        for (int i = 0; i < n; i++) arr[i] = unit(rng);
+    } else if (dist == DIST_WIDE_RANGE) {
+        for (int i = 0; i < n; i++) {
+            double magnitude = pow(10.0, -10.0 + 20.0 * unit(rng));
+            arr[i] = (rng() & 1) ? magnitude : -magnitude;
+        }
+    } else {
+        int i = 0;
+        for (; i + 1 < n; i += 2) {
+            arr[i] = (unit(rng) * 2.0 - 1.0) * 1e8;
+            arr[i+1] = -arr[i] + unit(rng);
+        }
+        if (i < n) arr[i] = unit(rng);
+        // 打乱顺序，避免相邻两项直接抵消
+        shuffle(arr, arr + n, rng);
+    }
+}
+
+// 求和精度测试：各算法在不同数据分布上的耗时和相对于精确和的相对误差
+// 时间为bench_run给出的单次调用中位数，完整统计写入同名的JSON文件
+void test_accuracy_sum(int* sizes, int sizes_count, const BenchOptions& options, const char* output_file) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    
+    struct NamedKernel {
+        const char* name;
+        const char* key;  // JSON中的内核名
+        SumKernel kernel;
+        double flops;     // 每元素的浮点运算数，补偿求和每个元素多出误差项的三次加减
+    };
+    const NamedKernel kernels[] = {
+        {"平凡算法", "naive", sum_naive, 1.0},
+        {"8路展开", "unroll8", sum_unroll8, 1.0},
+        {"SIMD", "simd", sum_simd, 1.0},
+        {"分块两两", "pairwise", sum_pairwise, 1.0},
+        {"补偿SIMD", "compensated", sum_compensated, 4.0},
+        {"标量Neumaier", "neumaier", sum_neumaier, 4.0},
+    };
+    const int kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "数组大小,数据分布,条件数";
+    for (int k = 0; k < kernel_count; k++) out_file << "," << kernels[k].name << "(秒)";
+    for (int k = 0; k < kernel_count; k++) out_file << "," << kernels[k].name << "相对误差";
+    out_file << ",补偿SIMD/8路耗时比" << endl;
+    
+    cout << "\n求和精度测试 (补偿SIMD使用" << simd_level_name(detect_simd_level()) << ", 单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    
+    for (int i = 0; i < sizes_count; i++) {
+        int n = sizes[i];
         
-        // 释放内存
+        double* arr = new double[n];
+        for (int d = 0; d < DIST_COUNT; d++) {
+            DataDistribution dist = (DataDistribution)d;
+            generate_distribution(arr, n, dist);
+            
+            // 条件数 Σ|x| / |Σx|：相对误差约为条件数乘以算法的误差界
+            double exact = sum_exact(arr, n);
+            double abs_sum = 0.0;
+            for (int j = 0; j < n; j++) abs_sum += abs(arr[j]);
+            double condition = abs_sum / abs(exact);
+            
+            double times[kernel_count];
+            double errors[kernel_count];
+            string test = string("accuracy/") + distribution_key(dist);
+            for (int k = 0; k < kernel_count; k++) {
+                errors[k] = abs(kernels[k].kernel(arr, n) - exact) / abs(exact);
+                BenchStats stats = bench_sum(kernels[k].kernel, arr, n, options);
+                report.add(test.c_str(), kernels[k].key, n, stats);
+                roofline.add(test.c_str(), kernels[k].key, n, sum_work(n, kernels[k].flops), stats.median);
+                times[k] = stats.median;
+            }
+            // kernels[1]为8路展开，kernels[4]为补偿SIMD
+            double ratio = times[4] / times[1];
+            
+            // 输出结果到控制台
+            cout << n << "\t" << distribution_name(dist) << "\t条件数 " << scientific << setprecision(2) << condition << endl;
+            for (int k = 0; k < kernel_count; k++) {
+                cout << "  " << kernels[k].name << "\t"
+                     << scientific << setprecision(3) << times[k] << "秒\t相对误差 "
+                     << scientific << setprecision(3) << errors[k] << endl;
+            }
+            cout << fixed << setprecision(2) << "  补偿SIMD耗时为8路展开的 " << ratio << " 倍" << endl;
+            
+            // 写入CSV文件
+            out_file << n << "," << distribution_name(dist) << ","
+                     << scientific << setprecision(3) << condition;
+            out_file << scientific << setprecision(6);
+            for (int k = 0; k < kernel_count; k++) out_file << "," << times[k];
+            out_file << scientific << setprecision(3);
+            for (int k = 0; k < kernel_count; k++) out_file << "," << errors[k];
+            out_file << fixed << setprecision(3) << "," << ratio << endl;
+        }
         delete[] arr;
     }
     
+    report.write_csv_note(out_file);
     out_file.close();
-    cout << "进阶算法测试结果已保存到: " << output_file << endl;
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "精度测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
 }
 
-int main() {
-    srand(time(NULL));
+// 写入n个与generate_data相同规律的double，按块写出以免占用与文件同样大的内存
+bool write_data_file(const char* path, size_t n) {
+    ofstream out(path, ios::binary);
+    if (!out.is_open()) return false;
+    const size_t block = 1 << 17;
+    vector<double> buffer(block);
+    for (size_t pos = 0; pos < n; pos += block) {
+        size_t count = n - pos < block ? n - pos : block;
+        for (size_t i = 0; i < count; i++) {
+            buffer[i] = (pos + i) % 10 + 1.0;
+        }
+        out.write(reinterpret_cast<const char*>(buffer.data()), count * sizeof(double));
+    }
+    return (bool)out;
+}
+
+// 流式求和测试：数组放在文件中，按块读入并逐块累加，文件可以远大于内存
+// 每次运行前把文件移出页缓存，测到的是设备读取与求和重叠后的端到端带宽；
+// 同时给出同一算法在内存中(一块数据位于缓存/内存)的带宽，两者接近时瓶颈在计算，否则在I/O
+void test_stream_sum(const char* path, const vector<StreamIo>& ios, size_t chunk_bytes,
+                     double expected, bool has_expected, const BenchOptions& options, const char* output_file) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    BenchReport report(options);
+    RooflineReport roofline(options);
     
-    // 根据不同规模范围设置2的幂次方测试规模
-    vector<int> test_sizes;
+    struct NamedKernel {
+        const char* name;
+        const char* key;  // JSON中的内核名
+        SumKernel kernel;
+    };
+    const NamedKernel kernels[] = {
+        {"平凡算法", "naive", sum_naive},
+        {"两路链式", "two_way", sum_two_way},
+        {"4路展开", "unroll4", sum_unroll4},
+        {"8路展开", "unroll8", sum_unroll8},
+        {"SIMD", "simd", sum_simd},
+    };
+    const int kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+    size_t bytes = file_size(path) / sizeof(double) * sizeof(double);
+    
+    // 内存中的基准：用bench_run对一块大小的数据重复求和，取单次调用中位数
+    int chunk_count = (int)(chunk_bytes / sizeof(double));
+    double* chunk = new double[chunk_count];
+    generate_data(chunk, chunk_count);
+    double memory_gbs[kernel_count];
+    for (int k = 0; k < kernel_count; k++) {
+        BenchStats stats = bench_sum(kernels[k].kernel, chunk, chunk_count, options);
+        report.add("stream_memory", kernels[k].key, chunk_count, stats);
+        roofline.add("stream_memory", kernels[k].key, chunk_count, sum_work(chunk_count), stats.median);
+        memory_gbs[k] = bandwidth_gbs(chunk_count, stats.median);
+    }
+    delete[] chunk;
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "文件大小(MB),I/O方式,算法,块大小(KB),端到端(秒),端到端(GB/s),等待I/O(秒),计算(秒),内存中算法(GB/s),结果正确性" << endl;
+    
+    cout << "\n流式求和测试: " << path << " (" << bytes / (1 << 20) << "MB, 块大小"
+         << chunk_bytes / 1024 << "KB)" << endl;
+    cout << "内存中基准计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "I/O方式\t算法\t\t端到端(秒)\t端到端(GB/s)\t等待I/O(秒)\t计算(秒)\t内存中(GB/s)\t结果正确性" << endl;
+    
+    for (StreamIo io : ios) {
+        for (int k = 0; k < kernel_count; k++) {
+            SumKernel kernel = kernels[k].kernel;
+            drop_file_cache(path);
+            double sum = 0.0;
+            StreamStats stats = stream_file(path, io, chunk_bytes,
+                [&](const double* data, size_t count, size_t) { sum += kernel(data, (int)count); });
+            if (!stats.ok) {
+                cout << stream_io_name(io) << "\t" << stats.error << "，跳过" << endl;
+                break;
+            }
+            
+            // 生成的文件中都是小整数，任何加法顺序都精确；外部文件以第一次的结果为准比较相对误差
+            if (!has_expected) {
+                expected = sum;
+                has_expected = true;
+            }
+            bool correct = abs(sum - expected) <= 1e-9 * abs(expected);
+            double gbs = stats.bytes / stats.seconds / 1.0e9;
+            // 端到端时间包括I/O，工作集按整个文件计
+            string test = string("stream/") + stream_io_name(io);
+            roofline.add(test.c_str(), kernels[k].key, (long long)(stats.bytes / sizeof(double)),
+                         sum_work((long long)(stats.bytes / sizeof(double))), stats.seconds);
+            
+            // 输出结果到控制台
+            cout << stream_io_name(io) << "\t" << kernels[k].name << "\t"
+                 << fixed << setprecision(3) << stats.seconds << "\t\t"
+                 << setprecision(2) << gbs << "\t\t";
+            if (io == IO_MMAP) cout << "-";
+            else cout << setprecision(3) << stats.wait_seconds;
+            cout << "\t\t" << setprecision(3) << stats.compute_seconds << "\t\t"
+                 << setprecision(2) << memory_gbs[k] << "\t\t"
+                 << (correct ? "正确" : "错误") << endl;
+            
+            // 写入CSV文件
+            out_file << bytes / (1 << 20) << "," << stream_io_name(io) << "," << kernels[k].name << ","
+                     << chunk_bytes / 1024 << ","
+                     << fixed << setprecision(6) << stats.seconds << ","
+                     << setprecision(3) << gbs << ",";
+            // mmap下等待缺页的时间包含在计算时间内，不单独给出
+            if (io != IO_MMAP) out_file << setprecision(6) << stats.wait_seconds;
+            out_file << "," << setprecision(6) << stats.compute_seconds << ","
+                     << setprecision(3) << memory_gbs[k] << ","
+                     << (correct ? "正确" : "错误") << endl;
+        }
+    }
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "流式求和测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
 
-    // 小规模：2^7(128) 到 2^13(8192)
-    for (int i = 7; i <= 13; i++) {
-        test_sizes.push_back(1 << i);  // 2的幂
+// 多线程NUMA感知求和测试：扫描线程数，比较主线程串行初始化与首次触摸初始化
+// 串行初始化时整个数组位于主线程所在节点，首次触摸时各段位于负责该段的线程所在节点
+// 时间为bench_run给出的单次调用中位数；并行求和时调用线程由线程池绑定到所在节点的CPU，不再另外绑定
+void test_parallel_sum(int* sizes, int sizes_count, const BenchOptions& options, const char* output_file,
+                       int max_threads) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
     }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    BenchOptions pool_options = options;
+    pool_options.pin_cpu = -1;
     
-    // L1缓存临界点：512KB约等于64K个双精度数
-    // L1缓存临界点附近(60K-70K)细粒度采样
-    int l1_start = 60000;
-    int l1_end = 70000;
-    int l1_step = 1000;
+    // 线程数按2的幂扫描，最后补上max_threads；每种线程数只创建一次线程池
+    vector<ThreadPool*> pools;
+    vector<NumaPlacement> placements;
+    for (int t = 1; ; t *= 2) {
+        if (t > max_threads) t = max_threads;
+        placements.push_back(numa_placement(t));
+        pools.push_back(new ThreadPool(placements.back().thread_cpus));
+        if (t == max_threads) break;
+    }
+    ThreadPartial* partials = new ThreadPartial[max_threads];
     
-    // 找到最接近L1临界点的2的幂
-    int l1_pow2 = 1 << 16;  // 2^16 = 65536
-    test_sizes.push_back(l1_pow2);
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "数组大小,线程数,NUMA节点数,初始化方式,单线程SIMD(秒),并行(秒),带宽(GB/s),加速比,并行效率,各节点带宽(GB/s),结果正确性" << endl;
     
-    // 添加L1临界点周围的额外采样点
-    for (int i = l1_start; i <= l1_end; i += l1_step) {
-        if (i != l1_pow2) {  // 避免重复添加2的幂点
-            test_sizes.push_back(i);
+    // 控制台表头
+    cout << "\n多线程NUMA感知求和测试 (最多" << max_threads << "线程, " << numa_node_cpus().size()
+         << "个NUMA节点, 单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "规模\t线程数\t初始化\t\t单线程SIMD(秒)\t并行(秒)\t带宽(GB/s)\t加速比\t并行效率\t各节点带宽(GB/s)\t结果正确性" << endl;
+    
+    for (int i = 0; i < sizes_count; i++) {
+        int n = sizes[i];
+        
+        // 单线程基准：主线程初始化、主线程求和
+        double* base_arr = new double[n];
+        generate_data(base_arr, n);
+        double expected = sum_naive(base_arr, n);
+        BenchStats single = bench_sum(sum_simd, base_arr, n, options);
+        report.add("parallel", "simd", n, single);
+        roofline.add("parallel", "simd", n, sum_work(n), single.median);
+        double time_single = single.median;
+        delete[] base_arr;
+        
+        for (size_t p = 0; p < pools.size(); p++) {
+            ThreadPool& pool = *pools[p];
+            const NumaPlacement& placement = placements[p];
+            int threads = pool.size();
+            
+            for (int first_touch = 0; first_touch <= 1; first_touch++) {
+                // 每种初始化方式都使用新分配、尚未触摸过的内存
+                double* arr = new double[n];
+                if (first_touch) {
+                    first_touch_generate(pool, arr, n);
+                } else {
+                    generate_data(arr, n);
+                }
+                
+                bool correct = abs(sum_parallel(pool, arr, n, partials) - expected) < 1e-10;
+                
+                // 测试并行求和；每次调用后累计各节点的时间，各节点取其线程中最慢的那个
+                long long calls = 0;
+                vector<double> node_time(placement.num_nodes, 0.0);
+                vector<double> slowest(placement.num_nodes);
+                volatile double sink = 0.0;
+                BenchStats stats = bench_run([&] {
+                    sink = sum_parallel(pool, arr, n, partials);
+                    fill(slowest.begin(), slowest.end(), 0.0);
+                    for (int tid = 0; tid < threads; tid++) {
+                        int node = placement.thread_nodes[tid];
+                        if (partials[tid].seconds > slowest[node]) slowest[node] = partials[tid].seconds;
+                    }
+                    for (int node = 0; node < placement.num_nodes; node++) {
+                        node_time[node] += slowest[node];
+                    }
+                    calls++;
+                }, pool_options);
+                const char* init_name = first_touch ? "首次触摸" : "串行初始化";
+                char kernel[64];
+                snprintf(kernel, sizeof(kernel), "%s_t%d", first_touch ? "first_touch" : "serial_init", threads);
+                report.add("parallel", kernel, n, stats);
+                roofline.add("parallel", kernel, n, sum_work(n), stats.median);
+                double total_time = stats.median;
+                
+                // 各节点读取的数据量
+                vector<double> node_bytes(placement.num_nodes, 0.0);
+                for (int tid = 0; tid < threads; tid++) {
+                    int begin, end;
+                    thread_chunk(n, threads, tid, begin, end);
+                    node_bytes[placement.thread_nodes[tid]] += (double)(end - begin) * sizeof(double);
+                }
+                string node_bandwidth = "";
+                for (int node = 0; node < placement.num_nodes; node++) {
+                    ostringstream item;
+                    item << fixed << setprecision(2) << "node" << node << ":"
+                         << node_bytes[node] * calls / node_time[node] / 1.0e9;
+                    node_bandwidth += (node > 0 ? ";" : "") + item.str();
+                }
+                
+                double bandwidth = bandwidth_gbs(n, total_time);
+                double speedup = time_single / total_time;
+                double efficiency = speedup / threads;
+                
+                // 输出结果到控制台
+                cout << n << "\t" << threads << "\t" << init_name << "\t"
+                     << scientific << setprecision(3) << time_single << "\t"
+                     << total_time << "\t"
+                     << fixed << setprecision(2) << bandwidth << "\t\t"
+                     << speedup << "x\t"
+                     << efficiency << "\t\t"
+                     << node_bandwidth << "\t"
+                     << (correct ? "正确" : "错误") << endl;
+                
+                // 写入CSV文件
+                out_file << n << "," << threads << "," << placement.num_nodes << "," << init_name << ","
+                         << scientific << setprecision(6) << time_single << ","
+                         << total_time << ","
+                         << fixed << setprecision(3) << bandwidth << ","
+                         << speedup << ","
+                         << efficiency << ","
+                         << node_bandwidth << ","
+                         << (correct ? "正确" : "错误") << endl;
+                
+                delete[] arr;
+            }
         }
     }
     
-    // 中等规模：2^17(131072) 到 2^19(524288)
-    for (int i = 17; i <= 19; i++) {
-        test_sizes.push_back(1 << i);
+    for (ThreadPool* pool : pools) {
+        delete pool;
+    }
+    delete[] partials;
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "多线程求和测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// 前缀和结果逐元素比较，并检查返回的总和
+bool scan_matches(const double* expected, const double* actual, int n, double expected_total, double total) {
+    for (int i = 0; i < n; i++) {
+        if (abs(expected[i] - actual[i]) > 1e-10) return false;
+    }
+    return abs(expected_total - total) < 1e-10;
+}
+
+// 前缀和测试：与basic相同的规模扫描(2的幂及各级缓存临界点附近)，包含型和不包含型各一行
+// 比较标量扫描、寄存器内SIMD扫描、多线程两遍扫描和单遍回看扫描；参考结果为标量扫描，逐元素检查
+// 时间为bench_run的单次调用中位数，带宽按读输入、写输出各一次计算
+void test_scan_sum(int* sizes, int sizes_count, const BenchOptions& options, int num_threads,
+                   const vector<ScanKind>& kinds, const char* output_file) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    ThreadPool pool(num_threads);
+    // 输入、输出和参考结果都从内存池中分配，容量按最大规模一次预留
+    int max_n = 0;
+    for (int i = 0; i < sizes_count; i++) {
+        if (sizes[i] > max_n) max_n = sizes[i];
     }
+    BufferArena arena(3 * arena_array_bytes(max_n), options.pages);
+    ThreadPartial* partials = new ThreadPartial[num_threads];
+    void* states = aligned_alloc(CACHE_LINE, scan_lookback_bytes(max_n));
+    const char* simd_name = simd_level_name(detect_simd_level());
     
-    // L2缓存临界点：8MB约等于1M个双精度数
-    // L2缓存临界点附近(950K-1050K)细粒度采样
-    int l2_start = 950000;
-    int l2_end = 1050000;
-    int l2_step = 10000;
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "# 内存池: " << arena.summary() << endl;
+    out_file << "数组大小,类型,标量(秒),SIMD(秒),两遍(秒),回看(秒),SIMD加速比,两遍加速比,回看加速比,"
+             << "标量带宽(GB/s),SIMD带宽(GB/s),两遍带宽(GB/s),回看带宽(GB/s),线程数,结果正确性";
+    write_bench_csv_header(out_file, "标量");
+    write_bench_csv_header(out_file, "SIMD");
+    write_bench_csv_header(out_file, "两遍");
+    write_bench_csv_header(out_file, "回看");
+    write_perf_csv_header(out_file, "标量");
+    write_perf_csv_header(out_file, "SIMD");
+    write_perf_csv_header(out_file, "两遍");
+    write_perf_csv_header(out_file, "回看");
+    out_file << endl;
     
-    // 找到最接近L2临界点的2的幂
-    int l2_pow2 = 1 << 20;  // 2^20 = 1048576
-    test_sizes.push_back(l2_pow2);
+    // 控制台表头
+    cout << "\n前缀和算法性能比较 (单次调用中位数, SIMD=" << simd_name << ", " << num_threads << "线程, 回看块"
+         << scan_tile_doubles(cache_topology()) << "个double):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "内存池: " << arena.summary() << endl;
+    cout << "规模\t类型\t\t标量(秒)\tSIMD(秒)\t两遍(秒)\t回看(秒)\tSIMD加速比\t两遍加速比\t回看加速比\t结果正确性" << endl;
     
-    // 添加L2临界点周围的额外采样点
-    for (int i = l2_start; i <= l2_end; i += l2_step) {
-        if (i != l2_pow2) {  // 避免重复添加2的幂点
-            test_sizes.push_back(i);
+    for (int i = 0; i < sizes_count; i++) {
+        int n = sizes[i];
+        
+        // 从内存池中切出输入、输出和参考结果
+        arena.reset();
+        double* arr = arena.alloc(n);
+        double* out = arena.alloc(n);
+        double* expected = arena.alloc(n);
+        generate_data(arr, n);
+        
+        for (ScanKind kind : kinds) {
+            const char* kind_key = kind == SCAN_INCLUSIVE ? "inclusive" : "exclusive";
+            
+            // 先验证结果正确性（只需验证一次）
+            double expected_total = scan_scalar(arr, expected, n, 0.0, kind);
+            double total = scan_simd(arr, out, n, 0.0, kind);
+            bool correct_simd = scan_matches(expected, out, n, expected_total, total);
+            total = scan_two_pass(pool, arr, out, n, kind, partials);
+            bool correct_two_pass = scan_matches(expected, out, n, expected_total, total);
+            total = scan_lookback(pool, arr, out, n, kind, states);
+            bool correct_lookback = scan_matches(expected, out, n, expected_total, total);
+            
+            BenchStats scalar = bench_run([&] { scan_scalar(arr, out, n, 0.0, kind); }, options);
+            BenchStats simd = bench_run([&] { scan_simd(arr, out, n, 0.0, kind); }, options);
+            BenchStats two_pass = bench_run([&] { scan_two_pass(pool, arr, out, n, kind, partials); }, options);
+            BenchStats lookback = bench_run([&] { scan_lookback(pool, arr, out, n, kind, states); }, options);
+            const BenchStats* all[] = {&scalar, &simd, &two_pass, &lookback};
+            const char* names[] = {"scalar", "simd", "two_pass", "lookback"};
+            for (int k = 0; k < 4; k++) {
+                string name = string(names[k]) + "_" + kind_key;
+                report.add("scan", name.c_str(), n, *all[k]);
+                roofline.add("scan", name.c_str(), n, scan_work(n), all[k]->median);
+            }
+            
+            // 计算加速比和带宽
+            double bytes = scan_work(n).bytes;
+            double speedup_simd = scalar.median / simd.median;
+            double speedup_two_pass = scalar.median / two_pass.median;
+            double speedup_lookback = scalar.median / lookback.median;
+            
+            string correctness = "";
+            if (correct_simd && correct_two_pass && correct_lookback) {
+                correctness = "正确";
+            } else {
+                correctness = "错误";
+                if (!correct_simd) correctness += "-SIMD";
+                if (!correct_two_pass) correctness += "-两遍";
+                if (!correct_lookback) correctness += "-回看";
+            }
+            
+            // 输出结果到控制台
+            cout << n << "\t" << scan_kind_name(kind) << "\t"
+                 << scientific << setprecision(3) << scalar.median << "\t"
+                 << simd.median << "\t"
+                 << two_pass.median << "\t"
+                 << lookback.median << "\t"
+                 << fixed << setprecision(2) << speedup_simd << "x\t\t"
+                 << speedup_two_pass << "x\t\t"
+                 << speedup_lookback << "x\t\t"
+                 << correctness << endl;
+            
+            // 写入CSV文件
+            out_file << n << "," << scan_kind_name(kind) << ","
+                     << scientific << setprecision(6) << scalar.median << ","
+                     << simd.median << ","
+                     << two_pass.median << ","
+                     << lookback.median << ","
+                     << fixed << setprecision(3) << speedup_simd << ","
+                     << speedup_two_pass << ","
+                     << speedup_lookback << ","
+                     << bytes / scalar.median / 1.0e9 << ","
+                     << bytes / simd.median / 1.0e9 << ","
+                     << bytes / two_pass.median / 1.0e9 << ","
+                     << bytes / lookback.median / 1.0e9 << ","
+                     << num_threads << ","
+                     << correctness;
+            write_bench_csv(out_file, scalar);
+            write_bench_csv(out_file, simd);
+            write_bench_csv(out_file, two_pass);
+            write_bench_csv(out_file, lookback);
+            write_perf_csv(out_file, scalar.counters, n);
+            write_perf_csv(out_file, simd.counters, n);
+            write_perf_csv(out_file, two_pass.counters, n);
+            write_perf_csv(out_file, lookback.counters, n);
+            out_file << endl;
         }
     }
     
-    // 大规模：2^21(2097152) 到 2^22(4194304)
-    for (int i = 21; i <= 22; i++) {
-        test_sizes.push_back(1 << i);
+    delete[] partials;
+    free(states);
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "前缀和测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// 融合统计量与参考结果比较：和类统计量允许舍入误差，最值和下标必须完全一致
+bool stats_match(const ArrayStats& expected, const ArrayStats& actual) {
+    auto close = [](double a, double b) { return abs(a - b) <= 1e-12 * max(1.0, abs(a)); };
+    return close(expected.sum, actual.sum) && close(expected.sumsq, actual.sumsq) && close(expected.dot, actual.dot) &&
+           expected.min == actual.min && expected.max == actual.max &&
+           expected.argmin == actual.argmin && expected.argmax == actual.argmax;
+}
+
+// 融合多统计量测试：与basic相同的规模扫描，比较一遍算出全部选中统计量的融合内核、
+// 每个统计量单独调用一次(同样的SIMD内核，各读一遍数组)和多线程融合内核；参考结果为标量融合内核
+// 数据为均匀分布随机数(最值唯一)，点积的第二个数组为固定模式；带宽按各自实际读取的字节数计算
+void test_stats_sum(int* sizes, int sizes_count, const BenchOptions& options, int num_threads, unsigned mask,
+                    const char* output_file) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
     }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    ThreadPool pool(num_threads);
+    int max_n = 0;
+    for (int i = 0; i < sizes_count; i++) {
+        if (sizes[i] > max_n) max_n = sizes[i];
+    }
+    bool dot = (mask & STAT_DOT) != 0;
+    BufferArena arena((dot ? 2 : 1) * arena_array_bytes(max_n), options.pages);
+    ArrayStats* partials = new ArrayStats[num_threads];
+    const StatsKernel* scalar_table = stats_table_for(SIMD_SCALAR);
+    string mask_name = stat_mask_name(mask);
+    int fused_passes = stats_passes(mask, true);
+    int separate_passes = stats_passes(mask, false);
+    double flops = stats_flops_per_element(mask);
     
-    // L3缓存临界点：16MB约等于2M个双精度数
-    // L3缓存临界点附近(1.95M-2.05M)细粒度采样
-    int l3_start = 1950000;
-    int l3_end = 2050000;
-    int l3_step = 10000;
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "# 内存池: " << arena.summary() << endl;
+    out_file << "数组大小,统计量,融合(秒),分别调用(秒),多线程融合(秒),融合加速比,多线程加速比,"
+             << "融合带宽(GB/s),分别调用带宽(GB/s),多线程带宽(GB/s),融合读取(MB),分别调用读取(MB),节省读取(%),"
+             << "线程数,结果正确性";
+    write_bench_csv_header(out_file, "融合");
+    write_bench_csv_header(out_file, "分别调用");
+    write_bench_csv_header(out_file, "多线程融合");
+    write_perf_csv_header(out_file, "融合");
+    write_perf_csv_header(out_file, "分别调用");
+    write_perf_csv_header(out_file, "多线程融合");
+    out_file << endl;
     
-    // 添加L3临界点周围的额外采样点
-    for (int i = l3_start; i <= l3_end; i += l3_step) {
-        if (i != (1 << 21)) {  // 避免重复添加2的幂点
-            test_sizes.push_back(i);
+    // 控制台表头
+    cout << "\n融合多统计量规约性能比较 (单次调用中位数, SIMD=" << simd_level_name(detect_simd_level()) << ", "
+         << num_threads << "线程, 统计量=" << mask_name << ", 融合读" << fused_passes << "遍/分别调用读"
+         << separate_passes << "遍):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "内存池: " << arena.summary() << endl;
+    cout << "规模\t\t融合(秒)\t分别调用(秒)\t多线程(秒)\t融合加速比\t多线程加速比\t融合带宽(GB/s)\t结果正确性" << endl;
+    
+    for (int i = 0; i < sizes_count; i++) {
+        int n = sizes[i];
+        
+        arena.reset();
+        double* x = arena.alloc(n);
+        double* y = dot ? arena.alloc(n) : nullptr;
+        generate_distribution(x, n, DIST_UNIFORM);
+        for (int k = 0; dot && k < n; k++) {
+            y[k] = (k % 7 + 1) * 0.125;
+        }
+        
+        // 先验证结果正确性（只需验证一次）
+        ArrayStats expected = scalar_table[mask](x, y, n);
+        bool correct_fused = stats_match(expected, array_stats(x, y, n, mask));
+        bool correct_separate = stats_match(expected, array_stats_separate(x, y, n, mask));
+        bool correct_parallel = stats_match(expected, array_stats_parallel(pool, x, y, n, mask, partials));
+        
+        BenchStats fused = bench_run([&] { array_stats(x, y, n, mask); }, options);
+        BenchStats separate = bench_run([&] { array_stats_separate(x, y, n, mask); }, options);
+        BenchStats parallel = bench_run([&] { array_stats_parallel(pool, x, y, n, mask, partials); }, options);
+        RooflineWork fused_work = stats_work(n, dot ? 2 : 1, fused_passes, flops);
+        RooflineWork separate_work = stats_work(n, dot ? 2 : 1, separate_passes, flops);
+        report.add("stats", "fused", n, fused);
+        report.add("stats", "separate", n, separate);
+        report.add("stats", "parallel", n, parallel);
+        roofline.add("stats", "fused", n, fused_work, fused.median);
+        roofline.add("stats", "separate", n, separate_work, separate.median);
+        roofline.add("stats", "parallel", n, fused_work, parallel.median);
+        
+        // 计算加速比、带宽和节省的读取量
+        double speedup_fused = separate.median / fused.median;
+        double speedup_parallel = separate.median / parallel.median;
+        double saved = (1.0 - fused_work.bytes / separate_work.bytes) * 100;
+        
+        string correctness = "";
+        if (correct_fused && correct_separate && correct_parallel) {
+            correctness = "正确";
+        } else {
+            correctness = "错误";
+            if (!correct_fused) correctness += "-融合";
+            if (!correct_separate) correctness += "-分别调用";
+            if (!correct_parallel) correctness += "-多线程";
         }
+        
+        // 输出结果到控制台
+        cout << n << "\t\t"
+             << scientific << setprecision(3) << fused.median << "\t"
+             << separate.median << "\t"
+             << parallel.median << "\t"
+             << fixed << setprecision(2) << speedup_fused << "x\t\t"
+             << speedup_parallel << "x\t\t"
+             << fused_work.bytes / fused.median / 1.0e9 << "\t\t"
+             << correctness << endl;
+        
+        // 写入CSV文件
+        out_file << n << "," << mask_name << ","
+                 << scientific << setprecision(6) << fused.median << ","
+                 << separate.median << ","
+                 << parallel.median << ","
+                 << fixed << setprecision(3) << speedup_fused << ","
+                 << speedup_parallel << ","
+                 << fused_work.bytes / fused.median / 1.0e9 << ","
+                 << separate_work.bytes / separate.median / 1.0e9 << ","
+                 << fused_work.bytes / parallel.median / 1.0e9 << ","
+                 << fused_work.bytes / 1.0e6 << ","
+                 << separate_work.bytes / 1.0e6 << ","
+                 << saved << ","
+                 << num_threads << ","
+                 << correctness;
+        write_bench_csv(out_file, fused);
+        write_bench_csv(out_file, separate);
+        write_bench_csv(out_file, parallel);
+        write_perf_csv(out_file, fused.counters, n);
+        write_perf_csv(out_file, separate.counters, n);
+        write_perf_csv(out_file, parallel.counters, n);
+        out_file << endl;
     }
     
-    // 超大规模：2^23(8388608) 到 2^25(33554432)
-    for (int i = 23; i <= 25; i++) {
-        test_sizes.push_back(1 << i);
+    delete[] partials;
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "多统计量测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// run模式的内核注册表：第一个为参考内核(平凡算法)，新内核在这里登记一行即可参与按命令行选择的测试
+KernelRegistry build_sum_registry() {
+    KernelRegistry registry;
+    registry.kind = KERNEL_SUM;
+    registry.default_output = "zixuan_sum.csv";
+    registry.fill_array = generate_data;
+
+    auto serial = [&](const char* name, const char* description, SumKernel kernel) {
+        KernelEntry entry;
+        entry.name = name;
+        entry.description = description;
+        entry.call = [kernel](const KernelArgs& a) { return kernel(a.arr, a.n); };
+        registry.add(entry);
+    };
+    serial("naive", "平凡算法", sum_naive);
+    serial("two_way", "两路链式", sum_two_way);
+
+    KernelEntry reduction;
+    reduction.name = "reduction";
+    reduction.description = "递归规约(原地修改输入)";
+    reduction.call = [](const KernelArgs& a) { return sum_reduction(a.work, a.n); };
+    reduction.in_place = true;
+    registry.add(reduction);
+
+    serial("tree", "树形规约", sum_tree);
+    serial("unroll4", "4路展开", sum_unroll4);
+    serial("unroll8", "8路展开", sum_unroll8);
+    for (const UnrolledSum& config : sum_unroll_grid()) {
+        string name = "unroll" + to_string(config.unroll) + "x" + to_string(config.accumulators);
+        string description = to_string(config.unroll) + "路展开" + to_string(config.accumulators) + "累加器";
+        serial(name.c_str(), description.c_str(), config.kernel);
+    }
+    const SimdLevel simd_levels[] = {SIMD_SSE2, SIMD_AVX2, SIMD_AVX512};
+    for (SimdLevel level : simd_levels) {
+        SumKernel kernel = sum_kernel_for(level);
+        if (kernel == nullptr) continue;
+        string name = string("simd_") + (level == SIMD_SSE2 ? "sse2" : level == SIMD_AVX2 ? "avx2" : "avx512");
+        serial(name.c_str(), simd_level_name(level), kernel);
     }
+    serial("pairwise", "分块两两求和", sum_pairwise);
+    serial("neumaier", "Neumaier补偿求和", sum_neumaier);
+    serial("compensated", "向量化补偿求和", sum_compensated);
+
+    // 前缀和内核把包含型前缀和写入a.work，返回的总和与参考内核的和比较
+    const SimdLevel scan_levels[] = {SIMD_AVX2, SIMD_AVX512};
+    KernelEntry scan;
+    scan.name = "scan_scalar";
+    scan.description = "标量包含型前缀和";
+    scan.call = [](const KernelArgs& a) { return scan_scalar(a.arr, a.work, a.n, 0.0, SCAN_INCLUSIVE); };
+    scan.work = scan_work;
+    registry.add(scan);
+    for (SimdLevel level : scan_levels) {
+        ScanKernel kernel = scan_kernel_for(level);
+        if (kernel == nullptr) continue;
+        scan.name = string("scan_") + (level == SIMD_AVX2 ? "avx2" : "avx512");
+        scan.description = string(simd_level_name(level)) + "寄存器内前缀和";
+        scan.call = [kernel](const KernelArgs& a) { return kernel(a.arr, a.work, a.n, 0.0, SCAN_INCLUSIVE); };
+        registry.add(scan);
+    }
+    scan.name = "scan_two_pass";
+    scan.description = "多线程两遍前缀和(先规约再扫描)";
+    scan.call = [](const KernelArgs& a) {
+        return scan_two_pass(*a.pool, a.arr, a.work, a.n, SCAN_INCLUSIVE, (ThreadPartial*)a.scratch);
+    };
+    scan.threaded = true;
+    scan.scratch_bytes = [](int, int threads) { return threads * sizeof(ThreadPartial); };
+    registry.add(scan);
+    scan.name = "scan_lookback";
+    scan.description = "多线程单遍回看前缀和";
+    scan.call = [](const KernelArgs& a) {
+        return scan_lookback(*a.pool, a.arr, a.work, a.n, SCAN_INCLUSIVE, a.scratch);
+    };
+    scan.scratch_bytes = [](int n, int) { return scan_lookback_bytes(n); };
+    registry.add(scan);
+
+    // 融合统计量内核一遍算出和、最值及下标、平方和(点积需要第二个数组，不登记)，返回其中的和
+    const unsigned stats_mask = STAT_ALL & ~STAT_DOT;
+    KernelEntry stats;
+    stats.name = "stats_fused";
+    stats.description = "融合多统计量规约";
+    stats.call = [stats_mask](const KernelArgs& a) { return array_stats(a.arr, nullptr, a.n, stats_mask).sum; };
+    stats.work = [](long long n) { return stats_work(n, 1, 1, stats_flops_per_element(STAT_ALL & ~STAT_DOT)); };
+    registry.add(stats);
+    stats.name = "stats_parallel";
+    stats.description = "多线程融合多统计量规约";
+    stats.call = [stats_mask](const KernelArgs& a) {
+        return array_stats_parallel(*a.pool, a.arr, nullptr, a.n, stats_mask, (ArrayStats*)a.scratch).sum;
+    };
+    stats.threaded = true;
+    stats.scratch_bytes = [](int, int threads) { return threads * sizeof(ArrayStats); };
+    registry.add(stats);
+
+    KernelEntry parallel;
+    parallel.name = "parallel";
+    parallel.description = "多线程SIMD求和";
+    parallel.call = [](const KernelArgs& a) {
+        return sum_parallel(*a.pool, a.arr, a.n, (ThreadPartial*)a.scratch);
+    };
+    parallel.threaded = true;
+    parallel.scratch_bytes = [](int, int threads) { return threads * sizeof(ThreadPartial); };
+    registry.add(parallel);
+    return registry;
+}
+
+// 用法: array_sum [basic] [advanced] [accuracy] [parallel] [stream] [scan] [stats] [run] [--threads=N]
+//       scan模式: [--scan=inclusive|exclusive|both] [--threads=N]
+//       stats模式: [--stats=sum,min,max,argmin,argmax,sumsq,dot|all] [--threads=N]
+//       run模式: [--list] [--kernels=naive,simd_avx512,...] [--sizes=1024:1048576:x2] [--threads=1,2,4]
+//                [--runs=N] [--pages=4k,2m] [--out=zixuan_sum.csv] [--roofline=0]
+//       stream模式: [--file=路径] [--stream-mb=2048] [--io=mmap,pread,direct] [--chunk-kb=8192]
+//       basic/advanced计时: [--warmup=3] [--min-runs=5] [--max-runs=1000] [--ci=0.01]
+//                           [--max-seconds=0.5] [--pin=CPU] [--clock=tsc|clock] [--counters=1|0]
+//                           [--pages=4k|thp|2m|1g]
+// 不指定模式时运行basic和advanced
+int main(int argc, char** argv) {
+    srand(time(NULL));
+    
+    // 缓存临界点按本机检测到的缓存大小计算，而不是写死的L1=512KB、L2=8MB、L3=16MB
+    const CacheTopology& topo = cache_topology();
+    
+    // 根据不同规模范围设置2的幂次方测试规模
+    vector<int> test_sizes;
+
+    // 2^7(128) 起，至少到2^25(33554432)；L3更大时延伸到L3临界点的2倍以上(最多2^27)
+    int max_pow = 25;
+    while (max_pow < 27 && (1LL << max_pow) < 2LL * array_boundary(topo, 3)) {
+        max_pow++;
+    }
+    for (int i = 7; i <= max_pow; i++) {
+        test_sizes.push_back(1 << i);  // 2的幂
+    }
+    
+    // 各级缓存临界点：数组恰好填满该级缓存时的double个数
+    // 临界点附近±8%细粒度采样，每级约11个点
+    for (int level = 1; level <= 3; level++) {
+        int boundary = array_boundary(topo, level);
+        if (boundary > 0) {
+            add_samples_around(test_sizes, boundary, 0.08, 10);
+        }
+    }
+    sort_unique(test_sizes);
     
     // 将vector转换为数组
     int sizes_count = test_sizes.size();
@@ -434,21 +1415,107 @@ int main() {
         sizes[i] = test_sizes[i];
     }
     
-    // 对规模排序，确保按大小顺序测试
-    sort(sizes, sizes + sizes_count);
-    
-    int test_count = 50;  // 每个规模测试50次
-    
     cout << "========== 数组求和算法性能测试 ==========" << endl;
     cout << "使用2的幂次方规模测试，并在缓存临界点周围进行细粒度采样" << endl;
-    cout << "共" << sizes_count << "个规模，每个规模测试" << test_count << "次" << endl;
-    cout << "L1缓存临界点(~64K), L2缓存临界点(~1M), L3缓存临界点(~2M)" << endl;
+    cout << "共" << sizes_count << "个规模，各模式由bench_run按置信区间自适应重复" << endl;
+    cout << "缓存拓扑: " << topology_summary(topo) << endl;
+    cout << "L1缓存临界点(~" << array_boundary(topo, 1) << "), L2缓存临界点(~" << array_boundary(topo, 2)
+         << "), L3缓存临界点(~" << array_boundary(topo, 3) << ")" << endl;
+    
+    // 按命令行选择内核和规模，只运行这一项
+    if (has_mode(argc, argv, "run")) {
+        int status = run_registry(build_sum_registry(), test_sizes, argc, argv);
+        delete[] sizes;
+        return status;
+    }
+    
+    bool run_default = !any_mode(argc, argv);
+    BenchOptions bench_options = bench_options_from_cli(argc, argv);
     
     // 基础算法测试
-    test_basic_sum(sizes, sizes_count, test_count, "jichu_sum.csv");
+    if (run_default || has_mode(argc, argv, "basic")) {
+        test_basic_sum(sizes, sizes_count, bench_options, "jichu_sum.csv");
+    }
     
     // 进阶算法测试
-    test_advanced_sum(sizes, sizes_count, test_count, "jinjie_sum.csv");
+    if (run_default || has_mode(argc, argv, "advanced")) {
+        test_advanced_sum(sizes, sizes_count, bench_options, "jinjie_sum.csv");
+    }
+    
+    // 求和精度测试：误差只随n增长，只测2的幂规模
+    if (has_mode(argc, argv, "accuracy")) {
+        vector<int> pow2_sizes;
+        for (int i = 0; i < sizes_count; i++) {
+            if ((sizes[i] & (sizes[i] - 1)) == 0) pow2_sizes.push_back(sizes[i]);
+        }
+        test_accuracy_sum(pow2_sizes.data(), (int)pow2_sizes.size(), bench_options, "jingdu_sum.csv");
+    }
+    
+    // 多线程NUMA感知求和：只测2^23及以上、超出L3的规模
+    if (has_mode(argc, argv, "parallel")) {
+        int max_threads = atoi(get_option(argc, argv, "threads", "0"));
+        if (max_threads <= 0) max_threads = (int)allowed_cpus().size();
+        int first_large = 0;
+        while (first_large < sizes_count && sizes[first_large] < (1 << 23)) {
+            first_large++;
+        }
+        test_parallel_sum(sizes + first_large, sizes_count - first_large, bench_options, "bingxing_sum.csv", max_threads);
+    }
+    
+    // 前缀和：与basic相同的规模扫描，--scan选择包含型/不包含型
+    if (has_mode(argc, argv, "scan")) {
+        int scan_threads = atoi(get_option(argc, argv, "threads", "0"));
+        if (scan_threads <= 0) scan_threads = (int)allowed_cpus().size();
+        string scan_kind = get_option(argc, argv, "scan", "both");
+        vector<ScanKind> kinds;
+        if (scan_kind != "exclusive") kinds.push_back(SCAN_INCLUSIVE);
+        if (scan_kind != "inclusive") kinds.push_back(SCAN_EXCLUSIVE);
+        test_scan_sum(sizes, sizes_count, bench_options, scan_threads, kinds, "qianzhui_sum.csv");
+    }
+    
+    // 融合多统计量规约：与basic相同的规模扫描，--stats选择要算的统计量
+    if (has_mode(argc, argv, "stats")) {
+        int stats_threads = atoi(get_option(argc, argv, "threads", "0"));
+        if (stats_threads <= 0) stats_threads = (int)allowed_cpus().size();
+        unsigned mask = parse_stat_mask(get_option(argc, argv, "stats", "all"));
+        if (mask == 0) {
+            cout << "无法识别的--stats，可选: sum,min,max,argmin,argmax,sumsq,dot,all" << endl;
+            delete[] sizes;
+            return 1;
+        }
+        test_stats_sum(sizes, sizes_count, bench_options, stats_threads, mask, "tongji_sum.csv");
+    }
+    
+    // 流式求和：未给出--file时生成临时文件，测完删除
+    if (has_mode(argc, argv, "stream")) {
+        const char* path = get_option(argc, argv, "file", nullptr);
+        bool generated = path == nullptr;
+        double expected = 0.0;
+        if (generated) {
+            path = "array_sum_stream.bin";
+            size_t n = (size_t)atoll(get_option(argc, argv, "stream-mb", "2048")) * (1 << 20) / sizeof(double);
+            cout << "生成测试文件 " << path << " (" << n << "个double)..." << endl;
+            if (!write_data_file(path, n)) {
+                cout << "无法创建文件: " << path << endl;
+                delete[] sizes;
+                return 1;
+            }
+            // 每10个元素之和为55，其余部分为1+2+...+r
+            size_t r = n % 10;
+            expected = (double)(n / 10) * 55.0 + (double)(r * (r + 1) / 2);
+        }
+        
+        vector<StreamIo> ios;
+        for (const string& item : split_list(get_option(argc, argv, "io", "mmap,pread,direct"))) {
+            if (item == "mmap") ios.push_back(IO_MMAP);
+            else if (item == "pread") ios.push_back(IO_PREAD);
+            else if (item == "direct") ios.push_back(IO_DIRECT);
+        }
+        size_t chunk_bytes = (size_t)atoll(get_option(argc, argv, "chunk-kb", "8192")) * 1024;
+        chunk_bytes = (chunk_bytes + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN;
+        test_stream_sum(path, ios, chunk_bytes, expected, generated, bench_options, "liushi_sum.csv");
+        if (generated) remove(path);
+    }
     
     delete[] sizes;
     return 0;
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cpuid.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "arena.h"
+#include "cli_options.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+
+// 统计上稳健的计时：预热、自适应重复次数、分位数与离群值处理、绑核，
+// 用rdtsc(不变TSC时)或clock_gettime计时并扣除计时本身的开销
+//
+// 每个样本为一次(或若干次，见calls_per_sample)调用的耗时，统计量都换算为单次调用的秒数。
+// 离群值按Tukey外围栏(Q1-3*IQR, Q3+3*IQR)识别，只从均值、标准差和置信区间中剔除，
+// 最小值和各分位数用全部样本；重复直到均值95%置信区间的相对半宽不超过target_ci。
+// 计时结束后再单独运行min_runs个样本统计硬件计数器，计数器的启停不影响计时
+
+enum BenchClock {
+    BENCH_CLOCK_TSC,       // rdtsc，前后用lfence隔开；TSC不是不变TSC时退回clock_gettime
+    BENCH_CLOCK_MONOTONIC  // clock_gettime(CLOCK_MONOTONIC)
+};
+
+struct BenchOptions {
+    int warmup_runs = 3;              // 预热调用次数，不计入统计(缺页、冷缓存、分支预测器)
+    int min_runs = 5;                 // 最少样本数
+    int max_runs = 1000;              // 最多样本数
+    double target_ci = 0.01;          // 均值95%置信区间相对半宽的目标
+    double max_seconds = 0.5;         // 已达min_runs后，计时累计超过该时间即停止(即使未收敛)
+    double min_sample_seconds = 2e-6; // 单次调用短于此时，把多次调用合成一个样本
+    int pin_cpu = -1;                 // >=0时计时期间把调用线程绑定到该CPU
+    BenchClock clock = BENCH_CLOCK_TSC;
+    bool counters = true;             // 是否统计硬件性能计数器(不可用时自动跳过)
+    PageBacking pages = PAGES_2M;     // 测试数据所在内存池的页面(不可用时依次回退，见arena.h)
+};
+
+struct BenchStats {
+    int samples = 0;           // 样本数
+    int calls_per_sample = 1;  // 每个样本包含的调用次数
+    int outliers = 0;          // 被剔除的离群样本数
+    bool converged = false;    // 是否达到target_ci
+    double min = 0.0;          // 以下均为单次调用的秒数
+    double median = 0.0;
+    double mean = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double stddev = 0.0;
+    double ci = 0.0;           // 均值95%置信区间的相对半宽
+    PerfCounts counters;       // 单次调用的平均事件数
+};
+
+// ---------------- 计时器 ----------------
+
+// 不变TSC(cpuid 0x80000007 EDX[8])：频率恒定，且不随C状态停止，可直接换算为时间
+inline bool invariant_tsc_supported() {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+    return (edx >> 8) & 1;
+}
+
+inline uint64_t bench_ticks(BenchClock clock) {
+    if (clock == BENCH_CLOCK_TSC) {
+        _mm_lfence();
+        uint64_t t = __rdtsc();
+        _mm_lfence();
+        return t;
+    }
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct BenchTimer {
+    BenchClock clock;           // 实际使用的时钟
+    double seconds_per_tick;
+    double overhead_ticks;      // 连续两次读时钟的最小差值，每个样本扣除一次
+};
+
+inline BenchTimer calibrate_timer(BenchClock clock) {
+    BenchTimer timer;
+    timer.clock = clock == BENCH_CLOCK_TSC && invariant_tsc_supported() ? BENCH_CLOCK_TSC : BENCH_CLOCK_MONOTONIC;
+    timer.seconds_per_tick = 1e-9;
+    if (timer.clock == BENCH_CLOCK_TSC) {
+        // 对照steady_clock测20ms内的TSC增量
+        auto start = std::chrono::steady_clock::now();
+        uint64_t t0 = bench_ticks(BENCH_CLOCK_TSC);
+        double elapsed = 0.0;
+        while (elapsed < 0.02) {
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        uint64_t t1 = bench_ticks(BENCH_CLOCK_TSC);
+        timer.seconds_per_tick = elapsed / (double)(t1 - t0);
+    }
+    uint64_t best = UINT64_MAX;
+    for (int k = 0; k < 1000; k++) {
+        uint64_t a = bench_ticks(timer.clock);
+        uint64_t b = bench_ticks(timer.clock);
+        if (b - a < best) best = b - a;
+    }
+    timer.overhead_ticks = (double)best;
+    return timer;
+}
+
+// 每种时钟只校准一次
+inline const BenchTimer& bench_timer(BenchClock clock) {
+    static const BenchTimer tsc = calibrate_timer(BENCH_CLOCK_TSC);
+    static const BenchTimer monotonic = calibrate_timer(BENCH_CLOCK_MONOTONIC);
+    return clock == BENCH_CLOCK_TSC ? tsc : monotonic;
+}
+
+inline const char* bench_clock_name(BenchClock clock) {
+    return clock == BENCH_CLOCK_TSC ? "rdtsc" : "clock_gettime";
+}
+
+// ---------------- 统计 ----------------
+
+// 已排序样本的p分位数(线性插值)
+inline double percentile_sorted(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    double pos = p * (sorted.size() - 1);
+    size_t lo = (size_t)pos;
+    size_t hi = lo + 1 < sorted.size() ? lo + 1 : lo;
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * (pos - lo);
+}
+
+inline BenchStats summarize_samples(const std::vector<double>& samples) {
+    BenchStats stats;
+    stats.samples = (int)samples.size();
+    if (samples.empty()) return stats;
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    stats.min = sorted.front();
+    stats.median = percentile_sorted(sorted, 0.5);
+    stats.p90 = percentile_sorted(sorted, 0.9);
+    stats.p99 = percentile_sorted(sorted, 0.99);
+
+    double q1 = percentile_sorted(sorted, 0.25);
+    double q3 = percentile_sorted(sorted, 0.75);
+    double low = q1 - 3.0 * (q3 - q1);
+    double high = q3 + 3.0 * (q3 - q1);
+    double sum = 0.0;
+    int kept = 0;
+    for (double s : sorted) {
+        if (s < low || s > high) continue;
+        sum += s;
+        kept++;
+    }
+    stats.outliers = stats.samples - kept;
+    stats.mean = sum / kept;
+    double sq = 0.0;
+    for (double s : sorted) {
+        if (s < low || s > high) continue;
+        sq += (s - stats.mean) * (s - stats.mean);
+    }
+    stats.stddev = kept > 1 ? std::sqrt(sq / (kept - 1)) : 0.0;
+    stats.ci = kept > 1 && stats.mean > 0.0 ? 1.96 * stats.stddev / std::sqrt((double)kept) / stats.mean : 0.0;
+    return stats;
+}
+
+// ---------------- 计时 ----------------
+
+// 计时期间绑定到指定CPU，析构时恢复原来的亲和性
+class ScopedPin {
+public:
+    explicit ScopedPin(int cpu) : pinned_(false) {
+        if (cpu < 0) return;
+        CPU_ZERO(&saved_);
+        if (sched_getaffinity(0, sizeof(saved_), &saved_) != 0) return;
+        pinned_ = pin_thread(pthread_self(), cpu);
+    }
+    ~ScopedPin() {
+        if (pinned_) pthread_setaffinity_np(pthread_self(), sizeof(saved_), &saved_);
+    }
+    ScopedPin(const ScopedPin&) = delete;
+    ScopedPin& operator=(const ScopedPin&) = delete;
+
+private:
+    bool pinned_;
+    cpu_set_t saved_;
+};
+
+// setup在每个样本之前调用且不计时(例如为原地修改输入的算法恢复输入)；
+// 有setup时每个样本只含一次调用
+template <typename Call, typename Setup>
+BenchStats bench_run(Call call, Setup setup, bool has_setup, const BenchOptions& options) {
+    ScopedPin pin(options.pin_cpu);
+    const BenchTimer& timer = bench_timer(options.clock);
+
+    for (int w = 0; w < options.warmup_runs; w++) {
+        setup();
+        call();
+    }
+
+    // 单次调用太短时合并多次调用，使计时开销和时钟分辨率相对可以忽略
+    int calls_per_sample = 1;
+    if (!has_setup) {
+        uint64_t t0 = bench_ticks(timer.clock);
+        call();
+        uint64_t t1 = bench_ticks(timer.clock);
+        double once = ((double)(t1 - t0) - timer.overhead_ticks) * timer.seconds_per_tick;
+        if (once < options.min_sample_seconds) {
+            double calls = options.min_sample_seconds / (once > 1e-9 ? once : 1e-9);
+            calls_per_sample = calls > 1e6 ? 1000000 : (int)std::ceil(calls);
+        }
+    }
+
+    std::vector<double> samples;
+    samples.reserve(options.max_runs);
+    double elapsed = 0.0;
+    BenchStats stats;
+    while ((int)samples.size() < options.max_runs) {
+        setup();
+        uint64_t t0 = bench_ticks(timer.clock);
+        for (int c = 0; c < calls_per_sample; c++) {
+            call();
+        }
+        uint64_t t1 = bench_ticks(timer.clock);
+        double seconds = ((double)(t1 - t0) - timer.overhead_ticks) * timer.seconds_per_tick;
+        if (seconds < 0.0) seconds = 0.0;
+        elapsed += seconds;
+        samples.push_back(seconds / calls_per_sample);
+
+        if ((int)samples.size() < options.min_runs) continue;
+        stats = summarize_samples(samples);
+        if (stats.ci <= options.target_ci || elapsed >= options.max_seconds) break;
+    }
+
+    stats = summarize_samples(samples);
+    stats.calls_per_sample = calls_per_sample;
+    stats.converged = stats.ci <= options.target_ci;
+
+    if (options.counters && perf_counters_available()) {
+        PerfCounterGroup group(perf_probe().split);
+        for (int r = 0; r < options.min_runs; r++) {
+            setup();
+            group.start();
+            for (int c = 0; c < calls_per_sample; c++) {
+                call();
+            }
+            group.stop(calls_per_sample);
+        }
+        stats.counters = group.take();
+    }
+    return stats;
+}
+
+template <typename Call>
+BenchStats bench_run(Call call, const BenchOptions& options) {
+    return bench_run(call, [] {}, false, options);
+}
+
+// 命令行: --warmup=3 --min-runs=5 --max-runs=1000 --ci=0.01 --max-seconds=0.5
+//         --pin=CPU(默认第一个允许的CPU，-1不绑定) --clock=tsc|clock --counters=1|0 --runs=N
+//         --pages=4k|thp|2m|1g
+inline BenchOptions bench_options_from_cli(int argc, char** argv) {
+    BenchOptions options;
+    options.warmup_runs = atoi(get_option(argc, argv, "warmup", "3"));
+    options.min_runs = atoi(get_option(argc, argv, "min-runs", "5"));
+    options.max_runs = atoi(get_option(argc, argv, "max-runs", "1000"));
+    options.target_ci = atof(get_option(argc, argv, "ci", "0.01"));
+    options.max_seconds = atof(get_option(argc, argv, "max-seconds", "0.5"));
+    const char* pin = get_option(argc, argv, "pin", nullptr);
+    options.pin_cpu = pin != nullptr ? atoi(pin) : allowed_cpus()[0];
+    options.clock = strcmp(get_option(argc, argv, "clock", "tsc"), "clock") == 0 ? BENCH_CLOCK_MONOTONIC
+                                                                                 : BENCH_CLOCK_TSC;
+    options.counters = atoi(get_option(argc, argv, "counters", "1")) != 0;
+    // --pages=4k|thp|2m|1g，run模式可给出列表，这里取第一个
+    std::string pages = get_option(argc, argv, "pages", "2m");
+    pages = pages.substr(0, pages.find(','));
+    parse_page_backing(pages.c_str(), options.pages);
+    // --runs=N：固定N个样本，不再自适应
+    const char* runs = get_option(argc, argv, "runs", nullptr);
+    if (runs != nullptr && atoi(runs) > 0) {
+        options.min_runs = options.max_runs = atoi(runs);
+    }
+    if (options.min_runs < 2) options.min_runs = 2;
+    if (options.max_runs < options.min_runs) options.max_runs = options.min_runs;
+    return options;
+}
+
+inline std::string bench_options_summary(const BenchOptions& options) {
+    const BenchTimer& timer = bench_timer(options.clock);
+    std::string counters = "开启";
+    if (!options.counters) {
+        counters = "关闭";
+    } else if (!perf_counters_available()) {
+        counters = std::string("不可用(") + strerror(perf_probe().error) + ")，计数器列留空";
+    } else if (perf_probe().split) {
+        counters = "开启(事件组超出PMU计数器，每个事件单独分时复用)";
+    }
+    char buffer[384];
+    snprintf(buffer, sizeof(buffer), "%s(开销%.1fns), 预热%d次, 样本%d~%d个, 目标置信区间±%.1f%%, 绑定CPU %d, 硬件计数器%s",
+             bench_clock_name(timer.clock), timer.overhead_ticks * timer.seconds_per_tick * 1e9,
+             options.warmup_runs, options.min_runs, options.max_runs, options.target_ci * 100, options.pin_cpu,
+             counters.c_str());
+    return buffer;
+}
+
+// ---------------- 输出 ----------------
+
+// CSV中每个内核的统计列，name为内核名；主列(中位数)由调用者单独输出
+inline void write_bench_csv_header(std::ostream& out, const char* name) {
+    out << "," << name << "最小(秒)," << name << "均值(秒)," << name << "P90(秒)," << name << "P99(秒),"
+        << name << "标准差(秒)," << name << "置信区间(%)," << name << "样本数," << name << "离群样本数";
+}
+
+inline void write_bench_csv(std::ostream& out, const BenchStats& stats) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), ",%.9g,%.9g,%.9g,%.9g,%.9g,%.3f,%d,%d", stats.min, stats.mean, stats.p90,
+             stats.p99, stats.stddev, stats.ci * 100, stats.samples, stats.outliers);
+    out << buffer;
+}
+
+// 收集各内核的统计结果，写成JSON：{"timer": {...}, "results": [{...}, ...]}
+class BenchReport {
+public:
+    explicit BenchReport(const BenchOptions& options) : options_(options) {}
+
+    void add(const char* test, const char* kernel, long long n, const BenchStats& stats) {
+        char buffer[768];
+        snprintf(buffer, sizeof(buffer),
+                 "{\"test\": \"%s\", \"kernel\": \"%s\", \"n\": %lld, \"samples\": %d, \"calls_per_sample\": %d, "
+                 "\"outliers\": %d, \"converged\": %s, \"min\": %.9g, \"median\": %.9g, \"mean\": %.9g, "
+                 "\"p90\": %.9g, \"p99\": %.9g, \"stddev\": %.9g, \"ci\": %.6g}",
+                 test, kernel, n, stats.samples, stats.calls_per_sample, stats.outliers,
+                 stats.converged ? "true" : "false", stats.min, stats.median, stats.mean, stats.p90, stats.p99,
+                 stats.stddev, stats.ci);
+        std::string record(buffer);
+        // 计数器为单次调用的平均事件数，不可用的为null
+        record.pop_back();
+        record += ", \"counters\": {";
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            if (stats.counters.valid[e]) {
+                snprintf(buffer, sizeof(buffer), "\"%s\": %.6g", perf_event_name((PerfEvent)e), stats.counters.value[e]);
+            } else {
+                snprintf(buffer, sizeof(buffer), "\"%s\": null", perf_event_name((PerfEvent)e));
+            }
+            record += buffer;
+            if (e + 1 < PERF_EVENT_COUNT) record += ", ";
+        }
+        record += "}";
+        snprintf(buffer, sizeof(buffer), ", \"counters_unscheduled\": %d}", stats.counters.unscheduled);
+        record += buffer;
+        records_.push_back(record);
+        // 计数器整次测量都没有被调度的内核，在CSV末尾注明
+        if (!stats.counters.any() && stats.counters.unscheduled > 0) {
+            unscheduled_.push_back(std::string(test) + "/" + kernel + "@" + std::to_string(n));
+        }
+    }
+
+    // 有计数器没有被调度的内核时写一行"# 计数器未调度"注释(PMU计数器被其他perf用户或NMI watchdog占用)，
+    // 说明对应的计数器列为什么留空；全部正常时不写
+    void write_csv_note(std::ostream& out) const {
+        if (unscheduled_.empty()) return;
+        out << "# 计数器未调度," << unscheduled_.size() << "个内核的计数器列留空(PMU计数器被占用或不足):";
+        for (size_t k = 0; k < unscheduled_.size() && k < 8; k++) {
+            out << " " << unscheduled_[k];
+        }
+        if (unscheduled_.size() > 8) out << " ...";
+        out << std::endl;
+    }
+
+    bool write_json(const char* path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) return false;
+        const BenchTimer& timer = bench_timer(options_.clock);
+        char buffer[512];
+        snprintf(buffer, sizeof(buffer),
+                 "{\n  \"timer\": {\"clock\": \"%s\", \"seconds_per_tick\": %.6g, \"overhead_seconds\": %.6g, "
+                 "\"warmup_runs\": %d, \"min_runs\": %d, \"max_runs\": %d, \"target_ci\": %g, "
+                 "\"max_seconds\": %g, \"pin_cpu\": %d},\n  \"results\": [\n",
+                 bench_clock_name(timer.clock), timer.seconds_per_tick, timer.overhead_ticks * timer.seconds_per_tick,
+                 options_.warmup_runs, options_.min_runs, options_.max_runs, options_.target_ci,
+                 options_.max_seconds, options_.pin_cpu);
+        out << buffer;
+        for (size_t k = 0; k < records_.size(); k++) {
+            out << "    " << records_[k] << (k + 1 < records_.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        return (bool)out;
+    }
+
+private:
+    BenchOptions options_;
+    std::vector<std::string> records_;
+    std::vector<std::string> unscheduled_;
+};
+
+// CSV文件名对应的JSON文件名：jichu_matrix.csv -> jichu_matrix.json
+inline std::string json_path_for(const char* csv_path) {
+    std::string path(csv_path);
+    size_t dot = path.rfind('.');
+    if (dot != std::string::npos) path.erase(dot);
+    return path + ".json";
+}
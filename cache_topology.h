@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cpuid.h>
+#include <unistd.h>
+
+// 运行时检测的缓存层次与CPU拓扑
+// 缓存大小为单个缓存实例的大小(字节)，检测失败的层次为0；
+// *_shared_cpus为共享该实例的逻辑CPU数，L1/L2通常为每核私有，L3通常由一个插槽内的核共享
+struct CacheTopology {
+    size_t l1d = 0;
+    size_t l2 = 0;
+    size_t l3 = 0;
+    int l1d_shared_cpus = 1;
+    int l2_shared_cpus = 1;
+    int l3_shared_cpus = 1;
+    int line_size = 64;
+    int logical_cpus = 1;
+    int cores = 1;
+    int sockets = 1;
+    const char* source = "default";  // 缓存信息来源: sysfs / cpuid / sysconf / default
+
+    size_t level_size(int level) const {
+        return level == 1 ? l1d : level == 2 ? l2 : level == 3 ? l3 : 0;
+    }
+};
+
+// 解析sysfs中"48K"、"2048K"、"105M"形式的大小
+inline size_t parse_cache_size(const std::string& text) {
+    size_t value = 0;
+    size_t i = 0;
+    while (i < text.size() && text[i] >= '0' && text[i] <= '9') {
+        value = value * 10 + (text[i] - '0');
+        i++;
+    }
+    if (i < text.size()) {
+        if (text[i] == 'K') value <<= 10;
+        else if (text[i] == 'M') value <<= 20;
+        else if (text[i] == 'G') value <<= 30;
+    }
+    return value;
+}
+
+// 解析"0-7,16-23"形式的CPU列表
+inline std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream ss(text);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (part.empty()) continue;
+        size_t dash = part.find('-');
+        int first = atoi(part.c_str());
+        int last = dash == std::string::npos ? first : atoi(part.c_str() + dash + 1);
+        for (int c = first; c <= last; c++) {
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+inline int count_cpu_list(const std::string& text) {
+    return (int)parse_cpu_list(text).size();
+}
+
+inline std::string read_sysfs(const std::string& path) {
+    std::ifstream in(path);
+    std::string text;
+    if (in) std::getline(in, text);
+    return text;
+}
+
+// 从sysfs读取cpu0的各级数据缓存，成功返回true
+inline bool read_sysfs_caches(CacheTopology& topo) {
+    const std::string base = "/sys/devices/system/cpu/cpu0/cache/index";
+    bool found = false;
+    for (int index = 0; index < 8; index++) {
+        std::string dir = base + std::to_string(index) + "/";
+        std::string level = read_sysfs(dir + "level");
+        if (level.empty()) break;
+        std::string type = read_sysfs(dir + "type");
+        if (type == "Instruction") continue;
+        size_t size = parse_cache_size(read_sysfs(dir + "size"));
+        int shared = count_cpu_list(read_sysfs(dir + "shared_cpu_list"));
+        if (shared < 1) shared = 1;
+        if (level == "1") { topo.l1d = size; topo.l1d_shared_cpus = shared; }
+        else if (level == "2") { topo.l2 = size; topo.l2_shared_cpus = shared; }
+        else if (level == "3") { topo.l3 = size; topo.l3_shared_cpus = shared; }
+        int line = atoi(read_sysfs(dir + "coherency_line_size").c_str());
+        if (line > 0) topo.line_size = line;
+        found = found || size > 0;
+    }
+    return found;
+}
+
+// 用cpuid确定性缓存参数(Intel leaf 4 / AMD leaf 0x8000001D)读取各级数据缓存
+inline bool read_cpuid_caches(CacheTopology& topo) {
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int leaf = 0;
+    if (__get_cpuid_max(0, nullptr) >= 4) {
+        leaf = 4;
+    }
+    if (__get_cpuid_max(0x80000000, nullptr) >= 0x8000001D) {
+        __cpuid(0, eax, ebx, ecx, edx);
+        if (ebx == 0x68747541) leaf = 0x8000001D;  // "Auth"enticAMD
+    }
+    if (leaf == 0) return false;
+
+    bool found = false;
+    for (unsigned int sub = 0; sub < 16; sub++) {
+        __cpuid_count(leaf, sub, eax, ebx, ecx, edx);
+        unsigned int type = eax & 0x1F;
+        if (type == 0) break;
+        if (type == 2) continue;  // 指令缓存
+        int level = (eax >> 5) & 0x7;
+        int shared = ((eax >> 14) & 0xFFF) + 1;
+        size_t line = (ebx & 0xFFF) + 1;
+        size_t partitions = ((ebx >> 12) & 0x3FF) + 1;
+        size_t ways = ((ebx >> 22) & 0x3FF) + 1;
+        size_t sets = (size_t)ecx + 1;
+        size_t size = ways * partitions * line * sets;
+        if (level == 1) { topo.l1d = size; topo.l1d_shared_cpus = shared; }
+        else if (level == 2) { topo.l2 = size; topo.l2_shared_cpus = shared; }
+        else if (level == 3) { topo.l3 = size; topo.l3_shared_cpus = shared; }
+        topo.line_size = (int)line;
+        found = true;
+    }
+    return found;
+}
+
+// 统计在线逻辑CPU、物理核和插槽数
+inline void read_cpu_counts(CacheTopology& topo) {
+    std::set<int> packages;
+    std::set<std::pair<int, int>> cores;
+    for (int cpu = 0; cpu < 4096; cpu++) {
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        std::string package = read_sysfs(dir + "physical_package_id");
+        if (package.empty()) break;
+        int package_id = atoi(package.c_str());
+        packages.insert(package_id);
+        cores.insert(std::make_pair(package_id, atoi(read_sysfs(dir + "core_id").c_str())));
+    }
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    topo.logical_cpus = online > 0 ? (int)online : 1;
+    topo.cores = cores.empty() ? topo.logical_cpus : (int)cores.size();
+    topo.sockets = packages.empty() ? 1 : (int)packages.size();
+}
+
+// 各NUMA节点的CPU列表，没有NUMA信息时所有在线CPU视为一个节点
+inline std::vector<std::vector<int>> numa_node_cpus() {
+    std::vector<std::vector<int>> nodes;
+    // 节点编号可能不连续(如节点下线)，逐个尝试
+    for (int node = 0; node < 256; node++) {
+        std::string list = read_sysfs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::vector<int> cpus = parse_cpu_list(list);
+        if (!cpus.empty()) nodes.push_back(cpus);
+    }
+    if (nodes.empty()) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        std::vector<int> cpus;
+        for (int c = 0; c < (online > 0 ? online : 1); c++) cpus.push_back(c);
+        nodes.push_back(cpus);
+    }
+    return nodes;
+}
+
+// 依次尝试sysfs、cpuid、sysconf，最后退回常见的默认值
+inline CacheTopology detect_cache_topology() {
+    CacheTopology topo;
+    if (read_sysfs_caches(topo)) {
+        topo.source = "sysfs";
+    } else if (read_cpuid_caches(topo)) {
+        topo.source = "cpuid";
+    }
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    else if (sysconf(_SC_LEVEL1_DCACHE_SIZE) > 0) {
+        topo.l1d = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+        topo.l2 = sysconf(_SC_LEVEL2_CACHE_SIZE) > 0 ? sysconf(_SC_LEVEL2_CACHE_SIZE) : 0;
+        topo.l3 = sysconf(_SC_LEVEL3_CACHE_SIZE) > 0 ? sysconf(_SC_LEVEL3_CACHE_SIZE) : 0;
+        topo.source = "sysconf";
+    }
+#endif
+    if (topo.l1d == 0) topo.l1d = 32 << 10;
+    if (topo.l2 == 0) topo.l2 = 1 << 20;
+
+    read_cpu_counts(topo);
+    return topo;
+}
+
+// 进程内只检测一次
+inline const CacheTopology& cache_topology() {
+    static CacheTopology topo = detect_cache_topology();
+    return topo;
+}
+
+inline std::string format_bytes(size_t bytes) {
+    std::ostringstream out;
+    if (bytes >= (1u << 20) && bytes % (1u << 20) == 0) out << (bytes >> 20) << "MB";
+    else out << (bytes >> 10) << "KB";
+    return out.str();
+}
+
+// 单行描述，写入控制台和CSV头部
+inline std::string topology_summary(const CacheTopology& topo) {
+    std::ostringstream out;
+    out << "L1d=" << format_bytes(topo.l1d) << "(" << topo.l1d_shared_cpus << "CPU共享)"
+        << " L2=" << format_bytes(topo.l2) << "(" << topo.l2_shared_cpus << "CPU共享)";
+    if (topo.l3 > 0) {
+        out << " L3=" << format_bytes(topo.l3) << "(" << topo.l3_shared_cpus << "CPU共享)";
+    }
+    out << " 缓存行=" << topo.line_size << "B"
+        << " 逻辑CPU=" << topo.logical_cpus << " 物理核=" << topo.cores << " 插槽=" << topo.sockets
+        << " 来源=" << topo.source;
+    return out.str();
+}
+
+// 在CSV第一行以#注释写入检测到的拓扑，便于追溯数据来自哪台机器
+inline void write_topology_header(std::ostream& out) {
+    out << "# " << topology_summary(cache_topology()) << std::endl;
+}
+
+// ---------------- 按缓存边界生成测试规模 ----------------
+
+// 在center附近[center*(1-rel_width), center*(1+rel_width)]均匀取steps+1个点
+// 步长至少为min_step，点数随之减少
+inline void add_samples_around(std::vector<int>& points, double center, double rel_width,
+                               int steps, int min_step = 1) {
+    int lo = (int)(center * (1.0 - rel_width));
+    int hi = (int)(center * (1.0 + rel_width));
+    if (lo < 1) lo = 1;
+    int step = (hi - lo) / (steps > 0 ? steps : 1);
+    if (step < min_step) step = min_step;
+    for (int x = lo; x <= hi; x += step) {
+        points.push_back(x);
+    }
+    points.push_back((int)center);
+}
+
+// 排序并去重
+inline void sort_unique(std::vector<int>& points) {
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+}
+
+// 一维数组(double)恰好填满某级缓存时的长度，该级不存在时返回0
+inline int array_boundary(const CacheTopology& topo, int level) {
+    return (int)(topo.level_size(level) / sizeof(double));
+}
+
+// n x n矩阵(double)恰好填满某级缓存时的n
+inline int matrix_boundary(const CacheTopology& topo, int level) {
+    return (int)std::sqrt((double)topo.level_size(level) / sizeof(double));
+}
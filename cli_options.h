@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstring>
+
+// 两个测试程序共用的命令行解析：位置参数为测试模式，--name=value为选项
+
+// 命令行中是否选择了某个测试模式
+inline bool has_mode(int argc, char** argv, const char* mode) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], mode) == 0) return true;
+    }
+    return false;
+}
+
+// 是否给出了任何测试模式(非--开头的参数)
+inline bool any_mode(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) return true;
+    }
+    return false;
+}
+
+// 读取 --name=value 形式的选项，不存在时返回默认值
+inline const char* get_option(int argc, char** argv, const char* name, const char* default_value) {
+    size_t len = strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0 && strncmp(argv[i] + 2, name, len) == 0 &&
+            argv[i][2 + len] == '=') {
+            return argv[i] + 3 + len;
+        }
+    }
+    return default_value;
+}
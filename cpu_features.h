@@ -0,0 +1,43 @@
+#pragma once
+
+// 运行时CPU特性检测，供各SIMD内核按cpuid分派
+
+// 运行时可用的SIMD指令集等级
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+inline const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SIMD_SSE2: return "SSE2";
+        case SIMD_AVX2: return "AVX2";
+        case SIMD_AVX512: return "AVX-512";
+        default: return "标量";
+    }
+}
+
+inline bool simd_supported(SimdLevel level) {
+    __builtin_cpu_init();
+    switch (level) {
+        case SIMD_SSE2: return __builtin_cpu_supports("sse2");
+        case SIMD_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case SIMD_AVX512: return __builtin_cpu_supports("avx512f");
+        default: return true;
+    }
+}
+
+inline SimdLevel detect_simd_level() {
+    if (simd_supported(SIMD_AVX512)) return SIMD_AVX512;
+    if (simd_supported(SIMD_AVX2)) return SIMD_AVX2;
+    if (simd_supported(SIMD_SSE2)) return SIMD_SSE2;
+    return SIMD_SCALAR;
+}
+
+// F16C(半精度与单精度互转)，AVX2主机基本都支持，但与AVX2是独立的cpuid位
+inline bool f16c_supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("f16c");
+}
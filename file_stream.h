@@ -0,0 +1,221 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 超出内存的数据按块从文件流式读入，读下一块与处理当前块重叠
+// 文件内容为原始double(本机字节序)，不带文件头
+
+enum StreamIo {
+    IO_MMAP,    // 整个文件mmap，处理当前块前对下一块madvise(WILLNEED)让内核提前读入
+    IO_PREAD,   // 后台线程用pread读入双缓冲，页缓存+posix_fadvise(SEQUENTIAL)顺序预读
+    IO_DIRECT   // 同IO_PREAD，但以O_DIRECT打开，绕过页缓存直接从设备读
+};
+
+inline const char* stream_io_name(StreamIo io) {
+    switch (io) {
+        case IO_MMAP: return "mmap";
+        case IO_PREAD: return "pread";
+        case IO_DIRECT: return "direct";
+        default: return "unknown";
+    }
+}
+
+// O_DIRECT要求缓冲区地址、文件偏移和读取长度都按逻辑块对齐，统一按4KB处理
+const size_t STREAM_ALIGN = 4096;
+
+struct StreamStats {
+    bool ok = false;
+    size_t bytes = 0;             // 实际处理的字节数
+    double seconds = 0.0;         // 端到端耗时
+    double wait_seconds = 0.0;    // 处理线程等待数据的时间；mmap下缺页时间计入compute_seconds
+    double compute_seconds = 0.0; // 处理各块的时间
+    const char* error = "";       // ok为false时的原因
+};
+
+// 处理一块数据：data为该块起始，count为double个数，offset为该块在文件中的起始下标
+typedef std::function<void(const double* data, size_t count, size_t offset)> ChunkConsumer;
+
+inline double stream_elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline size_t file_size(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    return (size_t)st.st_size;
+}
+
+// 把文件从页缓存中清掉，使下一次读取真正访问设备(只对干净页有效，先fdatasync)
+inline void drop_file_cache(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// 读满count字节，直到文件结束；返回实际读到的字节数，出错返回-1
+inline ssize_t read_full(int fd, char* buffer, size_t count, off_t offset) {
+    size_t done = 0;
+    while (done < count) {
+        ssize_t got = pread(fd, buffer + done, count - done, offset + done);
+        if (got < 0) return -1;
+        if (got == 0) break;
+        done += got;
+    }
+    return (ssize_t)done;
+}
+
+inline StreamStats stream_mmap(const char* path, size_t chunk_bytes, const ChunkConsumer& consume) {
+    StreamStats stats;
+    auto start = std::chrono::steady_clock::now();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        stats.error = "无法打开文件";
+        return stats;
+    }
+    size_t total = file_size(path) / sizeof(double) * sizeof(double);
+    if (total == 0) {
+        close(fd);
+        stats.error = "文件为空";
+        return stats;
+    }
+    void* mapped = mmap(nullptr, total, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        stats.error = "mmap失败";
+        return stats;
+    }
+    char* base = static_cast<char*>(mapped);
+    madvise(base, total, MADV_SEQUENTIAL);
+
+    for (size_t pos = 0; pos < total; pos += chunk_bytes) {
+        size_t len = total - pos < chunk_bytes ? total - pos : chunk_bytes;
+        // 下一块异步预读，与处理当前块重叠
+        if (pos + len < total) {
+            size_t next_len = total - pos - len < chunk_bytes ? total - pos - len : chunk_bytes;
+            madvise(base + pos + len, next_len, MADV_WILLNEED);
+        }
+        auto compute_start = std::chrono::steady_clock::now();
+        consume(reinterpret_cast<const double*>(base + pos), len / sizeof(double), pos / sizeof(double));
+        stats.compute_seconds += stream_elapsed(compute_start);
+    }
+    munmap(mapped, total);
+
+    stats.ok = true;
+    stats.bytes = total;
+    stats.seconds = stream_elapsed(start);
+    return stats;
+}
+
+// 后台读线程与处理线程之间的双缓冲
+// 读线程依次把第k块读入buffers[k%2]，处理线程处理完一块后把该缓冲区还给读线程
+inline StreamStats stream_pread(const char* path, size_t chunk_bytes, bool direct, const ChunkConsumer& consume) {
+    StreamStats stats;
+    auto start = std::chrono::steady_clock::now();
+    int fd = open(path, O_RDONLY | (direct ? O_DIRECT : 0));
+    if (fd < 0) {
+        stats.error = direct ? "无法以O_DIRECT打开文件(文件系统可能不支持)" : "无法打开文件";
+        return stats;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    size_t total = file_size(path) / sizeof(double) * sizeof(double);
+
+    char* buffers[2];
+    for (int b = 0; b < 2; b++) {
+        buffers[b] = static_cast<char*>(aligned_alloc(STREAM_ALIGN, chunk_bytes));
+    }
+    if (buffers[0] == nullptr || buffers[1] == nullptr) {
+        free(buffers[0]);
+        free(buffers[1]);
+        close(fd);
+        stats.error = "无法分配读缓冲区";
+        return stats;
+    }
+    size_t filled[2] = {0, 0};  // 各缓冲区中的有效字节数
+    bool ready[2] = {false, false};
+    bool failed = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    std::thread reader([&] {
+        int b = 0;
+        for (size_t pos = 0; pos < total; pos += chunk_bytes) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return !ready[b]; });
+            }
+            // O_DIRECT下读取长度必须对齐，最后一块按对齐长度读，文件结束处返回短读
+            size_t len = total - pos < chunk_bytes ? total - pos : chunk_bytes;
+            size_t request = direct ? (len + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN : len;
+            ssize_t got = read_full(fd, buffers[b], request, (off_t)pos);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (got < (ssize_t)len) {
+                    failed = true;
+                    filled[b] = 0;
+                } else {
+                    filled[b] = len;
+                }
+                ready[b] = true;
+            }
+            cv.notify_all();
+            if (got < (ssize_t)len) return;
+            b ^= 1;
+        }
+    });
+
+    int b = 0;
+    for (size_t pos = 0; pos < total; pos += chunk_bytes) {
+        auto wait_start = std::chrono::steady_clock::now();
+        size_t len;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return ready[b]; });
+            len = filled[b];
+        }
+        stats.wait_seconds += stream_elapsed(wait_start);
+        if (len == 0) break;
+
+        auto compute_start = std::chrono::steady_clock::now();
+        consume(reinterpret_cast<const double*>(buffers[b]), len / sizeof(double), pos / sizeof(double));
+        stats.compute_seconds += stream_elapsed(compute_start);
+        stats.bytes += len;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready[b] = false;
+        }
+        cv.notify_all();
+        b ^= 1;
+    }
+    reader.join();
+    close(fd);
+    for (int k = 0; k < 2; k++) {
+        free(buffers[k]);
+    }
+
+    stats.ok = !failed;
+    if (failed) stats.error = "读取文件失败";
+    stats.seconds = stream_elapsed(start);
+    return stats;
+}
+
+// 按块流式处理整个文件，块按文件顺序依次交给consume
+// 块大小向上取整到4KB(madvise和O_DIRECT的要求)，因此块边界不一定落在调用者的逻辑边界上
+inline StreamStats stream_file(const char* path, StreamIo io, size_t chunk_bytes, const ChunkConsumer& consume) {
+    chunk_bytes = (chunk_bytes + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN;
+    if (chunk_bytes == 0) chunk_bytes = STREAM_ALIGN;
+    if (io == IO_MMAP) return stream_mmap(path, chunk_bytes, consume);
+    return stream_pread(path, chunk_bytes, io == IO_DIRECT, consume);
+}
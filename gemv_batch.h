@@ -0,0 +1,89 @@
+#pragma once
+
+#include "cache_topology.h"
+#include "matrix.h"
+#include "thread_pool.h"
+
+// 批量矩阵向量乘法：同一矩阵乘k个向量，results[c][j] = Σ_i matrix[i][j] * vectors[c][i]
+// 逐个调用mulb时每个向量都要把n*n个元素从内存完整读一遍；这里矩阵只遍历一次，
+// 每次读入的8行矩阵段在L1中对k个向量依次复用，矩阵带宽被k个向量分摊
+
+// 列块宽度：k个结果段合计占L1d的一半，其余留给8行矩阵段
+inline int batch_tile_cols(int k, const CacheTopology& topo) {
+    int cols = (int)(topo.l1d / 2 / sizeof(double) / (k > 0 ? k : 1));
+    cols = cols / CACHE_LINE_DOUBLES * CACHE_LINE_DOUBLES;
+    if (cols < CACHE_LINE_DOUBLES) cols = CACHE_LINE_DOUBLES;
+    return cols;
+}
+
+// 只计算结果的[j0, j1)列，各列段互不相干，可以分给不同线程
+inline void mul_batch_cols(const Matrix& matrix, const double* const* vectors, double* const* results, int k,
+                           int j0, int j1) {
+    int n = matrix.n;
+    int tile = batch_tile_cols(k, cache_topology());
+
+    for (int c = 0; c < k; c++) {
+        for (int j = j0; j < j1; j++) {
+            results[c][j] = 0.0;
+        }
+    }
+
+    for (int jb = j0; jb < j1; jb += tile) {
+        int j_end = jb + tile < j1 ? jb + tile : j1;
+
+        // 8行一组，8行矩阵段对k个向量复用，每个结果段每8行只读写一次
+        int i = 0;
+        for (; i + 7 < n; i += 8) {
+            const double* r0 = matrix.row(i);
+            const double* r1 = matrix.row(i+1);
+            const double* r2 = matrix.row(i+2);
+            const double* r3 = matrix.row(i+3);
+            const double* r4 = matrix.row(i+4);
+            const double* r5 = matrix.row(i+5);
+            const double* r6 = matrix.row(i+6);
+            const double* r7 = matrix.row(i+7);
+            for (int c = 0; c < k; c++) {
+                const double* v = vectors[c];
+                double v0 = v[i], v1 = v[i+1], v2 = v[i+2], v3 = v[i+3];
+                double v4 = v[i+4], v5 = v[i+5], v6 = v[i+6], v7 = v[i+7];
+                double* result = results[c];
+                for (int j = jb; j < j_end; j++) {
+                    result[j] += r0[j] * v0 + r1[j] * v1 + r2[j] * v2 + r3[j] * v3 +
+                                 r4[j] * v4 + r5[j] * v5 + r6[j] * v6 + r7[j] * v7;
+                }
+            }
+        }
+
+        // 处理剩余行
+        for (; i < n; i++) {
+            const double* row = matrix.row(i);
+            for (int c = 0; c < k; c++) {
+                double vi = vectors[c][i];
+                double* result = results[c];
+                for (int j = jb; j < j_end; j++) {
+                    result[j] += row[j] * vi;
+                }
+            }
+        }
+    }
+}
+
+inline void mul_batch(const Matrix& matrix, const double* const* vectors, double* const* results, int k) {
+    mul_batch_cols(matrix, vectors, results, k, 0, matrix.n);
+}
+
+// 多线程批量乘法：按结果列划分(同mulb_columns_task)，每个线程对自己的列段遍历全部行，无需规约；
+// 列段按缓存行对齐，结果与mul_batch逐位一致
+inline void mul_batch_parallel(const Matrix& matrix, const double* const* vectors, double* const* results, int k,
+                               ThreadPool& pool) {
+    int num_threads = pool.size();
+    if (num_threads <= 1 || matrix.n < num_threads * CACHE_LINE_DOUBLES) {
+        mul_batch(matrix, vectors, results, k);
+        return;
+    }
+    pool.run([&](int tid) {
+        int j0, j1;
+        split_range(matrix.n, num_threads, tid, CACHE_LINE_DOUBLES, j0, j1);
+        mul_batch_cols(matrix, vectors, results, k, j0, j1);
+    });
+}
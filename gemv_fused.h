@@ -0,0 +1,238 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "gemv_parallel.h"
+#include "matrix.h"
+#include "thread_pool.h"
+
+// 同时需要 y = A·x 和 z = Aᵀ·w 的场景(如BiCG类求解器每次迭代)：
+// y[i] = Σ_j matrix[i][j] * x[j]   (行点积；mula到muld计算的都是Aᵀ·v，这里提供A·x)
+// z[j] = Σ_i matrix[i][j] * w[i]   (行累加，与mulb相同)
+// 分两遍计算要把矩阵从内存读两次；融合内核每读一行矩阵就同时完成这一行的点积和累加，矩阵只读一遍
+//
+// 内核按行块处理(每块4行)：x和z的每个向量在4行之间复用，z每4行只读写一次；
+// 每行一个点积累加器，行块结束时做水平规约得到y[i]
+// 三种运算(只算A·x、只算Aᵀ·w、两者融合)由同一个模板生成，分两遍的对比基准与融合内核使用相同的SIMD代码
+
+enum GemvPairOp {
+    PAIR_AX,     // 只算y = A·x
+    PAIR_ATW,    // 只算z = Aᵀ·w
+    PAIR_FUSED   // 一遍同时算y和z
+};
+
+inline const char* pair_op_name(GemvPairOp op) {
+    switch (op) {
+        case PAIR_AX: return "A·x";
+        case PAIR_ATW: return "Aᵀ·w";
+        default: return "融合";
+    }
+}
+
+const int FUSED_ROW_BLOCK = 4;
+
+// 行段内核：写y[i0..i1)，把行段对z的贡献累加到z(调用者负责清零)；不需要的一侧可以传nullptr
+typedef void (*GemvPairKernel)(const Matrix& matrix, const double* x, const double* w, double* y, double* z,
+                               int i0, int i1);
+
+// ---------------- 标量版本(不支持AVX2时使用) ----------------
+
+template <bool Ax, bool Atw>
+inline void gemv_pair_scalar(const Matrix& matrix, const double* x, const double* w, double* y, double* z,
+                             int i0, int i1) {
+    int n = matrix.n;
+    for (int i = i0; i < i1; i++) {
+        const double* row = matrix.row(i);
+        double wi = Atw ? w[i] : 0.0;
+        double sum = 0.0;
+        for (int j = 0; j < n; j++) {
+            if constexpr (Ax) sum += row[j] * x[j];
+            if constexpr (Atw) z[j] += row[j] * wi;
+        }
+        if constexpr (Ax) y[i] = sum;
+    }
+}
+
+// ---------------- AVX2 + FMA ----------------
+
+// Rows行为一块：列方向每次一个向量(4个double)
+template <int Rows, bool Ax, bool Atw>
+__attribute__((target("avx2,fma")))
+inline void gemv_pair_block_avx2(const Matrix& matrix, const double* x, const double* w, double* y, double* z,
+                                 int i) {
+    int n = matrix.n;
+    const double* r[Rows];
+    __m256d wv[Rows];
+    __m256d acc[Rows];
+    for (int k = 0; k < Rows; k++) {
+        r[k] = matrix.row(i + k);
+        if constexpr (Atw) wv[k] = _mm256_set1_pd(w[i + k]);
+        acc[k] = _mm256_setzero_pd();
+    }
+    int j = 0;
+    for (; j + 3 < n; j += 4) {
+        __m256d xv, zv;
+        if constexpr (Ax) xv = _mm256_loadu_pd(x + j);
+        if constexpr (Atw) zv = _mm256_loadu_pd(z + j);
+        for (int k = 0; k < Rows; k++) {
+            __m256d a = _mm256_loadu_pd(r[k] + j);
+            if constexpr (Ax) acc[k] = _mm256_fmadd_pd(a, xv, acc[k]);
+            if constexpr (Atw) zv = _mm256_fmadd_pd(a, wv[k], zv);
+        }
+        if constexpr (Atw) _mm256_storeu_pd(z + j, zv);
+    }
+    double lanes[4];
+    for (int k = 0; k < Rows; k++) {
+        double sum = 0.0;
+        if constexpr (Ax) {
+            _mm256_storeu_pd(lanes, acc[k]);
+            sum = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+        }
+        // 处理剩余列
+        for (int jj = j; jj < n; jj++) {
+            if constexpr (Ax) sum += r[k][jj] * x[jj];
+            if constexpr (Atw) z[jj] += r[k][jj] * w[i + k];
+        }
+        if constexpr (Ax) y[i + k] = sum;
+    }
+}
+
+template <bool Ax, bool Atw>
+__attribute__((target("avx2,fma")))
+inline void gemv_pair_avx2(const Matrix& matrix, const double* x, const double* w, double* y, double* z,
+                           int i0, int i1) {
+    int i = i0;
+    for (; i + FUSED_ROW_BLOCK - 1 < i1; i += FUSED_ROW_BLOCK) {
+        gemv_pair_block_avx2<FUSED_ROW_BLOCK, Ax, Atw>(matrix, x, w, y, z, i);
+    }
+    // 处理剩余行
+    for (; i < i1; i++) {
+        gemv_pair_block_avx2<1, Ax, Atw>(matrix, x, w, y, z, i);
+    }
+}
+
+// ---------------- AVX-512 ----------------
+
+// Rows行为一块：列方向每次一个向量(8个double)，不足8列的尾部用掩码加载和存储
+template <int Rows, bool Ax, bool Atw>
+__attribute__((target("avx512f")))
+inline void gemv_pair_block_avx512(const Matrix& matrix, const double* x, const double* w, double* y, double* z,
+                                   int i) {
+    int n = matrix.n;
+    const double* r[Rows];
+    __m512d wv[Rows];
+    __m512d acc[Rows];
+    for (int k = 0; k < Rows; k++) {
+        r[k] = matrix.row(i + k);
+        if constexpr (Atw) wv[k] = _mm512_set1_pd(w[i + k]);
+        acc[k] = _mm512_setzero_pd();
+    }
+    for (int j = 0; j < n; j += 8) {
+        __mmask8 tail = n - j >= 8 ? 0xFF : (__mmask8)((1u << (n - j)) - 1);
+        __m512d xv, zv;
+        if constexpr (Ax) xv = _mm512_maskz_loadu_pd(tail, x + j);
+        if constexpr (Atw) zv = _mm512_maskz_loadu_pd(tail, z + j);
+        for (int k = 0; k < Rows; k++) {
+            __m512d a = _mm512_maskz_loadu_pd(tail, r[k] + j);
+            if constexpr (Ax) acc[k] = _mm512_fmadd_pd(a, xv, acc[k]);
+            if constexpr (Atw) zv = _mm512_fmadd_pd(a, wv[k], zv);
+        }
+        if constexpr (Atw) _mm512_mask_storeu_pd(z + j, tail, zv);
+    }
+    if constexpr (Ax) {
+        double lanes[8];
+        for (int k = 0; k < Rows; k++) {
+            _mm512_storeu_pd(lanes, acc[k]);
+            y[i + k] = ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+        }
+    }
+}
+
+template <bool Ax, bool Atw>
+__attribute__((target("avx512f")))
+inline void gemv_pair_avx512(const Matrix& matrix, const double* x, const double* w, double* y, double* z,
+                             int i0, int i1) {
+    int i = i0;
+    for (; i + FUSED_ROW_BLOCK - 1 < i1; i += FUSED_ROW_BLOCK) {
+        gemv_pair_block_avx512<FUSED_ROW_BLOCK, Ax, Atw>(matrix, x, w, y, z, i);
+    }
+    // 处理剩余行
+    for (; i < i1; i++) {
+        gemv_pair_block_avx512<1, Ax, Atw>(matrix, x, w, y, z, i);
+    }
+}
+
+// ---------------- 运行时分派 ----------------
+
+template <bool Ax, bool Atw>
+inline GemvPairKernel gemv_pair_kernel_for(SimdLevel level) {
+    if (level >= SIMD_AVX512 && simd_supported(SIMD_AVX512)) return gemv_pair_avx512<Ax, Atw>;
+    if (level >= SIMD_AVX2 && simd_supported(SIMD_AVX2)) return gemv_pair_avx2<Ax, Atw>;
+    return gemv_pair_scalar<Ax, Atw>;
+}
+
+inline GemvPairKernel gemv_pair_kernel(SimdLevel level, GemvPairOp op) {
+    switch (op) {
+        case PAIR_AX: return gemv_pair_kernel_for<true, false>(level);
+        case PAIR_ATW: return gemv_pair_kernel_for<false, true>(level);
+        default: return gemv_pair_kernel_for<true, true>(level);
+    }
+}
+
+// 单线程整块计算：z先清零；只算A·x时w、z可为nullptr，只算Aᵀ·w时x、y可为nullptr
+inline void gemv_pair(GemvPairKernel kernel, GemvPairOp op, const Matrix& matrix, const double* x, const double* w,
+                      double* y, double* z) {
+    if (op != PAIR_AX) {
+        for (int j = 0; j < matrix.n; j++) {
+            z[j] = 0.0;
+        }
+    }
+    kernel(matrix, x, w, y, z, 0, matrix.n);
+}
+
+// 使用本机最宽的指令集
+inline void gemv_ax_simd(const Matrix& matrix, const double* x, double* y) {
+    static GemvPairKernel kernel = gemv_pair_kernel(detect_simd_level(), PAIR_AX);
+    gemv_pair(kernel, PAIR_AX, matrix, x, nullptr, y, nullptr);
+}
+
+inline void gemv_atw_simd(const Matrix& matrix, const double* w, double* z) {
+    static GemvPairKernel kernel = gemv_pair_kernel(detect_simd_level(), PAIR_ATW);
+    gemv_pair(kernel, PAIR_ATW, matrix, nullptr, w, nullptr, z);
+}
+
+inline void gemv_fused_simd(const Matrix& matrix, const double* x, const double* w, double* y, double* z) {
+    static GemvPairKernel kernel = gemv_pair_kernel(detect_simd_level(), PAIR_FUSED);
+    gemv_pair(kernel, PAIR_FUSED, matrix, x, w, y, z);
+}
+
+// ---------------- 多线程 ----------------
+
+// 按行块划分：每个线程算自己那些行的y，并把对z的贡献累加到私有部分和向量，再按列段并行规约(同mulb_parallel的行划分)；
+// 只算A·x时没有规约。partials大小至少为partials_size(n, pool.size())，只算A·x时可为nullptr；
+// 矩阵太小时在调用线程上计算
+inline void gemv_pair_parallel(GemvPairKernel kernel, GemvPairOp op, const Matrix& matrix, const double* x,
+                               const double* w, double* y, double* z, ThreadPool& pool, double* partials) {
+    int n = matrix.n;
+    int num_threads = pool.size();
+    if (choose_partition(n, num_threads) == PARTITION_SERIAL) {
+        gemv_pair(kernel, op, matrix, x, w, y, z);
+        return;
+    }
+    int ld = padded_ld(n);
+    pool.run([&](int tid) {
+        int i0, i1;
+        split_range(n, num_threads, tid, FUSED_ROW_BLOCK, i0, i1);
+        double* partial = op != PAIR_AX ? partials + (size_t)tid * ld : nullptr;
+        for (int j = 0; partial != nullptr && j < n; j++) {
+            partial[j] = 0.0;
+        }
+        kernel(matrix, x, w, y, partial, i0, i1);
+    });
+    if (op != PAIR_AX) {
+        pool.run([&](int tid) {
+            reduce_partials_task(partials, z, n, num_threads, tid);
+        });
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstring>
+
+#include "gemv_parallel.h"
+#include "matrix.h"
+
+// 增量维护的矩阵向量乘法：result[j] = Σ_i matrix[i][j] * vector[i](与mulb相同)
+// vector[i]改变δ时只需 result[j] += matrix[i][j] * δ；第i行改变时只需 result[j] += (新[j] - 旧[j]) * vector[i]，
+// 每次更新O(n)，不必重新计算全部n*n个乘积。
+// 每次修正都会引入一次舍入，误差随更新次数累积；累计更新的元素数达到recompute_interval后自动全量重算一次，
+// 把误差限制在recompute_interval次修正之内(默认为n，均摊到每次更新的重算代价约为读一行矩阵)
+
+class IncrementalGemv {
+public:
+    explicit IncrementalGemv(int n)
+        : matrix_(alloc_matrix(n, LAYOUT_CONTIGUOUS)), vector_(alloc_aligned(n)), result_(alloc_aligned(n)),
+          recompute_interval_(n) {
+        memset(vector_, 0, (size_t)n * sizeof(double));
+        memset(result_, 0, (size_t)n * sizeof(double));
+    }
+
+    ~IncrementalGemv() {
+        free_matrix(matrix_);
+        free_aligned(vector_);
+        free_aligned(result_);
+    }
+
+    IncrementalGemv(const IncrementalGemv&) = delete;
+    IncrementalGemv& operator=(const IncrementalGemv&) = delete;
+
+    int n() const { return matrix_.n; }
+
+    // 直接修改矩阵或向量后需调用recompute()
+    Matrix& matrix() { return matrix_; }
+    double* vector() { return vector_; }
+    const Matrix& matrix() const { return matrix_; }
+    const double* vector() const { return vector_; }
+    const double* result() const { return result_; }
+
+    // 0表示从不自动重算
+    void set_recompute_interval(long long updates) { recompute_interval_ = updates; }
+    long long updates_since_recompute() const { return updates_; }
+    long long recomputes() const { return recomputes_; }
+
+    // 全量重算，加法顺序与mulb相同，结果逐位一致
+    void recompute() {
+        mulb_columns_task(matrix_, vector_, result_, 1, 0);
+        updates_ = 0;
+        recomputes_++;
+    }
+
+    void update_vector(int i, double value) {
+        double delta = value - vector_[i];
+        vector_[i] = value;
+        if (delta != 0.0) {
+            axpy(matrix_.row(i), delta);
+        }
+        count_updates(1);
+    }
+
+    // 批量更新向量元素：4个更新一组，result每4个更新只读写一次；indices可以重复，按顺序生效
+    void update_vector(const int* indices, const double* values, int count) {
+        int n = matrix_.n;
+        int k = 0;
+        for (; k + 3 < count; k += 4) {
+            double d0 = exchange(indices[k], values[k]);
+            double d1 = exchange(indices[k+1], values[k+1]);
+            double d2 = exchange(indices[k+2], values[k+2]);
+            double d3 = exchange(indices[k+3], values[k+3]);
+            const double* r0 = matrix_.row(indices[k]);
+            const double* r1 = matrix_.row(indices[k+1]);
+            const double* r2 = matrix_.row(indices[k+2]);
+            const double* r3 = matrix_.row(indices[k+3]);
+            for (int j = 0; j < n; j++) {
+                result_[j] += r0[j] * d0 + r1[j] * d1 + r2[j] * d2 + r3[j] * d3;
+            }
+        }
+        // 处理剩余更新
+        for (; k < count; k++) {
+            double delta = exchange(indices[k], values[k]);
+            if (delta != 0.0) axpy(matrix_.row(indices[k]), delta);
+        }
+        count_updates(count);
+    }
+
+    // 用row替换第i行：修正结果的同时写入新行，旧行、新行和result各遍历一次
+    void update_row(int i, const double* row) {
+        replace_row(i, row);
+        count_updates(1);
+    }
+
+    // 批量替换多行；同一行出现多次时后面的生效
+    void update_rows(const int* indices, const double* const* rows, int count) {
+        for (int k = 0; k < count; k++) {
+            replace_row(indices[k], rows[k]);
+        }
+        count_updates(count);
+    }
+
+private:
+    // 写入新值并返回变化量
+    double exchange(int i, double value) {
+        double delta = value - vector_[i];
+        vector_[i] = value;
+        return delta;
+    }
+
+    void axpy(const double* row, double delta) {
+        int n = matrix_.n;
+        for (int j = 0; j < n; j++) {
+            result_[j] += row[j] * delta;
+        }
+    }
+
+    void replace_row(int i, const double* row) {
+        int n = matrix_.n;
+        double* old = matrix_.row(i);
+        double vi = vector_[i];
+        for (int j = 0; j < n; j++) {
+            result_[j] += (row[j] - old[j]) * vi;
+            old[j] = row[j];
+        }
+    }
+
+    void count_updates(int count) {
+        updates_ += count;
+        if (recompute_interval_ > 0 && updates_ >= recompute_interval_) recompute();
+    }
+
+    Matrix matrix_;
+    double* vector_;
+    double* result_;
+    long long recompute_interval_;
+    long long updates_ = 0;
+    long long recomputes_ = 0;
+};
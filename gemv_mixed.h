@@ -0,0 +1,363 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "gemv_simd.h"
+#include "matrix.h"
+
+// 混合精度矩阵向量乘法：矩阵以较窄的类型存储，读入后用SIMD转换为double并以double累加
+// 超出L3后GEMV完全受内存带宽限制，每个元素的字节数从8降到4/2/1，读矩阵的时间随之减少
+//
+// 存储类型：double(8字节)、float(4)、IEEE半精度half_t(2)、bfloat16(2)、带每行缩放因子的int8(1)
+// half_t用F16C指令转换；bf16即float的高16位，转换只需左移16位，AVX2即可完成。
+// AVX-512 BF16的点积指令VDPBF16PS以float累加，不满足double累加的要求，因此不使用
+
+struct half_t {
+    uint16_t bits;
+};
+
+struct bf16_t {
+    uint16_t bits;
+};
+
+// ---------------- 标量编码/解码 ----------------
+
+inline uint32_t float_bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+inline float bits_float(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// float转半精度，舍入到最近偶数，超出范围得到无穷大
+inline half_t half_from_float(float f) {
+    uint32_t x = float_bits(f);
+    uint32_t sign = (x >> 16) & 0x8000;
+    int exp = (int)((x >> 23) & 0xFF) - 127 + 15;
+    uint32_t mant = x & 0x7FFFFF;
+    half_t h;
+    if (((x >> 23) & 0xFF) == 0xFF) {
+        h.bits = (uint16_t)(sign | 0x7C00 | (mant ? 0x200 : 0));
+    } else if (exp >= 31) {
+        h.bits = (uint16_t)(sign | 0x7C00);
+    } else if (exp <= 0) {
+        // 半精度的非规格化数
+        if (exp < -10) {
+            h.bits = (uint16_t)sign;
+            return h;
+        }
+        mant |= 0x800000;
+        int shift = 14 - exp;
+        uint32_t value = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (value & 1))) value++;
+        h.bits = (uint16_t)(sign | value);
+    } else {
+        uint32_t value = sign | ((uint32_t)exp << 10) | (mant >> 13);
+        uint32_t rem = mant & 0x1FFF;
+        if (rem > 0x1000 || (rem == 0x1000 && (value & 1))) value++;  // 进位可以进到指数
+        h.bits = (uint16_t)value;
+    }
+    return h;
+}
+
+inline float half_to_float(half_t h) {
+    uint32_t sign = (uint32_t)(h.bits & 0x8000) << 16;
+    uint32_t exp = (h.bits >> 10) & 0x1F;
+    uint32_t mant = h.bits & 0x3FF;
+    if (exp == 0) {
+        float value = mant * (1.0f / 16777216.0f);  // mant * 2^-24
+        return sign ? -value : value;
+    }
+    if (exp == 31) return bits_float(sign | 0x7F800000 | (mant << 13));
+    return bits_float(sign | ((exp - 15 + 127) << 23) | (mant << 13));
+}
+
+// float转bf16，舍入到最近偶数
+inline bf16_t bf16_from_float(float f) {
+    uint32_t x = float_bits(f);
+    bf16_t b;
+    b.bits = (uint16_t)((x + 0x7FFF + ((x >> 16) & 1)) >> 16);
+    return b;
+}
+
+inline float bf16_to_float(bf16_t b) {
+    return bits_float((uint32_t)b.bits << 16);
+}
+
+inline double decode(double x) { return x; }
+inline double decode(float x) { return x; }
+inline double decode(half_t x) { return half_to_float(x); }
+inline double decode(bf16_t x) { return bf16_to_float(x); }
+inline double decode(int8_t x) { return x; }
+
+// x已除以该行的缩放因子(只有int8的缩放因子不为1)
+inline void encode(double x, double& out) { out = x; }
+inline void encode(double x, float& out) { out = (float)x; }
+inline void encode(double x, half_t& out) { out = half_from_float((float)x); }
+inline void encode(double x, bf16_t& out) { out = bf16_from_float((float)x); }
+inline void encode(double x, int8_t& out) {
+    long q = std::lround(x);
+    out = (int8_t)(q > 127 ? 127 : q < -127 ? -127 : q);
+}
+
+template <typename T> inline const char* storage_name();
+template <> inline const char* storage_name<double>() { return "double"; }
+template <> inline const char* storage_name<float>() { return "float"; }
+template <> inline const char* storage_name<half_t>() { return "fp16"; }
+template <> inline const char* storage_name<bf16_t>() { return "bf16"; }
+template <> inline const char* storage_name<int8_t>() { return "int8"; }
+
+// ---------------- 存储 ----------------
+
+// 按行存储的n x n矩阵，元素类型为T，行距按缓存行对齐
+// scales只在T为int8时分配：第i行的真实值为 data[i][j] * scales[i]
+template <typename T>
+struct StoredMatrix {
+    int n = 0;
+    int ld = 0;
+    T* data = nullptr;
+    double* scales = nullptr;
+
+    const T* row(int i) const { return data + (size_t)i * ld; }
+    double scale(int i) const { return scales != nullptr ? scales[i] : 1.0; }
+};
+
+// 从double矩阵转换；int8每行取 max|a_ij|/127 为缩放因子
+template <typename T>
+inline StoredMatrix<T> convert_matrix(const Matrix& matrix) {
+    StoredMatrix<T> m;
+    int n = matrix.n;
+    int per_line = (int)(CACHE_LINE / sizeof(T));
+    m.n = n;
+    m.ld = (n + per_line - 1) / per_line * per_line;
+    size_t bytes = ((size_t)n * m.ld * sizeof(T) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    m.data = static_cast<T*>(aligned_alloc(CACHE_LINE, bytes > 0 ? bytes : CACHE_LINE));
+    if (m.data == nullptr) throw std::bad_alloc();
+    memset(static_cast<void*>(m.data), 0, bytes);
+    bool quantized = sizeof(T) == 1;
+    if (quantized) m.scales = alloc_aligned(n);
+
+    for (int i = 0; i < n; i++) {
+        const double* src = matrix.row(i);
+        T* dst = m.data + (size_t)i * m.ld;
+        double inv_scale = 1.0;
+        if (quantized) {
+            double max_abs = 0.0;
+            for (int j = 0; j < n; j++) max_abs = std::fmax(max_abs, std::fabs(src[j]));
+            m.scales[i] = max_abs > 0.0 ? max_abs / 127.0 : 1.0;
+            inv_scale = 1.0 / m.scales[i];
+        }
+        for (int j = 0; j < n; j++) {
+            encode(src[j] * inv_scale, dst[j]);
+        }
+    }
+    return m;
+}
+
+template <typename T>
+inline void free_stored(StoredMatrix<T>& m) {
+    free(m.data);
+    if (m.scales != nullptr) free_aligned(m.scales);
+    m = StoredMatrix<T>();
+}
+
+// ---------------- SIMD加载并转换为double ----------------
+
+__attribute__((target("avx2,fma,f16c")))
+inline __m256d load4_pd(const double* p) { return _mm256_loadu_pd(p); }
+
+__attribute__((target("avx2,fma,f16c")))
+inline __m256d load4_pd(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+
+__attribute__((target("avx2,fma,f16c")))
+inline __m256d load4_pd(const half_t* p) {
+    return _mm256_cvtps_pd(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+__attribute__((target("avx2,fma,f16c")))
+inline __m256d load4_pd(const bf16_t* p) {
+    __m128i wide = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p));
+    return _mm256_cvtps_pd(_mm_castsi128_ps(_mm_slli_epi32(wide, 16)));
+}
+
+__attribute__((target("avx2,fma,f16c")))
+inline __m256d load4_pd(const int8_t* p) {
+    int32_t packed;
+    memcpy(&packed, p, sizeof(packed));
+    return _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(packed)));
+}
+
+__attribute__((target("avx512f,f16c")))
+inline __m512d load8_pd(const double* p) { return _mm512_loadu_pd(p); }
+
+// 转换统一用全1掩码的maskz形式，避免GCC 12对未掩码形式的误报(-Wmaybe-uninitialized)
+__attribute__((target("avx512f,f16c")))
+inline __m512d cvt8_ps_pd(__m256 x) { return _mm512_maskz_cvtps_pd(0xFF, x); }
+
+__attribute__((target("avx512f,f16c")))
+inline __m512d load8_pd(const float* p) { return cvt8_ps_pd(_mm256_loadu_ps(p)); }
+
+__attribute__((target("avx512f,f16c")))
+inline __m512d load8_pd(const half_t* p) {
+    return cvt8_ps_pd(_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)p)));
+}
+
+__attribute__((target("avx512f,f16c")))
+inline __m512d load8_pd(const bf16_t* p) {
+    __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+    return cvt8_ps_pd(_mm256_castsi256_ps(_mm256_slli_epi32(wide, 16)));
+}
+
+__attribute__((target("avx512f,f16c")))
+inline __m512d load8_pd(const int8_t* p) {
+    return _mm512_maskz_cvtepi32_pd(0xFF, _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+// ---------------- 内核 ----------------
+// 与gemv_axpy_*相同的行累加顺序：8行一块，每块内result的一段只读写一次；
+// 每行的缩放因子并入向量元素，内层循环只有转换和FMA
+
+template <typename T>
+inline void gemv_mixed_scalar(const StoredMatrix<T>& m, const double* vector, double* result) {
+    int n = m.n;
+    for (int j = 0; j < n; j++) {
+        result[j] = 0.0;
+    }
+    for (int i = 0; i < n; i++) {
+        double vi = vector[i] * m.scale(i);
+        const T* row = m.row(i);
+        for (int j = 0; j < n; j++) {
+            result[j] += decode(row[j]) * vi;
+        }
+    }
+}
+
+template <typename T>
+__attribute__((target("avx2,fma,f16c")))
+inline void gemv_mixed_avx2(const StoredMatrix<T>& m, const double* vector, double* result) {
+    int n = m.n;
+    for (int j = 0; j < n; j++) {
+        result[j] = 0.0;
+    }
+
+    int i = 0;
+    for (; i + SIMD_ROW_BLOCK - 1 < n; i += SIMD_ROW_BLOCK) {
+        const T* r[SIMD_ROW_BLOCK];
+        double vs[SIMD_ROW_BLOCK];
+        __m256d v[SIMD_ROW_BLOCK];
+        for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+            r[k] = m.row(i + k);
+            vs[k] = vector[i + k] * m.scale(i + k);
+            v[k] = _mm256_set1_pd(vs[k]);
+        }
+        int j = 0;
+        for (; j + 7 < n; j += 8) {
+            __m256d y0 = _mm256_loadu_pd(result + j);
+            __m256d y1 = _mm256_loadu_pd(result + j + 4);
+            for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+                y0 = _mm256_fmadd_pd(load4_pd(r[k] + j), v[k], y0);
+                y1 = _mm256_fmadd_pd(load4_pd(r[k] + j + 4), v[k], y1);
+            }
+            _mm256_storeu_pd(result + j, y0);
+            _mm256_storeu_pd(result + j + 4, y1);
+        }
+        // 处理剩余列
+        for (; j < n; j++) {
+            double y = result[j];
+            for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+                y += decode(r[k][j]) * vs[k];
+            }
+            result[j] = y;
+        }
+    }
+
+    // 处理剩余行
+    for (; i < n; i++) {
+        const T* row = m.row(i);
+        double vi = vector[i] * m.scale(i);
+        for (int j = 0; j < n; j++) {
+            result[j] += decode(row[j]) * vi;
+        }
+    }
+}
+
+template <typename T>
+__attribute__((target("avx512f,f16c")))
+inline void gemv_mixed_avx512(const StoredMatrix<T>& m, const double* vector, double* result) {
+    int n = m.n;
+    for (int j = 0; j < n; j++) {
+        result[j] = 0.0;
+    }
+
+    int i = 0;
+    for (; i + SIMD_ROW_BLOCK - 1 < n; i += SIMD_ROW_BLOCK) {
+        const T* r[SIMD_ROW_BLOCK];
+        double vs[SIMD_ROW_BLOCK];
+        __m512d v[SIMD_ROW_BLOCK];
+        for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+            r[k] = m.row(i + k);
+            vs[k] = vector[i + k] * m.scale(i + k);
+            v[k] = _mm512_set1_pd(vs[k]);
+        }
+        int j = 0;
+        for (; j + 15 < n; j += 16) {
+            __m512d y0 = _mm512_loadu_pd(result + j);
+            __m512d y1 = _mm512_loadu_pd(result + j + 8);
+            for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+                y0 = _mm512_fmadd_pd(load8_pd(r[k] + j), v[k], y0);
+                y1 = _mm512_fmadd_pd(load8_pd(r[k] + j + 8), v[k], y1);
+            }
+            _mm512_storeu_pd(result + j, y0);
+            _mm512_storeu_pd(result + j + 8, y1);
+        }
+        // 处理剩余列
+        for (; j < n; j++) {
+            double y = result[j];
+            for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+                y += decode(r[k][j]) * vs[k];
+            }
+            result[j] = y;
+        }
+    }
+
+    // 处理剩余行
+    for (; i < n; i++) {
+        const T* row = m.row(i);
+        double vi = vector[i] * m.scale(i);
+        for (int j = 0; j < n; j++) {
+            result[j] += decode(row[j]) * vi;
+        }
+    }
+}
+
+// ---------------- 运行时分派 ----------------
+
+template <typename T>
+using MixedKernel = void (*)(const StoredMatrix<T>& m, const double* vector, double* result);
+
+// SIMD版本的加载函数统一要求F16C
+template <typename T>
+inline MixedKernel<T> gemv_mixed_kernel(SimdLevel level) {
+    bool f16c = f16c_supported();
+    if (level >= SIMD_AVX512 && simd_supported(SIMD_AVX512) && f16c) return gemv_mixed_avx512<T>;
+    if (level >= SIMD_AVX2 && simd_supported(SIMD_AVX2) && f16c) return gemv_mixed_avx2<T>;
+    return gemv_mixed_scalar<T>;
+}
+
+template <typename T>
+inline void gemv_mixed(const StoredMatrix<T>& m, const double* vector, double* result) {
+    static MixedKernel<T> kernel = gemv_mixed_kernel<T>(detect_simd_level());
+    kernel(m, vector, result);
+}
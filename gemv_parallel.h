@@ -0,0 +1,117 @@
+#pragma once
+
+#include "matrix.h"
+#include "thread_pool.h"
+
+// 多线程版Cache优化算法(mulb)的任务划分方式
+enum GemvPartition {
+    PARTITION_AUTO,     // 按矩阵形状自动选择
+    PARTITION_COLUMNS,  // 按结果列划分：每个线程负责result的一段，无需规约
+    PARTITION_ROWS,     // 按行块划分：每个线程写私有部分和向量，再并行规约
+    PARTITION_SERIAL    // 矩阵太小，唤醒线程的开销超过计算量，只在调用线程上计算
+};
+
+inline const char* partition_name(GemvPartition partition) {
+    switch (partition) {
+        case PARTITION_COLUMNS: return "列划分";
+        case PARTITION_ROWS: return "行划分";
+        case PARTITION_SERIAL: return "单线程";
+        default: return "自动";
+    }
+}
+
+// 每个线程分到的列段至少要覆盖若干缓存行，否则逐行访问的段太短，
+// 硬件预取来不及展开，且每行都要重新定位，此时改用行块划分
+const int MIN_COLUMNS_PER_THREAD = 16 * CACHE_LINE_DOUBLES;
+
+// 低于该元素数时自动选择单线程
+const long PARALLEL_MIN_ELEMENTS = 1L << 16;
+
+inline GemvPartition choose_partition(int n, int num_threads) {
+    if (num_threads <= 1 || (long)n * n < PARALLEL_MIN_ELEMENTS) return PARTITION_SERIAL;
+    return n / num_threads >= MIN_COLUMNS_PER_THREAD ? PARTITION_COLUMNS : PARTITION_ROWS;
+}
+
+// 行块划分所需的部分和缓冲区大小(double个数)
+inline size_t partials_size(int n, int num_threads) {
+    return (size_t)num_threads * padded_ld(n);
+}
+
+// 按列划分：线程只更新自己那段result，逐行累加顺序与mulb相同，结果逐位一致
+inline void mulb_columns_task(const Matrix& matrix, const double* vector, double* result,
+                              int num_threads, int tid) {
+    int n = matrix.n;
+    int j0, j1;
+    split_range(n, num_threads, tid, CACHE_LINE_DOUBLES, j0, j1);
+    for (int j = j0; j < j1; j++) {
+        result[j] = 0.0;
+    }
+    for (int i = 0; i < n; i++) {
+        double vi = vector[i];
+        const double* row = matrix.row(i);
+        for (int j = j0; j < j1; j++) {
+            result[j] += row[j] * vi;
+        }
+    }
+}
+
+// 按行块划分第一步：线程把自己的行块累加到私有部分和向量
+inline void mulb_rows_task(const Matrix& matrix, const double* vector, double* partials,
+                           int num_threads, int tid) {
+    int n = matrix.n;
+    int ld = padded_ld(n);
+    double* partial = partials + (size_t)tid * ld;
+    for (int j = 0; j < n; j++) {
+        partial[j] = 0.0;
+    }
+    int i0, i1;
+    split_range(n, num_threads, tid, 1, i0, i1);
+    for (int i = i0; i < i1; i++) {
+        double vi = vector[i];
+        const double* row = matrix.row(i);
+        for (int j = 0; j < n; j++) {
+            partial[j] += row[j] * vi;
+        }
+    }
+}
+
+// 按行块划分第二步：按列段并行规约各线程的部分和
+inline void reduce_partials_task(const double* partials, double* result, int n,
+                                 int num_threads, int tid) {
+    int ld = padded_ld(n);
+    int j0, j1;
+    split_range(n, num_threads, tid, CACHE_LINE_DOUBLES, j0, j1);
+    for (int j = j0; j < j1; j++) {
+        double sum = partials[j];
+        for (int t = 1; t < num_threads; t++) {
+            sum += partials[(size_t)t * ld + j];
+        }
+        result[j] = sum;
+    }
+}
+
+// 多线程Cache优化算法
+// partials仅在行块划分时使用，大小至少为partials_size(n, pool.size())
+inline GemvPartition mulb_parallel(const Matrix& matrix, const double* vector, double* result,
+                                   ThreadPool& pool, double* partials,
+                                   GemvPartition partition = PARTITION_AUTO) {
+    int num_threads = pool.size();
+    if (partition == PARTITION_AUTO) {
+        partition = choose_partition(matrix.n, num_threads);
+    }
+    if (partition == PARTITION_SERIAL) {
+        mulb_columns_task(matrix, vector, result, 1, 0);
+    } else if (partition == PARTITION_COLUMNS) {
+        pool.run([&](int tid) {
+            mulb_columns_task(matrix, vector, result, num_threads, tid);
+        });
+    } else {
+        pool.run([&](int tid) {
+            mulb_rows_task(matrix, vector, partials, num_threads, tid);
+        });
+        pool.run([&](int tid) {
+            reduce_partials_task(partials, result, matrix.n, num_threads, tid);
+        });
+    }
+    return partition;
+}
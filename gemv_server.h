@@ -0,0 +1,467 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "gemv_batch.h"
+#include "matrix.h"
+#include "thread_pool.h"
+
+// 常驻矩阵向量乘法服务：矩阵只加载一次，客户端通过Unix域套接字(SOCK_STREAM)发送向量，
+// 服务端返回 result = matrix^T * vector(与mulb相同)
+//
+// 协议(本机字节序)：连接建立后服务端先发送GemvHello；之后每个请求和应答都是一帧，
+// 8字节请求编号后接n个double，应答的编号与请求相同；一个连接上可以连续发送多个请求，应答按到达顺序返回
+//
+// 线程：一个I/O线程用poll接受连接并收齐请求帧，放入队列；一个批处理线程从队列取出请求，
+// 最老的请求等待满batch_window_us微秒或攒够max_batch个请求后，用mul_batch_parallel一次遍历矩阵算出全部结果，
+// 再把应答写回各连接。窗口为0时不主动等待，只合并计算期间积压的请求
+
+const uint32_t GEMV_SERVER_MAGIC = 0x564d4547;  // "GEMV"
+const uint32_t GEMV_HELLO_GENERATED = 1;        // 矩阵为generate_data的固定规律，客户端可以验证结果
+
+struct GemvHello {
+    uint32_t magic;
+    uint32_t n;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+// 一帧在套接字上的字节数
+inline size_t gemv_wire_bytes(int n) {
+    return sizeof(uint64_t) + (size_t)n * sizeof(double);
+}
+
+// 帧缓冲区：向量64字节对齐，8字节编号紧挨在向量之前，整帧可以直接收发，不需要再复制
+struct GemvFrame {
+    double* buffer;
+
+    explicit GemvFrame(int n) : buffer(alloc_aligned((size_t)n + CACHE_LINE_DOUBLES)) {}
+    ~GemvFrame() { free_aligned(buffer); }
+    GemvFrame(const GemvFrame&) = delete;
+    GemvFrame& operator=(const GemvFrame&) = delete;
+
+    double* data() const { return buffer + CACHE_LINE_DOUBLES; }
+    char* wire() const { return (char*)data() - sizeof(uint64_t); }
+    uint64_t id() const {
+        uint64_t id;
+        memcpy(&id, wire(), sizeof(id));
+        return id;
+    }
+    void set_id(uint64_t id) { memcpy(wire(), &id, sizeof(id)); }
+};
+
+// 阻塞地读满bytes字节，对端关闭或出错时返回false
+inline bool read_full(int fd, void* buffer, size_t bytes) {
+    char* p = (char*)buffer;
+    while (bytes > 0) {
+        ssize_t got = recv(fd, p, bytes, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        p += got;
+        bytes -= got;
+    }
+    return true;
+}
+
+// 阻塞地写完bytes字节；对端已关闭时返回false而不是触发SIGPIPE
+inline bool write_full(int fd, const void* buffer, size_t bytes) {
+    const char* p = (const char*)buffer;
+    while (bytes > 0) {
+        ssize_t put = send(fd, p, bytes, MSG_NOSIGNAL);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        p += put;
+        bytes -= put;
+    }
+    return true;
+}
+
+inline bool unix_address(const char* path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, path);
+    return true;
+}
+
+struct GemvServerOptions {
+    int threads = 1;             // 计算线程数(按结果列划分)
+    int max_batch = 32;          // 一次遍历矩阵最多合并的请求数
+    int batch_window_us = 100;   // 最老的请求最多等待多久再开始计算(微秒)
+};
+
+struct GemvServerStats {
+    long long connections = 0;   // 累计接受的连接数
+    long long requests = 0;      // 已应答的请求数
+    long long batches = 0;       // 遍历矩阵的次数
+    double compute_seconds = 0;  // 批量计算累计耗时
+};
+
+class GemvServer {
+public:
+    // matrix在服务运行期间必须保持有效；generated表示矩阵为generate_data的规律
+    GemvServer(const Matrix& matrix, bool generated, const GemvServerOptions& options)
+        : matrix_(matrix), generated_(generated), options_(options) {
+        if (options_.threads < 1) options_.threads = 1;
+        if (options_.max_batch < 1) options_.max_batch = 1;
+        if (options_.batch_window_us < 0) options_.batch_window_us = 0;
+    }
+
+    ~GemvServer() { stop(); }
+
+    GemvServer(const GemvServer&) = delete;
+    GemvServer& operator=(const GemvServer&) = delete;
+
+    // 在path上监听并启动I/O线程和批处理线程；path已存在时先删除
+    bool start(const char* path) {
+        sockaddr_un address;
+        if (!unix_address(path, address)) {
+            error_ = "套接字路径过长";
+            return false;
+        }
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0 || pipe(wake_) != 0) {
+            error_ = strerror(errno);
+            return false;
+        }
+        unlink(path);
+        if (bind(listen_fd_, (sockaddr*)&address, sizeof(address)) != 0 || listen(listen_fd_, 128) != 0) {
+            error_ = strerror(errno);
+            return false;
+        }
+        path_ = path;
+        io_thread_ = std::thread(&GemvServer::io_loop, this);
+        batch_thread_ = std::thread(&GemvServer::batch_loop, this);
+        return true;
+    }
+
+    // 停止服务：不再接受连接，丢弃尚未计算的请求，关闭全部连接
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) return;
+            stop_ = true;
+        }
+        queue_cv_.notify_all();
+        if (wake_[1] >= 0) {
+            char byte = 0;
+            (void)!write(wake_[1], &byte, 1);
+        }
+        if (io_thread_.joinable()) io_thread_.join();
+        if (batch_thread_.joinable()) batch_thread_.join();
+        for (GemvRequest& request : queue_) {
+            delete request.frame;
+        }
+        queue_.clear();
+        for (GemvFrame* frame : free_frames_) {
+            delete frame;
+        }
+        free_frames_.clear();
+        if (listen_fd_ >= 0) close(listen_fd_);
+        for (int fd : wake_) {
+            if (fd >= 0) close(fd);
+        }
+        listen_fd_ = wake_[0] = wake_[1] = -1;
+        if (!path_.empty()) unlink(path_.c_str());
+    }
+
+    GemvServerStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    const GemvServerOptions& options() const { return options_; }
+    const std::string& error() const { return error_; }
+
+private:
+    // 连接在最后一个引用(I/O线程或尚未应答的请求)释放时关闭
+    struct GemvConnection {
+        int fd;
+        std::atomic<bool> open{true};
+        GemvFrame* pending = nullptr;  // 正在接收的请求帧
+        size_t received = 0;           // pending已收到的字节数
+
+        explicit GemvConnection(int fd) : fd(fd) {}
+        ~GemvConnection() {
+            delete pending;
+            close(fd);
+        }
+    };
+
+    struct GemvRequest {
+        std::shared_ptr<GemvConnection> connection;
+        GemvFrame* frame;
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    GemvFrame* take_frame() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_frames_.empty()) return new GemvFrame(matrix_.n);
+        GemvFrame* frame = free_frames_.back();
+        free_frames_.pop_back();
+        return frame;
+    }
+
+    void accept_connection(std::vector<std::shared_ptr<GemvConnection>>& connections) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) return;
+        GemvHello hello = {GEMV_SERVER_MAGIC, (uint32_t)matrix_.n, generated_ ? GEMV_HELLO_GENERATED : 0u, 0u};
+        if (!write_full(fd, &hello, sizeof(hello))) {
+            close(fd);
+            return;
+        }
+        connections.push_back(std::make_shared<GemvConnection>(fd));
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.connections++;
+    }
+
+    // 非阻塞地接收当前可读的数据，收齐一帧就放入队列；连接关闭或出错时返回false
+    bool receive(const std::shared_ptr<GemvConnection>& connection) {
+        size_t frame_bytes = gemv_wire_bytes(matrix_.n);
+        while (true) {
+            if (connection->pending == nullptr) connection->pending = take_frame();
+            char* wire = connection->pending->wire();
+            ssize_t got = recv(connection->fd, wire + connection->received, frame_bytes - connection->received,
+                               MSG_DONTWAIT);
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+            if (got == 0) return false;
+            connection->received += got;
+            if (connection->received < frame_bytes) continue;
+
+            GemvRequest request = {connection, connection->pending, std::chrono::steady_clock::now()};
+            connection->pending = nullptr;
+            connection->received = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_.push_back(request);
+            }
+            queue_cv_.notify_one();
+        }
+    }
+
+    void io_loop() {
+        std::vector<std::shared_ptr<GemvConnection>> connections;
+        std::vector<pollfd> fds;
+        while (true) {
+            fds.clear();
+            fds.push_back({wake_[0], POLLIN, 0});
+            fds.push_back({listen_fd_, POLLIN, 0});
+            for (const auto& connection : connections) {
+                fds.push_back({connection->fd, POLLIN, 0});
+            }
+            if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) break;
+            if (fds[0].revents != 0) break;
+
+            // 先处理已有连接(fds[2+k]对应connections[k])，再接受新连接
+            size_t kept = 0;
+            for (size_t k = 0; k < connections.size(); k++) {
+                bool alive = fds[2 + k].revents == 0 || receive(connections[k]);
+                if (alive) {
+                    connections[kept++] = connections[k];
+                } else {
+                    connections[k]->open = false;
+                }
+            }
+            connections.resize(kept);
+            if (fds[1].revents & POLLIN) accept_connection(connections);
+        }
+        // 唤醒仍阻塞在send上的批处理线程，连接随最后一个引用关闭
+        for (const auto& connection : connections) {
+            connection->open = false;
+            shutdown(connection->fd, SHUT_RDWR);
+        }
+    }
+
+    void batch_loop() {
+        // 线程池在批处理线程中创建，批处理线程作为0号计算线程
+        ThreadPool pool(options_.threads);
+        int max_batch = options_.max_batch;
+        std::vector<GemvRequest> batch;
+        std::vector<const double*> vectors(max_batch);
+        std::vector<double*> results(max_batch);
+        std::vector<GemvFrame*> replies;
+        for (int c = 0; c < max_batch; c++) {
+            replies.push_back(new GemvFrame(matrix_.n));
+            results[c] = replies[c]->data();
+        }
+        size_t frame_bytes = gemv_wire_bytes(matrix_.n);
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                queue_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+                if (stop_) break;
+                auto deadline = queue_.front().arrival + std::chrono::microseconds(options_.batch_window_us);
+                queue_cv_.wait_until(lock, deadline, [this, max_batch] {
+                    return stop_ || (int)queue_.size() >= max_batch;
+                });
+                if (stop_) break;
+                int k = (int)queue_.size() < max_batch ? (int)queue_.size() : max_batch;
+                batch.assign(queue_.begin(), queue_.begin() + k);
+                queue_.erase(queue_.begin(), queue_.begin() + k);
+            }
+
+            int k = (int)batch.size();
+            for (int c = 0; c < k; c++) {
+                vectors[c] = batch[c].frame->data();
+            }
+            auto start = std::chrono::steady_clock::now();
+            mul_batch_parallel(matrix_, vectors.data(), results.data(), k, pool);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for (int c = 0; c < k; c++) {
+                GemvConnection& connection = *batch[c].connection;
+                replies[c]->set_id(batch[c].frame->id());
+                if (connection.open && !write_full(connection.fd, replies[c]->wire(), frame_bytes)) {
+                    connection.open = false;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (GemvRequest& request : batch) {
+                free_frames_.push_back(request.frame);
+            }
+            batch.clear();
+            stats_.requests += k;
+            stats_.batches++;
+            stats_.compute_seconds += seconds;
+        }
+
+        for (GemvFrame* frame : replies) {
+            delete frame;
+        }
+    }
+
+    const Matrix& matrix_;
+    bool generated_;
+    GemvServerOptions options_;
+    std::string path_;
+    std::string error_;
+    int listen_fd_ = -1;
+    int wake_[2] = {-1, -1};       // 自管道，stop()写入一个字节唤醒poll
+    std::thread io_thread_;
+    std::thread batch_thread_;
+    mutable std::mutex mutex_;     // 保护queue_、free_frames_、stats_和stop_
+    std::condition_variable queue_cv_;
+    std::deque<GemvRequest> queue_;
+    std::vector<GemvFrame*> free_frames_;
+    GemvServerStats stats_;
+    bool stop_ = false;
+};
+
+// ---------------- 客户端与负载生成 ----------------
+
+// 连接到path上的服务并读取握手，失败时返回-1
+inline int gemv_connect(const char* path, GemvHello& hello) {
+    sockaddr_un address;
+    if (!unix_address(path, address)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) != 0 || !read_full(fd, &hello, sizeof(hello)) ||
+        hello.magic != GEMV_SERVER_MAGIC) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct GemvLoadResult {
+    bool ok = false;
+    long long requests = 0;          // 计量期间完成的请求数
+    double seconds = 0.0;            // 计量时长
+    std::vector<double> latencies;   // 计量期间每个请求的往返延迟(秒)
+    bool correct = true;             // 每个客户端的第一个应答是否与expected一致(expected为空时不验证)
+    const char* error = "";
+};
+
+// 闭环负载：clients个客户端各开一个连接，每个客户端发出请求、收到应答后立即发下一个；
+// 前warmup秒不计量(建立连接、预热缓存)，之后seconds秒内的请求计入延迟和吞吐量
+inline GemvLoadResult run_gemv_load(const char* path, int clients, double warmup, double seconds,
+                                    const double* vector, const double* expected) {
+    GemvLoadResult load;
+    std::vector<int> fds;
+    GemvHello hello = {};
+    for (int c = 0; c < clients; c++) {
+        int fd = gemv_connect(path, hello);
+        if (fd < 0) {
+            load.error = "无法连接到服务";
+            break;
+        }
+        fds.push_back(fd);
+    }
+    if ((int)fds.size() < clients) {
+        for (int fd : fds) {
+            close(fd);
+        }
+        return load;
+    }
+
+    int n = (int)hello.n;
+    size_t frame_bytes = gemv_wire_bytes(n);
+    auto begin = std::chrono::steady_clock::now() + std::chrono::duration<double>(warmup);
+    auto end = begin + std::chrono::duration<double>(seconds);
+    std::vector<std::vector<double>> latencies(clients);
+    std::vector<char> correct(clients, 1);
+    std::vector<char> failed(clients, 0);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; c++) {
+        threads.emplace_back([&, c] {
+            GemvFrame request(n), reply(n);
+            memcpy(request.data(), vector, (size_t)n * sizeof(double));
+            for (uint64_t id = 0;; id++) {
+                auto sent = std::chrono::steady_clock::now();
+                if (sent >= end) break;
+                request.set_id(id);
+                if (!write_full(fds[c], request.wire(), frame_bytes) || !read_full(fds[c], reply.wire(), frame_bytes) ||
+                    reply.id() != id) {
+                    failed[c] = 1;
+                    break;
+                }
+                auto received = std::chrono::steady_clock::now();
+                if (id == 0 && expected != nullptr) {
+                    for (int j = 0; j < n; j++) {
+                        if (std::fabs(reply.data()[j] - expected[j]) > 1e-10) correct[c] = 0;
+                    }
+                }
+                if (sent >= begin && received <= end) {
+                    latencies[c].push_back(std::chrono::duration<double>(received - sent).count());
+                }
+            }
+            close(fds[c]);
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    load.ok = true;
+    load.seconds = seconds;
+    for (int c = 0; c < clients; c++) {
+        load.latencies.insert(load.latencies.end(), latencies[c].begin(), latencies[c].end());
+        load.correct = load.correct && correct[c];
+        if (failed[c]) {
+            load.ok = false;
+            load.error = "服务中途断开";
+        }
+    }
+    load.requests = (long long)load.latencies.size();
+    return load;
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "matrix.h"
+
+// 手写SIMD矩阵向量乘法微内核，计算 result[j] = Σ_i matrix[i][j] * vector[i]
+//
+// 行累加顺序(axpy)：与mulb/muld相同按行访问矩阵，每次取8行为一个行块，
+// 把result的一段(AVX2为16个、AVX-512为32个double，即4个向量寄存器)留在寄存器中
+// 连续累加这8行后再写回，result的读写次数降为mulb的1/8
+//
+// 点积顺序(dot)：在转置副本上计算，result[j]为转置矩阵第j行与vector的内积，
+// 使用4个独立的向量累加器隐藏FMA延迟，最后做水平规约
+
+const int SIMD_ROW_BLOCK = 8;
+
+// 生成转置副本 transposed[j][i] = matrix[i][j]，transposed需已按同样规模分配
+inline void transpose_matrix(const Matrix& matrix, Matrix& transposed) {
+    int n = matrix.n;
+    const int block = 32;  // 分块转置，读写两侧都保持在L1内
+    for (int ib = 0; ib < n; ib += block) {
+        for (int jb = 0; jb < n; jb += block) {
+            int i_end = ib + block < n ? ib + block : n;
+            int j_end = jb + block < n ? jb + block : n;
+            for (int i = ib; i < i_end; i++) {
+                const double* row = matrix.row(i);
+                for (int j = jb; j < j_end; j++) {
+                    transposed.row(j)[i] = row[j];
+                }
+            }
+        }
+    }
+}
+
+// ---------------- 标量版本(不支持AVX2时使用) ----------------
+
+inline void gemv_axpy_scalar(const Matrix& matrix, const double* vector, double* result) {
+    int n = matrix.n;
+    for (int j = 0; j < n; j++) {
+        result[j] = 0.0;
+    }
+    for (int i = 0; i < n; i++) {
+        double vi = vector[i];
+        const double* row = matrix.row(i);
+        for (int j = 0; j < n; j++) {
+            result[j] += row[j] * vi;
+        }
+    }
+}
+
+inline void gemv_dot_scalar(const Matrix& transposed, const double* vector, double* result) {
+    int n = transposed.n;
+    for (int j = 0; j < n; j++) {
+        const double* col = transposed.row(j);
+        double sum = 0.0;
+        for (int i = 0; i < n; i++) {
+            sum += col[i] * vector[i];
+        }
+        result[j] = sum;
+    }
+}
+
+// ---------------- AVX2 + FMA ----------------
+
+__attribute__((target("avx2,fma")))
+inline void gemv_axpy_avx2(const Matrix& matrix, const double* vector, double* result) {
+    int n = matrix.n;
+    for (int j = 0; j < n; j++) {
+        result[j] = 0.0;
+    }
+
+    int i = 0;
+    for (; i + SIMD_ROW_BLOCK - 1 < n; i += SIMD_ROW_BLOCK) {
+        const double* r[SIMD_ROW_BLOCK];
+        __m256d v[SIMD_ROW_BLOCK];
+        for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+            r[k] = matrix.row(i + k);
+            v[k] = _mm256_set1_pd(vector[i + k]);
+        }
+
+        int j = 0;
+        for (; j + 15 < n; j += 16) {
+            __m256d y0 = _mm256_loadu_pd(result + j);
+            __m256d y1 = _mm256_loadu_pd(result + j + 4);
+            __m256d y2 = _mm256_loadu_pd(result + j + 8);
+            __m256d y3 = _mm256_loadu_pd(result + j + 12);
+            for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+                y0 = _mm256_fmadd_pd(_mm256_loadu_pd(r[k] + j), v[k], y0);
+                y1 = _mm256_fmadd_pd(_mm256_loadu_pd(r[k] + j + 4), v[k], y1);
+                y2 = _mm256_fmadd_pd(_mm256_loadu_pd(r[k] + j + 8), v[k], y2);
+                y3 = _mm256_fmadd_pd(_mm256_loadu_pd(r[k] + j + 12), v[k], y3);
+            }
+            _mm256_storeu_pd(result + j, y0);
+            _mm256_storeu_pd(result + j + 4, y1);
+            _mm256_storeu_pd(result + j + 8, y2);
+            _mm256_storeu_pd(result + j + 12, y3);
+        }
+        for (; j + 3 < n; j += 4) {
+            __m256d y = _mm256_loadu_pd(result + j);
+            for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+                y = _mm256_fmadd_pd(_mm256_loadu_pd(r[k] + j), v[k], y);
+            }
+            _mm256_storeu_pd(result + j, y);
+        }
+        // 处理剩余列
+        for (; j < n; j++) {
+            double y = result[j];
+            for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+                y += r[k][j] * vector[i + k];
+            }
+            result[j] = y;
+        }
+    }
+
+    // 处理剩余行
+    for (; i < n; i++) {
+        const double* row = matrix.row(i);
+        __m256d vi = _mm256_set1_pd(vector[i]);
+        int j = 0;
+        for (; j + 3 < n; j += 4) {
+            __m256d y = _mm256_loadu_pd(result + j);
+            _mm256_storeu_pd(result + j, _mm256_fmadd_pd(_mm256_loadu_pd(row + j), vi, y));
+        }
+        for (; j < n; j++) {
+            result[j] += row[j] * vector[i];
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline void gemv_dot_avx2(const Matrix& transposed, const double* vector, double* result) {
+    int n = transposed.n;
+    for (int j = 0; j < n; j++) {
+        const double* col = transposed.row(j);
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        __m256d acc2 = _mm256_setzero_pd();
+        __m256d acc3 = _mm256_setzero_pd();
+        int i = 0;
+        for (; i + 15 < n; i += 16) {
+            acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(col + i), _mm256_loadu_pd(vector + i), acc0);
+            acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(col + i + 4), _mm256_loadu_pd(vector + i + 4), acc1);
+            acc2 = _mm256_fmadd_pd(_mm256_loadu_pd(col + i + 8), _mm256_loadu_pd(vector + i + 8), acc2);
+            acc3 = _mm256_fmadd_pd(_mm256_loadu_pd(col + i + 12), _mm256_loadu_pd(vector + i + 12), acc3);
+        }
+        for (; i + 3 < n; i += 4) {
+            acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(col + i), _mm256_loadu_pd(vector + i), acc0);
+        }
+        // 水平规约
+        __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+        __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+        double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        for (; i < n; i++) {
+            sum += col[i] * vector[i];
+        }
+        result[j] = sum;
+    }
+}
+
+// ---------------- AVX-512 ----------------
+
+__attribute__((target("avx512f")))
+inline void gemv_axpy_avx512(const Matrix& matrix, const double* vector, double* result) {
+    int n = matrix.n;
+    for (int j = 0; j < n; j++) {
+        result[j] = 0.0;
+    }
+
+    int i = 0;
+    for (; i + SIMD_ROW_BLOCK - 1 < n; i += SIMD_ROW_BLOCK) {
+        const double* r[SIMD_ROW_BLOCK];
+        __m512d v[SIMD_ROW_BLOCK];
+        for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+            r[k] = matrix.row(i + k);
+            v[k] = _mm512_set1_pd(vector[i + k]);
+        }
+
+        int j = 0;
+        for (; j + 31 < n; j += 32) {
+            __m512d y0 = _mm512_loadu_pd(result + j);
+            __m512d y1 = _mm512_loadu_pd(result + j + 8);
+            __m512d y2 = _mm512_loadu_pd(result + j + 16);
+            __m512d y3 = _mm512_loadu_pd(result + j + 24);
+            for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+                y0 = _mm512_fmadd_pd(_mm512_loadu_pd(r[k] + j), v[k], y0);
+                y1 = _mm512_fmadd_pd(_mm512_loadu_pd(r[k] + j + 8), v[k], y1);
+                y2 = _mm512_fmadd_pd(_mm512_loadu_pd(r[k] + j + 16), v[k], y2);
+                y3 = _mm512_fmadd_pd(_mm512_loadu_pd(r[k] + j + 24), v[k], y3);
+            }
+            _mm512_storeu_pd(result + j, y0);
+            _mm512_storeu_pd(result + j + 8, y1);
+            _mm512_storeu_pd(result + j + 16, y2);
+            _mm512_storeu_pd(result + j + 24, y3);
+        }
+        // 剩余列用掩码处理，不足8个时只读写有效部分
+        for (; j < n; j += 8) {
+            __mmask8 mask = n - j >= 8 ? 0xFF : (__mmask8)((1u << (n - j)) - 1);
+            __m512d y = _mm512_maskz_loadu_pd(mask, result + j);
+            for (int k = 0; k < SIMD_ROW_BLOCK; k++) {
+                y = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, r[k] + j), v[k], y);
+            }
+            _mm512_mask_storeu_pd(result + j, mask, y);
+        }
+    }
+
+    // 处理剩余行
+    for (; i < n; i++) {
+        const double* row = matrix.row(i);
+        __m512d vi = _mm512_set1_pd(vector[i]);
+        for (int j = 0; j < n; j += 8) {
+            __mmask8 mask = n - j >= 8 ? 0xFF : (__mmask8)((1u << (n - j)) - 1);
+            __m512d y = _mm512_maskz_loadu_pd(mask, result + j);
+            y = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, row + j), vi, y);
+            _mm512_mask_storeu_pd(result + j, mask, y);
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void gemv_dot_avx512(const Matrix& transposed, const double* vector, double* result) {
+    int n = transposed.n;
+    for (int j = 0; j < n; j++) {
+        const double* col = transposed.row(j);
+        __m512d acc0 = _mm512_setzero_pd();
+        __m512d acc1 = _mm512_setzero_pd();
+        __m512d acc2 = _mm512_setzero_pd();
+        __m512d acc3 = _mm512_setzero_pd();
+        int i = 0;
+        for (; i + 31 < n; i += 32) {
+            acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(col + i), _mm512_loadu_pd(vector + i), acc0);
+            acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(col + i + 8), _mm512_loadu_pd(vector + i + 8), acc1);
+            acc2 = _mm512_fmadd_pd(_mm512_loadu_pd(col + i + 16), _mm512_loadu_pd(vector + i + 16), acc2);
+            acc3 = _mm512_fmadd_pd(_mm512_loadu_pd(col + i + 24), _mm512_loadu_pd(vector + i + 24), acc3);
+        }
+        for (; i < n; i += 8) {
+            __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8)((1u << (n - i)) - 1);
+            acc0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, col + i),
+                                   _mm512_maskz_loadu_pd(mask, vector + i), acc0);
+        }
+        // 水平规约
+        __m512d acc = _mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3));
+        double lanes[8];
+        _mm512_storeu_pd(lanes, acc);
+        result[j] = ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) +
+                    ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+    }
+}
+
+// ---------------- 运行时分派 ----------------
+
+typedef void (*GemvSimdKernel)(const Matrix& matrix, const double* vector, double* result);
+
+// 以level为上限、本机实际可用的指令集；没有SSE2版本，SSE2与标量相同
+inline SimdLevel gemv_simd_level(SimdLevel level) {
+    if (level >= SIMD_AVX512 && simd_supported(SIMD_AVX512)) return SIMD_AVX512;
+    if (level >= SIMD_AVX2 && simd_supported(SIMD_AVX2)) return SIMD_AVX2;
+    return SIMD_SCALAR;
+}
+
+inline GemvSimdKernel gemv_axpy_kernel(SimdLevel level) {
+    switch (gemv_simd_level(level)) {
+        case SIMD_AVX512: return gemv_axpy_avx512;
+        case SIMD_AVX2: return gemv_axpy_avx2;
+        default: return gemv_axpy_scalar;
+    }
+}
+
+inline GemvSimdKernel gemv_dot_kernel(SimdLevel level) {
+    switch (gemv_simd_level(level)) {
+        case SIMD_AVX512: return gemv_dot_avx512;
+        case SIMD_AVX2: return gemv_dot_avx2;
+        default: return gemv_dot_scalar;
+    }
+}
+
+// 行累加顺序，使用本机最宽的指令集
+inline void gemv_axpy_simd(const Matrix& matrix, const double* vector, double* result) {
+    static GemvSimdKernel kernel = gemv_axpy_kernel(detect_simd_level());
+    kernel(matrix, vector, result);
+}
+
+// 点积顺序，transposed为transpose_matrix生成的转置副本
+inline void gemv_dot_simd(const Matrix& transposed, const double* vector, double* result) {
+    static GemvSimdKernel kernel = gemv_dot_kernel(detect_simd_level());
+    kernel(transposed, vector, result);
+}
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include "cpu_features.h"
+#include "sparse_matrix.h"
+#include "thread_pool.h"
+
+// 稀疏矩阵向量乘法内核，计算 y[r] = Σ_k values(r,k) * x[col(r,k)]
+// 每个内核只处理一段行(CSR/ELL)或一段块(SELL)，整段调用即为单线程版本，
+// 多线程版本把行/块按非零元个数均分给各线程
+//
+// CSR：逐行计算，行内用gather取x，行短时向量利用率低，且每行都要做一次水平规约
+// ELL/SELL：SELL_C=8行为一组，每条向量指令处理8行的同一位置，行之间天然对齐，不需要水平规约；
+// AVX2每组拆成两个4通道向量
+
+// ---------------- 标量版本 ----------------
+
+inline void spmv_csr_scalar(const CsrMatrix& m, const double* x, double* y, int row_begin, int row_end) {
+    for (int r = row_begin; r < row_end; r++) {
+        double sum = 0.0;
+        for (int k = m.row_ptr[r]; k < m.row_ptr[r + 1]; k++) {
+            sum += m.values[k] * x[m.col_idx[k]];
+        }
+        y[r] = sum;
+    }
+}
+
+// ELL按SELL_C行为一组划分，row_begin为SELL_C的倍数
+inline void spmv_ell_scalar(const EllMatrix& m, const double* x, double* y, int row_begin, int row_end) {
+    for (int r = row_begin; r < row_end; r++) {
+        double sum = 0.0;
+        for (int k = 0; k < m.width; k++) {
+            size_t pos = (size_t)k * m.rows_padded + r;
+            sum += m.values[pos] * x[m.col_idx[pos]];
+        }
+        y[r] = sum;
+    }
+}
+
+inline void spmv_sell_scalar(const SellMatrix& m, const double* x, double* y, int chunk_begin, int chunk_end) {
+    for (int c = chunk_begin; c < chunk_end; c++) {
+        double sums[SELL_C] = {};
+        for (int k = 0; k < m.chunk_len[c]; k++) {
+            const int* cols = m.col_idx + m.chunk_ptr[c] + (size_t)k * SELL_C;
+            const double* vals = m.values + m.chunk_ptr[c] + (size_t)k * SELL_C;
+            for (int lane = 0; lane < SELL_C; lane++) {
+                sums[lane] += vals[lane] * x[cols[lane]];
+            }
+        }
+        for (int lane = 0; lane < SELL_C; lane++) {
+            int r = m.perm[c * SELL_C + lane];
+            if (r >= 0) y[r] = sums[lane];
+        }
+    }
+}
+
+// ---------------- AVX2 + FMA ----------------
+
+// 取x[idx[0..3]]。GCC的非掩码gather以未初始化的寄存器为源操作数，-Wall下会误报，这里用零源的掩码形式
+__attribute__((target("avx2,fma")))
+inline __m256d gather_avx2(const double* x, const int* idx) {
+    __m128i index = _mm_loadu_si128((const __m128i*)idx);
+    __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, index, all, 8);
+}
+
+__attribute__((target("avx2,fma")))
+inline void spmv_csr_avx2(const CsrMatrix& m, const double* x, double* y, int row_begin, int row_end) {
+    for (int r = row_begin; r < row_end; r++) {
+        int k = m.row_ptr[r];
+        int end = m.row_ptr[r + 1];
+        double sum = 0.0;
+        // 短行(不足一个向量)直接走标量，避免水平规约的开销
+        if (end - k >= 4) {
+            __m256d acc = _mm256_setzero_pd();
+            for (; k + 3 < end; k += 4) {
+                acc = _mm256_fmadd_pd(_mm256_loadu_pd(m.values + k), gather_avx2(x, m.col_idx + k), acc);
+            }
+            __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+            sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        }
+        for (; k < end; k++) {
+            sum += m.values[k] * x[m.col_idx[k]];
+        }
+        y[r] = sum;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline void spmv_ell_avx2(const EllMatrix& m, const double* x, double* y, int row_begin, int row_end) {
+    for (int r = row_begin; r < row_end; r += SELL_C) {
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        for (int k = 0; k < m.width; k++) {
+            size_t pos = (size_t)k * m.rows_padded + r;
+            acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(m.values + pos), gather_avx2(x, m.col_idx + pos), acc0);
+            acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(m.values + pos + 4), gather_avx2(x, m.col_idx + pos + 4), acc1);
+        }
+        // 最后一组可能越过rows，补齐的行不写回
+        double sums[SELL_C];
+        _mm256_storeu_pd(sums, acc0);
+        _mm256_storeu_pd(sums + 4, acc1);
+        int count = row_end - r < SELL_C ? row_end - r : SELL_C;
+        for (int lane = 0; lane < count; lane++) {
+            y[r + lane] = sums[lane];
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline void spmv_sell_avx2(const SellMatrix& m, const double* x, double* y, int chunk_begin, int chunk_end) {
+    for (int c = chunk_begin; c < chunk_end; c++) {
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        const int* cols = m.col_idx + m.chunk_ptr[c];
+        const double* vals = m.values + m.chunk_ptr[c];
+        for (int k = 0; k < m.chunk_len[c]; k++, cols += SELL_C, vals += SELL_C) {
+            acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(vals), gather_avx2(x, cols), acc0);
+            acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(vals + 4), gather_avx2(x, cols + 4), acc1);
+        }
+        double sums[SELL_C];
+        _mm256_storeu_pd(sums, acc0);
+        _mm256_storeu_pd(sums + 4, acc1);
+        for (int lane = 0; lane < SELL_C; lane++) {
+            int r = m.perm[c * SELL_C + lane];
+            if (r >= 0) y[r] = sums[lane];
+        }
+    }
+}
+
+// ---------------- AVX-512 ----------------
+
+// 取x[idx[0..7]]，原因同gather_avx2
+__attribute__((target("avx512f")))
+inline __m512d gather_avx512(const double* x, const int* idx) {
+    __m256i index = _mm256_loadu_si256((const __m256i*)idx);
+    return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), (__mmask8)0xFF, index, x, 8);
+}
+
+__attribute__((target("avx512f")))
+inline void spmv_csr_avx512(const CsrMatrix& m, const double* x, double* y, int row_begin, int row_end) {
+    for (int r = row_begin; r < row_end; r++) {
+        int k = m.row_ptr[r];
+        int end = m.row_ptr[r + 1];
+        double sum = 0.0;
+        // 短行(不足一个向量)直接走标量
+        if (end - k >= 8) {
+            __m512d acc = _mm512_setzero_pd();
+            for (; k + 7 < end; k += 8) {
+                acc = _mm512_fmadd_pd(_mm512_loadu_pd(m.values + k), gather_avx512(x, m.col_idx + k), acc);
+            }
+            double lanes[8];
+            _mm512_storeu_pd(lanes, acc);
+            sum = ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+        }
+        for (; k < end; k++) {
+            sum += m.values[k] * x[m.col_idx[k]];
+        }
+        y[r] = sum;
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void spmv_ell_avx512(const EllMatrix& m, const double* x, double* y, int row_begin, int row_end) {
+    for (int r = row_begin; r < row_end; r += SELL_C) {
+        __m512d acc = _mm512_setzero_pd();
+        for (int k = 0; k < m.width; k++) {
+            size_t pos = (size_t)k * m.rows_padded + r;
+            acc = _mm512_fmadd_pd(_mm512_loadu_pd(m.values + pos), gather_avx512(x, m.col_idx + pos), acc);
+        }
+        int count = row_end - r < SELL_C ? row_end - r : SELL_C;
+        _mm512_mask_storeu_pd(y + r, (__mmask8)((1u << count) - 1), acc);
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void spmv_sell_avx512(const SellMatrix& m, const double* x, double* y, int chunk_begin, int chunk_end) {
+    for (int c = chunk_begin; c < chunk_end; c++) {
+        // 两个累加器交替使用，隐藏FMA延迟
+        __m512d acc0 = _mm512_setzero_pd();
+        __m512d acc1 = _mm512_setzero_pd();
+        const int* cols = m.col_idx + m.chunk_ptr[c];
+        const double* vals = m.values + m.chunk_ptr[c];
+        int len = m.chunk_len[c];
+        int k = 0;
+        for (; k + 1 < len; k += 2, cols += 2 * SELL_C, vals += 2 * SELL_C) {
+            acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(vals), gather_avx512(x, cols), acc0);
+            acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(vals + SELL_C), gather_avx512(x, cols + SELL_C), acc1);
+        }
+        if (k < len) {
+            acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(vals), gather_avx512(x, cols), acc0);
+        }
+        // 按perm写回原始行
+        double sums[SELL_C];
+        _mm512_storeu_pd(sums, _mm512_add_pd(acc0, acc1));
+        for (int lane = 0; lane < SELL_C; lane++) {
+            int r = m.perm[c * SELL_C + lane];
+            if (r >= 0) y[r] = sums[lane];
+        }
+    }
+}
+
+// ---------------- 运行时分派 ----------------
+
+typedef void (*SpmvCsrKernel)(const CsrMatrix& m, const double* x, double* y, int row_begin, int row_end);
+typedef void (*SpmvEllKernel)(const EllMatrix& m, const double* x, double* y, int row_begin, int row_end);
+typedef void (*SpmvSellKernel)(const SellMatrix& m, const double* x, double* y, int chunk_begin, int chunk_end);
+
+inline SpmvCsrKernel spmv_csr_kernel(SimdLevel level) {
+    if (level >= SIMD_AVX512 && simd_supported(SIMD_AVX512)) return spmv_csr_avx512;
+    if (level >= SIMD_AVX2 && simd_supported(SIMD_AVX2)) return spmv_csr_avx2;
+    return spmv_csr_scalar;
+}
+
+inline SpmvEllKernel spmv_ell_kernel(SimdLevel level) {
+    if (level >= SIMD_AVX512 && simd_supported(SIMD_AVX512)) return spmv_ell_avx512;
+    if (level >= SIMD_AVX2 && simd_supported(SIMD_AVX2)) return spmv_ell_avx2;
+    return spmv_ell_scalar;
+}
+
+inline SpmvSellKernel spmv_sell_kernel(SimdLevel level) {
+    if (level >= SIMD_AVX512 && simd_supported(SIMD_AVX512)) return spmv_sell_avx512;
+    if (level >= SIMD_AVX2 && simd_supported(SIMD_AVX2)) return spmv_sell_avx2;
+    return spmv_sell_scalar;
+}
+
+// 单线程版本，使用本机最宽的指令集
+inline void spmv_csr(const CsrMatrix& m, const double* x, double* y) {
+    static SpmvCsrKernel kernel = spmv_csr_kernel(detect_simd_level());
+    kernel(m, x, y, 0, m.rows);
+}
+
+inline void spmv_ell(const EllMatrix& m, const double* x, double* y) {
+    static SpmvEllKernel kernel = spmv_ell_kernel(detect_simd_level());
+    kernel(m, x, y, 0, m.rows);
+}
+
+inline void spmv_sell(const SellMatrix& m, const double* x, double* y) {
+    static SpmvSellKernel kernel = spmv_sell_kernel(detect_simd_level());
+    kernel(m, x, y, 0, m.num_chunks);
+}
+
+// ---------------- 多线程版本 ----------------
+
+// 按累计工作量prefix(长度count+1，单调递增)把[0, count)分成num_parts段，
+// 每段的工作量接近总量的1/num_parts；行长差别很大时比按行数均分更均衡
+inline void split_by_work(const int* prefix, int count, int num_parts, int part, int& begin, int& end) {
+    long total = prefix[count];
+    auto boundary = [&](int p) {
+        if (p >= num_parts) return count;
+        long target = total * p / num_parts;
+        return (int)(std::lower_bound(prefix, prefix + count + 1, target) - prefix);
+    };
+    begin = boundary(part);
+    end = boundary(part + 1);
+    if (end > count) end = count;
+}
+
+// CSR按非零元个数均分行
+inline void spmv_csr_parallel(ThreadPool& pool, const CsrMatrix& m, const double* x, double* y) {
+    static SpmvCsrKernel kernel = spmv_csr_kernel(detect_simd_level());
+    int num_threads = pool.size();
+    pool.run([&](int tid) {
+        int begin, end;
+        split_by_work(m.row_ptr, m.rows, num_threads, tid, begin, end);
+        kernel(m, x, y, begin, end);
+    });
+}
+
+// ELL每行工作量相同，按SELL_C行为单位均分
+inline void spmv_ell_parallel(ThreadPool& pool, const EllMatrix& m, const double* x, double* y) {
+    static SpmvEllKernel kernel = spmv_ell_kernel(detect_simd_level());
+    int num_threads = pool.size();
+    pool.run([&](int tid) {
+        int begin, end;
+        split_range(m.rows, num_threads, tid, SELL_C, begin, end);
+        kernel(m, x, y, begin, end);
+    });
+}
+
+// SELL按补齐后的元素个数均分块
+inline void spmv_sell_parallel(ThreadPool& pool, const SellMatrix& m, const double* x, double* y) {
+    static SpmvSellKernel kernel = spmv_sell_kernel(detect_simd_level());
+    int num_threads = pool.size();
+    pool.run([&](int tid) {
+        int begin, end;
+        split_by_work(m.chunk_ptr, m.num_chunks, num_threads, tid, begin, end);
+        kernel(m, x, y, begin, end);
+    });
+}
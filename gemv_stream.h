@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <vector>
+
+#include "file_stream.h"
+
+// 外存矩阵向量乘法：矩阵以n x n个原始double按行存放在文件中(行距为n，无填充)，
+// 按行面板流式读入，后台线程读第k+1个面板的同时对第k个面板做mulb式的行累加；
+// 只有结果向量、输入向量和两个面板缓冲区常驻内存
+
+// 面板行数：面板约占panel_bytes，且面板字节数为4KB的整数倍(O_DIRECT和madvise的要求)，
+// 这样stream_file的块边界恰好落在行边界上
+inline int stream_panel_rows(int n, size_t panel_bytes) {
+    size_t row_bytes = (size_t)n * sizeof(double);
+    // 行数取step的倍数时面板字节数是4KB的整数倍
+    int step = 1;
+    while ((row_bytes * step) % STREAM_ALIGN != 0) step++;
+    size_t rows = panel_bytes / row_bytes / step * step;
+    if (rows < (size_t)step) rows = step;
+    if (rows > (size_t)n) rows = n;
+    return (int)rows;
+}
+
+// 写出与generate_data相同规律的n x n矩阵，逐行写出
+inline bool write_matrix_file(const char* path, int n) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) return false;
+    std::vector<double> row(n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            row[j] = ((size_t)i * n + j) % 10 + 1.0;
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), (size_t)n * sizeof(double));
+    }
+    return (bool)out;
+}
+
+// 对一个面板(若干完整的行)做行累加，4行一组，使结果向量每4行只读写一次
+inline void gemv_panel(const double* panel, int rows, int first_row, int n,
+                       const double* vector, double* result) {
+    int r = 0;
+    for (; r + 3 < rows; r += 4) {
+        const double* r0 = panel + (size_t)r * n;
+        const double* r1 = r0 + n;
+        const double* r2 = r1 + n;
+        const double* r3 = r2 + n;
+        double v0 = vector[first_row + r];
+        double v1 = vector[first_row + r + 1];
+        double v2 = vector[first_row + r + 2];
+        double v3 = vector[first_row + r + 3];
+        for (int j = 0; j < n; j++) {
+            result[j] += r0[j] * v0 + r1[j] * v1 + r2[j] * v2 + r3[j] * v3;
+        }
+    }
+    // 处理剩余行
+    for (; r < rows; r++) {
+        const double* row = panel + (size_t)r * n;
+        double vi = vector[first_row + r];
+        for (int j = 0; j < n; j++) {
+            result[j] += row[j] * vi;
+        }
+    }
+}
+
+// result = matrix^T * vector(与mulb相同)，矩阵从path流式读入；文件大小必须恰好为n x n个double，
+// 否则多出的行会越界读vector，不完整的行会被丢弃。panel_rows先按stream_panel_rows对齐：
+// stream_file把块大小向上取整到4KB，面板字节数不是4KB的整数倍时块边界会切开行
+inline StreamStats mul_stream(const char* path, int n, const double* vector, double* result,
+                              StreamIo io, int panel_rows) {
+    if (n <= 0 || file_size(path) != (size_t)n * n * sizeof(double)) {
+        StreamStats stats;
+        stats.error = "文件大小不是n x n个double";
+        return stats;
+    }
+    for (int j = 0; j < n; j++) {
+        result[j] = 0.0;
+    }
+    panel_rows = stream_panel_rows(n, (size_t)(panel_rows > 0 ? panel_rows : 1) * n * sizeof(double));
+    size_t panel_bytes = (size_t)panel_rows * n * sizeof(double);
+    return stream_file(path, io, panel_bytes, [&](const double* data, size_t count, size_t offset) {
+        gemv_panel(data, (int)(count / n), (int)(offset / n), n, vector, result);
+    });
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "cache_topology.h"
+#include "matrix.h"
+
+// 二维分块的Cache优化算法
+// mulb每处理一行矩阵都要完整扫一遍result[]，n较大时result[]与矩阵行争用L1。
+// 分块后按列块宽度只扫result的一段：该段在整个行块内常驻L1，
+// 行块(行块高度 x n)的大小不超过L2的一半，整个行块处理期间矩阵数据停留在L2中
+
+struct GemvTiling {
+    int tile_cols;   // 列块宽度(double个数)，result的一段常驻L1
+    int panel_rows;  // 行块高度，行块常驻L2
+};
+
+// 根据检测到的缓存大小计算分块参数
+// result段只占L1的1/4，其余留给正在流过的矩阵行、vector和硬件预取
+inline GemvTiling gemv_tiling_for(int n, const CacheTopology& topo) {
+    GemvTiling tiling;
+    int cols = (int)(topo.l1d / 4 / sizeof(double));
+    cols = cols / CACHE_LINE_DOUBLES * CACHE_LINE_DOUBLES;
+    if (cols < CACHE_LINE_DOUBLES) cols = CACHE_LINE_DOUBLES;
+    tiling.tile_cols = cols;
+
+    size_t row_bytes = (size_t)(n > 0 ? n : 1) * sizeof(double);
+    int rows = (int)(topo.l2 / 2 / row_bytes);
+    rows = rows / 4 * 4;
+    if (rows > n) rows = n;
+    if (rows < 4) rows = 4;
+    tiling.panel_rows = rows;
+    return tiling;
+}
+
+inline void mul_tiled(const Matrix& matrix, const double* vector, double* result, GemvTiling tiling) {
+    int n = matrix.n;
+    for (int j = 0; j < n; j++) {
+        result[j] = 0.0;
+    }
+
+    for (int ib = 0; ib < n; ib += tiling.panel_rows) {
+        int i_end = ib + tiling.panel_rows < n ? ib + tiling.panel_rows : n;
+        for (int jb = 0; jb < n; jb += tiling.tile_cols) {
+            int j_end = jb + tiling.tile_cols < n ? jb + tiling.tile_cols : n;
+
+            // 块内按4行展开，result段在4行之间保持在寄存器中
+            int i = ib;
+            for (; i + 3 < i_end; i += 4) {
+                double v0 = vector[i];
+                double v1 = vector[i+1];
+                double v2 = vector[i+2];
+                double v3 = vector[i+3];
+                const double* r0 = matrix.row(i);
+                const double* r1 = matrix.row(i+1);
+                const double* r2 = matrix.row(i+2);
+                const double* r3 = matrix.row(i+3);
+                for (int j = jb; j < j_end; j++) {
+                    result[j] += r0[j] * v0 + r1[j] * v1 + r2[j] * v2 + r3[j] * v3;
+                }
+            }
+
+            // 处理行块内剩余的行
+            for (; i < i_end; i++) {
+                double vi = vector[i];
+                const double* row = matrix.row(i);
+                for (int j = jb; j < j_end; j++) {
+                    result[j] += row[j] * vi;
+                }
+            }
+        }
+    }
+}
+
+// 使用本机缓存参数的分块算法
+inline void mul_tiled_auto(const Matrix& matrix, const double* vector, double* result) {
+    mul_tiled(matrix, vector, result, gemv_tiling_for(matrix.n, cache_topology()));
+}
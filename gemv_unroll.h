@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+
+// 编译期展开的行累加内核：每次取UNROLL行，result[j]一次加上UNROLL个乘积，
+// 乘积分给ACC条独立的加法链(第k行的乘积进入第k%ACC条链，链内从左到右相加，各链之和再相加)。
+// ACC=1时与手写的mulc/muld加法顺序完全相同；ACC>1时缩短每个result[j]的加法依赖链
+
+typedef void (*UnrolledGemvKernel)(const Matrix& matrix, const double* vector, double* result);
+
+// 第FIRST、FIRST+STRIDE...行的乘积从左到右相加
+template <size_t FIRST, size_t STRIDE, size_t... Ks>
+inline double strided_products(const double* const* rows, const double* v, int j, std::index_sequence<Ks...>) {
+    return (... + (rows[FIRST + Ks * STRIDE][j] * v[FIRST + Ks * STRIDE]));
+}
+
+template <int UNROLL, size_t... As>
+inline double chained_products(const double* const* rows, const double* v, int j, std::index_sequence<As...>) {
+    constexpr size_t ACC = sizeof...(As);
+    return (... + strided_products<As, ACC>(rows, v, j, std::make_index_sequence<UNROLL / ACC>()));
+}
+
+template <int UNROLL, int ACC>
+inline void gemv_unrolled(const Matrix& matrix, const double* vector, double* result) {
+    static_assert(UNROLL >= 1 && ACC >= 1 && UNROLL % ACC == 0, "展开路数必须是累加器个数的整数倍");
+    int n = matrix.n;
+    for (int j = 0; j < n; j++) {
+        result[j] = 0.0;
+    }
+
+    int i = 0;
+    for (; i + UNROLL - 1 < n; i += UNROLL) {
+        const double* rows[UNROLL];
+        double v[UNROLL];
+        for (int k = 0; k < UNROLL; k++) {
+            rows[k] = matrix.row(i + k);
+            v[k] = vector[i + k];
+        }
+        for (int j = 0; j < n; j++) {
+            result[j] += chained_products<UNROLL>(rows, v, j, std::make_index_sequence<ACC>());
+        }
+    }
+
+    // 处理剩余行
+    for (; i < n; i++) {
+        double vi = vector[i];
+        const double* row = matrix.row(i);
+        for (int j = 0; j < n; j++) {
+            result[j] += row[j] * vi;
+        }
+    }
+}
+
+// ---------------- 参数网格 ----------------
+
+struct UnrolledGemv {
+    int unroll;
+    int accumulators;
+    UnrolledGemvKernel kernel;
+};
+
+template <int UNROLL, int ACC>
+inline void add_gemv_config(std::vector<UnrolledGemv>& grid) {
+    if constexpr (UNROLL % ACC == 0) grid.push_back({UNROLL, ACC, gemv_unrolled<UNROLL, ACC>});
+}
+
+template <int UNROLL, int... ACCS>
+inline void add_gemv_configs(std::vector<UnrolledGemv>& grid) {
+    (add_gemv_config<UNROLL, ACCS>(grid), ...);
+}
+
+// 展开行数1/2/4/6/8/12/16与能整除它的累加链条数的全部组合，按展开行数、链条数排序
+inline const std::vector<UnrolledGemv>& gemv_unroll_grid() {
+    static const std::vector<UnrolledGemv> grid = [] {
+        std::vector<UnrolledGemv> g;
+        add_gemv_configs<1, 1>(g);
+        add_gemv_configs<2, 1, 2>(g);
+        add_gemv_configs<4, 1, 2, 4>(g);
+        add_gemv_configs<6, 1, 2, 3, 6>(g);
+        add_gemv_configs<8, 1, 2, 4, 8>(g);
+        add_gemv_configs<12, 1, 2, 3, 4, 6, 12>(g);
+        add_gemv_configs<16, 1, 2, 4, 8, 16>(g);
+        return g;
+    }();
+    return grid;
+}
@@ -69,7 +69,7 @@ def get_vibrant_colors():
 def jichu_sum(csv_file='jichu_sum.csv', chinese_font=None):
     """处理基础求和算法的CSV数据并生成可视化图像 - 针对2的幂次方数据优化"""
     # 读取CSV文件
-    df = pd.read_csv(csv_file)
+    df = pd.read_csv(csv_file, comment='#')
     
     # 获取鲜艳的颜色
     colors = get_vibrant_colors()
@@ -224,7 +224,7 @@ def jichu_sum(csv_file='jichu_sum.csv', chinese_font=None):
 def jinjie_sum(csv_file='jinjie_sum.csv', chinese_font=None):
     """处理进阶求和算法的CSV数据并生成可视化图像 - 针对2的幂次方数据优化"""
     # 读取CSV文件
-    df = pd.read_csv(csv_file)
+    df = pd.read_csv(csv_file, comment='#')
     
     # 获取鲜艳的颜色
     colors = get_vibrant_colors()
@@ -380,7 +380,7 @@ def jinjie_sum(csv_file='jinjie_sum.csv', chinese_font=None):
 def jichu_matrix(csv_file='jichu_matrix.csv', chinese_font=None):
     """处理基础矩阵算法的CSV数据并生成可视化图像 - 突出缓存临界点"""
     # 读取CSV文件
-    df = pd.read_csv(csv_file)
+    df = pd.read_csv(csv_file, comment='#')
     
     # 获取鲜艳的颜色
     colors = get_vibrant_colors()
@@ -508,7 +508,7 @@ def jichu_matrix(csv_file='jichu_matrix.csv', chinese_font=None):
 def jinjie_matrix(csv_file='jinjie_matrix.csv', chinese_font=None):
     """处理进阶矩阵算法的CSV数据并生成可视化图像 - 突出缓存临界点"""
     # 读取CSV文件
-    df = pd.read_csv(csv_file)
+    df = pd.read_csv(csv_file, comment='#')
     
     # 获取鲜艳的颜色
     colors = get_vibrant_colors()
@@ -634,6 +634,88 @@ def jinjie_matrix(csv_file='jinjie_matrix.csv', chinese_font=None):
     print("已保存图像到 jinjie_matrix.jpg")
     plt.close()
     
+def read_roofline_peaks(csv_file):
+    """读取屋顶线CSV开头的'# 峰值'注释行，返回(浮点峰值GFLOP/s, 指令集, [(层次, 读带宽GB/s), ...])"""
+    gflops, simd, levels = None, '', []
+    with open(csv_file, encoding='utf-8') as f:
+        for line in f:
+            if not line.startswith('#'):
+                break
+            fields = line[1:].strip().split(',')
+            if len(fields) < 3 or fields[0] != '峰值':
+                continue
+            if fields[1] == '浮点':
+                gflops, simd = float(fields[2]), fields[3] if len(fields) > 3 else ''
+            else:
+                levels.append((fields[1], float(fields[2])))
+    return gflops, simd, levels
+
+def wudingxian(csv_file='jichu_sum_wudingxian.csv', chinese_font=None):
+    """根据屋顶线CSV画屋顶线图(左)和各算法屋顶线占比随规模的变化(右)"""
+    gflops, simd, levels = read_roofline_peaks(csv_file)
+    df = pd.read_csv(csv_file, comment='#')
+    if gflops is None or df.empty:
+        print("屋顶线数据为空:", csv_file)
+        return
+
+    # 展开参数网格中的配置(如"4x2")太多，每个规模只保留最快的一个，记为"最优展开"
+    grid = df['算法'].astype(str).str.match(r'^\d+x\d+$')
+    best = df[grid].loc[df[grid].groupby(['测试', '规模'])['GFLOP/s'].idxmax()].copy()
+    best['算法'] = '最优展开'
+    df = pd.concat([df[~grid], best], ignore_index=True)
+
+    colors = list(get_vibrant_colors().values())
+    level_markers = {'L1': 'o', 'L2': 's', 'L3': '^', '内存': 'D'}
+    fig, (ax_roof, ax_ratio) = plt.subplots(1, 2, figsize=(18, 8))
+
+    # 屋顶：每一层一条 min(峰值, 强度*带宽) 折线
+    intensity = np.logspace(-3, 3, 200)
+    for k, (level, bandwidth) in enumerate(levels):
+        ax_roof.plot(intensity, np.minimum(gflops, intensity * bandwidth), linestyle='--', linewidth=1.5,
+                     color='gray', alpha=0.4 + 0.15 * k)
+        ax_roof.text(intensity[0] * 1.2, intensity[0] * 1.2 * bandwidth, f'{level} {bandwidth:.1f} GB/s',
+                     fontproperties=chinese_font, fontsize=9, va='bottom', color='dimgray')
+    ax_roof.axhline(gflops, color='black', linewidth=2, alpha=0.7)
+    ax_roof.text(intensity[-1], gflops * 1.05, f'{simd}峰值 {gflops:.1f} GFLOP/s', fontproperties=chinese_font,
+                 fontsize=10, ha='right', va='bottom')
+
+    for k, kernel in enumerate(df['算法'].unique()):
+        rows = df[df['算法'] == kernel]
+        color = colors[k % len(colors)]
+        for level, marker in level_markers.items():
+            points = rows[rows['所在层次'] == level]
+            if points.empty:
+                continue
+            ax_roof.scatter(points['运算强度(FLOP/B)'], points['GFLOP/s'], s=40, marker=marker, color=color,
+                            edgecolors='white', linewidth=0.5, alpha=0.8, zorder=3)
+        ax_roof.scatter([], [], s=40, color=color, label=kernel)
+        rows = rows.sort_values('规模')
+        ax_ratio.plot(rows['规模'], rows['屋顶线占比(%)'], label=kernel, color=color, linewidth=2, alpha=0.9)
+    for level, marker in level_markers.items():
+        ax_roof.scatter([], [], s=40, marker=marker, color='gray', label=level)
+
+    ax_roof.set_xscale('log')
+    ax_roof.set_yscale('log')
+    ax_roof.set_xlim(intensity[0], intensity[-1])
+    ax_roof.set_title('屋顶线模型', fontproperties=chinese_font, fontsize=16, fontweight='bold')
+    ax_roof.set_xlabel('运算强度(FLOP/字节)', fontproperties=chinese_font, fontsize=13)
+    ax_roof.set_ylabel('GFLOP/s', fontproperties=chinese_font, fontsize=13)
+    ax_ratio.set_xscale('log', base=2)
+    ax_ratio.set_title('屋顶线占比随规模变化', fontproperties=chinese_font, fontsize=16, fontweight='bold')
+    ax_ratio.set_xlabel('规模', fontproperties=chinese_font, fontsize=13)
+    ax_ratio.set_ylabel('屋顶线占比(%)', fontproperties=chinese_font, fontsize=13)
+    for ax in (ax_roof, ax_ratio):
+        legend = ax.legend(fontsize=10, framealpha=0.9, loc='best')
+        for text in legend.get_texts():
+            text.set_fontproperties(chinese_font)
+        ax.grid(True, alpha=0.5)
+
+    image_file = os.path.splitext(csv_file)[0] + '.jpg'
+    plt.tight_layout()
+    plt.savefig(image_file, dpi=300, bbox_inches='tight')
+    print("已保存图像到", image_file)
+    plt.close()
+
 def process_all_csv():
     """处理所有4个CSV文件并生成对应的可视化图像"""
     # 设置图表样式和获取中文字体
@@ -652,6 +734,13 @@ def process_all_csv():
         else:
             print("文件不存在:", csv_file)
 
+    # basic/advanced模式同时输出的屋顶线数据
+    for csv_file in csv_files:
+        roofline_file = os.path.splitext(csv_file)[0] + '_wudingxian.csv'
+        if os.path.exists(roofline_file):
+            print("处理文件:", roofline_file)
+            wudingxian(roofline_file, chinese_font)
+
 if __name__ == "__main__":
     print("开始生成可视化图像...")
     process_all_csv()
@@ -31,7 +31,7 @@ def smooth_curve(x, y):
 
 
 def jichu_matrix():
-    df = pd.read_csv('jichu_matrix.csv')
+    df = pd.read_csv('jichu_matrix.csv', comment='#')
     df = df[df['矩阵大小'] <= 5000]
 
     plt.figure(figsize=(12, 8))
@@ -56,7 +56,7 @@ def jichu_matrix():
 
 
 def jichu_sum():
-    df = pd.read_csv('jichu_sum.csv')
+    df = pd.read_csv('jichu_sum.csv', comment='#')
     plt.figure(figsize=(12, 8))
     set_plot_style()
 
@@ -81,14 +81,15 @@ def jichu_sum():
 
 
 def jinjie_matrix():
-    df = pd.read_csv('jinjie_matrix.csv')
+    df = pd.read_csv('jinjie_matrix.csv', comment='#')
     plt.figure(figsize=(12, 8))
     set_plot_style()
 
-    colors = ['#2C3E50', '#E74C3C', '#27AE60']
+    colors = ['#2C3E50', '#E74C3C', '#27AE60', '#8E44AD']
     for (col, color, label) in [('平凡算法(秒)', colors[0], '平凡算法'),
                                ('4路展开(秒)', colors[1], '4路展开'),
-                               ('8路展开(秒)', colors[2], '8路展开')]:
+                               ('8路展开(秒)', colors[2], '8路展开'),
+                               ('最优展开(秒)', colors[3], '最优展开配置')]:
         x_smooth, y_smooth = smooth_curve(df['矩阵大小'], df[col])
         plt.plot(x_smooth, y_smooth, color=color, linewidth=3, label=label)
         plt.scatter(df['矩阵大小'], df[col], color=color, s=60, alpha=0.6, edgecolor='white')
@@ -104,14 +105,15 @@ def jinjie_matrix():
 
 
 def jinjie_sum():
-    df = pd.read_csv('jinjie_sum.csv')
+    df = pd.read_csv('jinjie_sum.csv', comment='#')
     plt.figure(figsize=(12, 8))
     set_plot_style()
 
-    colors = ['#2C3E50', '#E74C3C', '#27AE60']
+    colors = ['#2C3E50', '#E74C3C', '#27AE60', '#8E44AD']
     for (col, color, label) in [('平凡算法(秒)', colors[0], '平凡算法'),
                                ('4路展开(秒)', colors[1], '4路展开'),
-                               ('8路展开(秒)', colors[2], '8路展开')]:
+                               ('8路展开(秒)', colors[2], '8路展开'),
+                               ('最优展开(秒)', colors[3], '最优展开配置')]:
         x_smooth, y_smooth = smooth_curve(df['数组大小'], df[col])
         plt.plot(x_smooth, y_smooth, color=color, linewidth=3, label=label)
         plt.scatter(df['数组大小'], df[col], color=color, s=60, alpha=0.6, edgecolor='white')
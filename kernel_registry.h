@@ -0,0 +1,395 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+#include "cli_options.h"
+#include "matrix.h"
+#include "roofline.h"
+#include "thread_pool.h"
+
+// 内核注册表与按命令行选择的测试驱动(run模式)
+// 每个程序把自己的内核登记为KernelEntry(名称、统一签名的调用、参考内核、工作量模型)，
+// run_registry按 --kernels/--sizes/--threads/--runs/--out 只测选中的内核和规模，
+// 新内核只需登记一行，不必再复制一份test_*函数
+
+enum KernelKind {
+    KERNEL_SUM,   // 对n个double求和
+    KERNEL_GEMV   // n x n矩阵乘向量
+};
+
+// 一次调用的全部输入输出，由驱动按规模和线程数准备
+struct KernelArgs {
+    int n = 0;
+    const double* arr = nullptr;     // 求和的输入
+    double* work = nullptr;          // arr的可写副本，原地修改输入的内核使用；前缀和内核把输出写在这里
+    const Matrix* matrix = nullptr;  // GEMV的输入
+    const double* vector = nullptr;
+    double* result = nullptr;        // GEMV的输出(n个double)
+    ThreadPool* pool = nullptr;      // 多线程内核使用，线程数为pool->size()
+    void* scratch = nullptr;         // 内核要求的临时缓冲区(64字节对齐)，大小见KernelEntry::scratch_bytes
+};
+
+// 统一签名：求和内核返回和，GEMV内核写args.result并返回0
+typedef std::function<double(const KernelArgs& args)> RegistryKernel;
+
+struct KernelEntry {
+    std::string name;
+    std::string description;
+    RegistryKernel call;
+    bool threaded = false;                          // 使用args.pool，按--threads中的每个线程数各测一次
+    bool in_place = false;                          // 原地修改args.work，每个样本前(不计时)从arr恢复
+    size_t (*scratch_bytes)(int n, int threads) = nullptr;
+    RooflineWork (*work)(long long n) = nullptr;    // 为空时按注册表的种类取sum_work/gemv_work
+    double tolerance = 1e-10;                       // 与参考内核结果的最大绝对误差
+};
+
+struct KernelRegistry {
+    KernelKind kind = KERNEL_SUM;
+    const char* default_output = nullptr;           // --out未给出时的输出文件
+    std::vector<KernelEntry> kernels;               // kernels[0]为参考内核，所有结果都与它比较
+    void (*fill_array)(double* arr, int n) = nullptr;
+    void (*fill_matrix)(Matrix& matrix, double* vector) = nullptr;
+
+    void add(const KernelEntry& entry) { kernels.push_back(entry); }
+
+    const KernelEntry* find(const std::string& name) const {
+        for (const KernelEntry& entry : kernels) {
+            if (entry.name == name) return &entry;
+        }
+        return nullptr;
+    }
+};
+
+// ---------------- 命令行解析 ----------------
+
+inline std::vector<std::string> split_list(const char* text) {
+    std::vector<std::string> items;
+    std::string item;
+    for (const char* p = text; ; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) items.push_back(item);
+            item.clear();
+            if (*p == '\0') break;
+        } else {
+            item += *p;
+        }
+    }
+    return items;
+}
+
+// 规模列表：逗号分隔的单个规模或区间 lo:hi[:step]，step为加法步长，写成x2表示每次乘2；
+// 如 "1000,2000"、"128:4096:x2"、"500:1500:100"。解析失败返回false
+inline bool parse_size_list(const char* text, std::vector<int>& sizes) {
+    for (const std::string& item : split_list(text)) {
+        long long lo = 0, hi = 0;
+        char step_text[32] = "";
+        int fields = sscanf(item.c_str(), "%lld:%lld:%31s", &lo, &hi, step_text);
+        if (fields == 1) {
+            hi = lo;
+        } else if (fields < 1) {
+            return false;
+        }
+        if (lo < 1 || hi < lo || hi > 0x7fffffff) return false;
+        bool geometric = step_text[0] == 'x';
+        double step = fields == 3 ? atof(step_text + (geometric ? 1 : 0)) : 1.0;
+        if (fields == 3 && (geometric ? step <= 1.0 : step < 1.0)) return false;
+        for (double n = (double)lo; n <= (double)hi; n = geometric ? std::ceil(n * step) : n + step) {
+            sizes.push_back((int)n);
+        }
+    }
+    sort_unique(sizes);
+    return !sizes.empty();
+}
+
+inline void print_registry(const KernelRegistry& registry) {
+    std::cout << "可选内核(第一个为参考内核):" << std::endl;
+    for (const KernelEntry& entry : registry.kernels) {
+        std::cout << "  " << entry.name << "\t" << entry.description;
+        if (entry.threaded) std::cout << " [多线程]";
+        std::cout << std::endl;
+    }
+}
+
+// ---------------- 驱动 ----------------
+
+// 为一个规模准备的数据，所有内核共用
+struct RegistryData {
+    int n = 0;
+    double* arr = nullptr;
+    double* work = nullptr;
+    Matrix matrix;
+    double* vector = nullptr;
+    double* result = nullptr;
+    double* expected = nullptr;  // 参考内核的GEMV结果
+    double expected_sum = 0.0;   // 参考内核的和
+};
+
+// 按命令行运行注册表中选中的内核，返回进程退出码
+// 选项: --kernels=名称,... (默认全部)  --sizes=规模列表(默认default_sizes)  --threads=线程数,...
+//       --runs=N(固定样本数，见bench_options_from_cli)  --pages=4k,thp,2m,1g  --out=CSV路径  --roofline=0  --list
+inline int run_registry(const KernelRegistry& registry, const std::vector<int>& default_sizes, int argc,
+                        char** argv) {
+    if (has_mode(argc, argv, "--list")) {
+        print_registry(registry);
+        return 0;
+    }
+
+    std::vector<const KernelEntry*> selected;
+    const char* kernel_list = get_option(argc, argv, "kernels", nullptr);
+    if (kernel_list == nullptr) {
+        for (const KernelEntry& entry : registry.kernels) selected.push_back(&entry);
+    } else {
+        for (const std::string& name : split_list(kernel_list)) {
+            const KernelEntry* entry = registry.find(name);
+            if (entry == nullptr) {
+                std::cout << "未知内核: " << name << std::endl;
+                print_registry(registry);
+                return 1;
+            }
+            selected.push_back(entry);
+        }
+    }
+
+    // 参考内核排在最前面，其他内核的加速比都相对它计算
+    for (size_t k = 1; k < selected.size(); k++) {
+        if (selected[k] == &registry.kernels[0]) {
+            selected.erase(selected.begin() + k);
+            selected.insert(selected.begin(), &registry.kernels[0]);
+            break;
+        }
+    }
+
+    std::vector<int> sizes;
+    const char* size_list = get_option(argc, argv, "sizes", nullptr);
+    if (size_list == nullptr) {
+        sizes = default_sizes;
+    } else if (!parse_size_list(size_list, sizes)) {
+        std::cout << "无法解析规模列表: " << size_list << " (示例: 1000,2000 或 128:4096:x2 或 500:1500:100)"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<int> thread_counts;
+    const char* thread_list = get_option(argc, argv, "threads", nullptr);
+    if (thread_list == nullptr) {
+        thread_counts.push_back((int)allowed_cpus().size());
+    } else {
+        for (const std::string& item : split_list(thread_list)) {
+            int threads = atoi(item.c_str());
+            if (threads >= 1) thread_counts.push_back(threads);
+        }
+        sort_unique(thread_counts);
+        if (thread_counts.empty()) thread_counts.push_back(1);
+    }
+
+    // --pages可给出列表(如4k,2m)，同一组内核和规模在每种页面上各测一遍，直接对比页面大小的影响
+    std::vector<PageBacking> page_list;
+    for (const std::string& item : split_list(get_option(argc, argv, "pages", "2m"))) {
+        PageBacking backing;
+        if (!parse_page_backing(item.c_str(), backing)) {
+            std::cout << "无法识别的页面: " << item << " (可选 4k, thp, 2m, 1g)" << std::endl;
+            return 1;
+        }
+        page_list.push_back(backing);
+    }
+
+    const char* output_file = get_option(argc, argv, "out", registry.default_output);
+    MatrixLayout layout = strcmp(get_option(argc, argv, "layout", "contiguous"), "legacy") == 0
+                              ? LAYOUT_LEGACY : LAYOUT_CONTIGUOUS;
+    BenchOptions options = bench_options_from_cli(argc, argv);
+    bool with_roofline = atoi(get_option(argc, argv, "roofline", "1")) != 0;
+
+    std::ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        std::cout << "无法创建文件: " << output_file << std::endl;
+        return 1;
+    }
+    BenchReport report(options);
+    RooflineReport* roofline = with_roofline ? new RooflineReport(options) : nullptr;
+
+    // 每个线程数一个线程池，只在选中了多线程内核时创建
+    std::vector<ThreadPool*> pools;
+    for (const KernelEntry* entry : selected) {
+        if (!entry->threaded) continue;
+        for (int threads : thread_counts) pools.push_back(new ThreadPool(threads));
+        break;
+    }
+
+    write_topology_header(out_file);
+    out_file << "算法,规模,线程数,页面,时间(秒),加速比,带宽(GB/s),GFLOP/s,屋顶线占比(%),结果正确性";
+    write_bench_csv_header(out_file, "");
+    write_perf_csv_header(out_file, "");
+    out_file << std::endl;
+
+    std::cout << "\n按命令行选择的测试: " << selected.size() << "个内核, " << sizes.size() << "个规模";
+    if (!pools.empty()) {
+        std::cout << ", 线程数";
+        for (int threads : thread_counts) std::cout << " " << threads;
+    }
+    std::cout << std::endl;
+    std::cout << "计时: " << bench_options_summary(options) << std::endl;
+    if (roofline != nullptr) std::cout << "屋顶线: " << machine_peaks_summary(roofline->peaks()) << std::endl;
+    std::cout << "算法\t规模\t线程数\t页面\t时间(秒)\t加速比\tGB/s\tGFLOP/s\t屋顶线占比\t结果正确性" << std::endl;
+
+    const KernelEntry& reference = registry.kernels[0];
+    // 数据缓冲区从内存池中分配：每种页面一个内存池，按最大规模一次预留并预先触摸
+    int max_n = 0;
+    for (int n : sizes) {
+        if (n > max_n) max_n = n;
+    }
+    size_t capacity = registry.kind == KERNEL_SUM
+                          ? 2 * arena_array_bytes(max_n)
+                          : arena_matrix_bytes(max_n) + 3 * arena_array_bytes(max_n);
+    for (PageBacking pages : page_list) {
+        BufferArena arena(capacity, pages);
+        const char* page_name = page_backing_name(arena.backing());
+        std::cout << "内存池: " << arena.summary() << std::endl;
+        out_file << "# 内存池: " << arena.summary() << std::endl;
+        for (int n : sizes) {
+            // 准备数据并计算参考结果
+            RegistryData data;
+            data.n = n;
+            if (registry.kind == KERNEL_SUM) {
+                arena.reset();
+                data.arr = arena.alloc(n);
+                data.work = arena.alloc(n);
+                registry.fill_array(data.arr, n);
+                memcpy(data.work, data.arr, n * sizeof(double));
+            } else {
+                arena.reset();
+                data.matrix = alloc_matrix(arena, n, layout);
+                data.vector = arena.alloc(n);
+                data.result = arena.alloc(n);
+                data.expected = arena.alloc(n);
+                registry.fill_matrix(data.matrix, data.vector);
+            }
+            KernelArgs args;
+            args.n = n;
+            args.arr = data.arr;
+            args.work = data.work;
+            args.matrix = &data.matrix;
+            args.vector = data.vector;
+            args.result = data.result;
+            data.expected_sum = reference.call(args);
+            if (registry.kind == KERNEL_GEMV) memcpy(data.expected, data.result, n * sizeof(double));
+
+            double reference_time = 0.0;
+            for (const KernelEntry* entry : selected) {
+                std::vector<ThreadPool*> entry_pools;
+                if (entry->threaded) entry_pools = pools;
+                else entry_pools.push_back(nullptr);
+
+                for (ThreadPool* pool : entry_pools) {
+                    int threads = pool != nullptr ? pool->size() : 1;
+                    // 临时缓冲区按缓存行对齐(线程私有的部分和各占一行，避免伪共享)
+                    size_t scratch_bytes = entry->scratch_bytes != nullptr ? entry->scratch_bytes(n, threads) : 0;
+                    scratch_bytes = (scratch_bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+                    args.pool = pool;
+                    args.scratch = scratch_bytes > 0 ? aligned_alloc(CACHE_LINE, scratch_bytes) : nullptr;
+
+                    // 正确性：和与参考内核比较，GEMV逐元素比较
+                    if (entry->in_place) memcpy(data.work, data.arr, n * sizeof(double));
+                    double value = entry->call(args);
+                    bool correct = true;
+                    if (registry.kind == KERNEL_SUM) {
+                        correct = std::fabs(value - data.expected_sum) <= entry->tolerance;
+                    } else {
+                        for (int j = 0; j < n && correct; j++) {
+                            correct = std::fabs(data.result[j] - data.expected[j]) <= entry->tolerance;
+                        }
+                    }
+
+                    volatile double sink = 0.0;
+                    BenchStats stats;
+                    if (entry->in_place) {
+                        stats = bench_run([&] { sink = entry->call(args); },
+                                          [&] { memcpy(data.work, data.arr, n * sizeof(double)); }, true, options);
+                    } else {
+                        stats = bench_run([&] { sink = entry->call(args); }, options);
+                    }
+                    if (entry == &reference) reference_time = stats.median;
+
+                    std::string name = entry->name;
+                    if (entry->threaded) name += "@" + std::to_string(threads);
+                    if (page_list.size() > 1) name += "/" + std::string(page_name);
+                    RooflineWork work = entry->work != nullptr ? entry->work(n)
+                                        : registry.kind == KERNEL_SUM ? sum_work(n) : gemv_work(n);
+                    report.add("run", name.c_str(), n, stats);
+                    double percent = -1.0;
+                    if (roofline != nullptr) {
+                        roofline->add("run", name.c_str(), n, work, stats.median);
+                        percent = roofline_percent(roofline->peaks(), work, stats.median);
+                    }
+
+                    char buffer[256];
+                    snprintf(buffer, sizeof(buffer), "%s,%d,%d,%s,%.6e,", entry->name.c_str(), n, threads, page_name,
+                             stats.median);
+                    out_file << buffer;
+                    if (reference_time > 0) {
+                        snprintf(buffer, sizeof(buffer), "%.3f", reference_time / stats.median);
+                        out_file << buffer;
+                    }
+                    snprintf(buffer, sizeof(buffer), ",%.3f,%.3f,", work.bytes / stats.median / 1e9,
+                             work.flops / stats.median / 1e9);
+                    out_file << buffer;
+                    if (percent >= 0) {
+                        snprintf(buffer, sizeof(buffer), "%.2f", percent);
+                        out_file << buffer;
+                    }
+                    out_file << "," << (correct ? "正确" : "错误");
+                    write_bench_csv(out_file, stats);
+                    write_perf_csv(out_file, stats.counters, registry.kind == KERNEL_SUM ? (double)n : (double)n * n);
+                    out_file << std::endl;
+
+                    snprintf(buffer, sizeof(buffer), "%s\t%d\t%d\t%s\t%.3e\t", entry->name.c_str(), n, threads, page_name,
+                             stats.median);
+                    std::cout << buffer;
+                    if (reference_time > 0) {
+                        snprintf(buffer, sizeof(buffer), "%.2fx", reference_time / stats.median);
+                        std::cout << buffer;
+                    } else {
+                        std::cout << "-";
+                    }
+                    snprintf(buffer, sizeof(buffer), "\t%.2f\t%.3f\t", work.bytes / stats.median / 1e9,
+                             work.flops / stats.median / 1e9);
+                    std::cout << buffer;
+                    if (percent >= 0) {
+                        snprintf(buffer, sizeof(buffer), "%.1f%%", percent);
+                        std::cout << buffer;
+                    } else {
+                        std::cout << "-";
+                    }
+                    std::cout << "\t\t" << (correct ? "正确" : "错误") << std::endl;
+                    free(args.scratch);
+                }
+            }
+
+            // 旧布局的矩阵不在内存池中，单独释放
+            if (registry.kind == KERNEL_GEMV) free_matrix(data.matrix);
+        }
+    }
+    for (ThreadPool* pool : pools) delete pool;
+
+    report.write_csv_note(out_file);
+    out_file.close();
+    std::string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    std::cout << "测试结果已保存到: " << output_file << ", " << json_file;
+    if (roofline != nullptr) {
+        std::string roofline_file = roofline_path_for(output_file);
+        roofline->write_csv(roofline_file.c_str());
+        std::cout << ", " << roofline_file;
+        delete roofline;
+    }
+    std::cout << std::endl;
+    return 0;
+}
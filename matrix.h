@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// 矩阵存储布局
+enum MatrixLayout {
+    LAYOUT_CONTIGUOUS,  // 单块64字节对齐、按行连续存储，行距经过填充
+    LAYOUT_LEGACY       // 原始布局：行指针数组 + 每行单独new
+};
+
+inline const char* layout_name(MatrixLayout layout) {
+    return layout == LAYOUT_LEGACY ? "legacy" : "contiguous";
+}
+
+// 稠密方阵，按行存储
+// 连续布局下第i行起始于 data + i*ld，ld按缓存行(8个double)对齐，
+// 并避开4KB整数倍的行距，防止相邻行在L1中发生4K别名冲突
+struct Matrix {
+    int n = 0;                          // 行数=列数
+    int ld = 0;                         // 行距(leading dimension)，单位为double
+    MatrixLayout layout = LAYOUT_CONTIGUOUS;
+    double* data = nullptr;             // 连续布局的数据块
+    double** rows = nullptr;            // 旧布局的行指针
+    bool external = false;              // 数据来自BufferArena等外部内存，free_matrix不释放
+
+    double* row(int i) {
+        return layout == LAYOUT_LEGACY ? rows[i] : data + (size_t)i * ld;
+    }
+    const double* row(int i) const {
+        return layout == LAYOUT_LEGACY ? rows[i] : data + (size_t)i * ld;
+    }
+};
+
+const size_t CACHE_LINE = 64;
+const int CACHE_LINE_DOUBLES = CACHE_LINE / sizeof(double);
+
+// 计算填充后的行距
+inline int padded_ld(int n) {
+    int ld = (n + CACHE_LINE_DOUBLES - 1) / CACHE_LINE_DOUBLES * CACHE_LINE_DOUBLES;
+    if (ld == 0) ld = CACHE_LINE_DOUBLES;
+    // 行距为4KB整数倍时，各行同一列落在同一组L1组上，额外填充一个缓存行
+    if ((ld * sizeof(double)) % 4096 == 0) ld += CACHE_LINE_DOUBLES;
+    return ld;
+}
+
+// 分配64字节对齐的double数组，大小向上取整到缓存行
+inline double* alloc_aligned(size_t count) {
+    size_t bytes = (count * sizeof(double) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    if (bytes == 0) bytes = CACHE_LINE;
+    void* p = aligned_alloc(CACHE_LINE, bytes);
+    if (p == nullptr) throw std::bad_alloc();
+    return static_cast<double*>(p);
+}
+
+inline void free_aligned(double* p) {
+    free(p);
+}
+
+inline Matrix alloc_matrix(int n, MatrixLayout layout) {
+    Matrix m;
+    m.n = n;
+    m.layout = layout;
+    if (layout == LAYOUT_LEGACY) {
+        m.ld = n;
+        m.rows = new double*[n];
+        for (int i = 0; i < n; i++) {
+            m.rows[i] = new double[n];
+        }
+    } else {
+        m.ld = padded_ld(n);
+        m.data = alloc_aligned((size_t)n * m.ld);
+        // 填充部分清零，便于整行向量化处理
+        memset(m.data, 0, (size_t)n * m.ld * sizeof(double));
+    }
+    return m;
+}
+
+inline void free_matrix(Matrix& m) {
+    if (m.layout == LAYOUT_LEGACY) {
+        for (int i = 0; i < m.n; i++) {
+            delete[] m.rows[i];
+        }
+        delete[] m.rows;
+    } else if (!m.external) {
+        free_aligned(m.data);
+    }
+    m.rows = nullptr;
+    m.data = nullptr;
+    m.n = m.ld = 0;
+}
@@ -6,39 +6,57 @@
 #include <iomanip>
 #include <cmath>
 #include <vector>
+#include <cstring>
+#include <csignal>
+#include <thread>
 
-using namespace std;
+#include "cli_options.h"
+#include "matrix.h"
+#include "gemv_parallel.h"
+#include "gemv_simd.h"
+#include "gemv_tiled.h"
+#include "gemv_batch.h"
+#include "gemv_sparse.h"
+#include "gemv_stream.h"
+#include "gemv_mixed.h"
+#include "gemv_unroll.h"
+#include "bench_harness.h"
+#include "roofline.h"
+#include "kernel_registry.h"
+#include "gemv_server.h"
+#include "gemv_incremental.h"
+#include "gemv_fused.h"
 
-// 高精度计时函数
-double get_time() {
-    return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(
-        chrono::high_resolution_clock::now().time_since_epoch()).count()) / 1.0e9;
-}
+using namespace std;
 
 // 生成随机矩阵和向量
-void generate_data(double** matrix, double* vector, int n) {
+void generate_data(Matrix& matrix, double* vector) {
+    int n = matrix.n;
     for (int i = 0; i < n; i++) {
+        double* row = matrix.row(i);
         for (int j = 0; j < n; j++) {
             // 使用固定值便于验证正确性
-            matrix[i][j] = (i * n + j) % 10 + 1.0;
+            row[j] = (i * n + j) % 10 + 1.0;
         }
         vector[i] = i % 5 + 1.0;
     }
 }
 
 // 方法a: 逐列访问元素的平凡算法
-void mula(double** matrix, double* vector, double* result, int n) {
+void mula(const Matrix& matrix, const double* vector, double* result) {
+    int n = matrix.n;
     for (int j = 0; j < n; j++) {  // 遍历每一列
         double sum = 0.0;
         for (int i = 0; i < n; i++) {  // 计算内积
-            sum += matrix[i][j] * vector[i];
+            sum += matrix.row(i)[j] * vector[i];
         }
         result[j] = sum;
     }
 }
 
 // 方法b: cache优化算法
-void mulb(double** matrix, double* vector, double* result, int n) {
+void mulb(const Matrix& matrix, const double* vector, double* result) {
+    int n = matrix.n;
     // 初始化结果数组
     for (int j = 0; j < n; j++) {
         result[j] = 0.0;
@@ -47,404 +65,2128 @@ void mulb(double** matrix, double* vector, double* result, int n) {
     // 按行访问矩阵元素，利用空间局部性
     for (int i = 0; i < n; i++) {
         double vi = vector[i];  // 减少内存访问
+        const double* row = matrix.row(i);
         for (int j = 0; j < n; j++) {
-            result[j] += matrix[i][j] * vi;
+            result[j] += row[j] * vi;
         }
     }
 }
 
-// 方法c: 4路循环展开
-void mulc(double** matrix, double* vector, double* result, int n) {
-    // 初始化结果数组
-    for (int j = 0; j < n; j++) {
-        result[j] = 0.0;
-    }
-    
-    // 按行访问矩阵元素，利用空间局部性，同时展开循环
-    int i = 0;
-    for (; i < n-3; i += 4) {
-        double v0 = vector[i];
-        double v1 = vector[i+1];
-        double v2 = vector[i+2];
-        double v3 = vector[i+3];
-        
-        for (int j = 0; j < n; j++) {
-            result[j] += matrix[i][j] * v0 +
-                         matrix[i+1][j] * v1 +
-                         matrix[i+2][j] * v2 +
-                         matrix[i+3][j] * v3;
-        }
-    }
-    
-    // 处理剩余元素
-    for (; i < n; i++) {
-        double vi = vector[i];
-        for (int j = 0; j < n; j++) {
-            result[j] += matrix[i][j] * vi;
-        }
-    }
+// 方法c: 4路循环展开，由编译期展开的模板内核生成(单条加法链，加法顺序与手写版本相同)
+void mulc(const Matrix& matrix, const double* vector, double* result) {
+    gemv_unrolled<4, 1>(matrix, vector, result);
 }
 
 // 方法d: 8路循环展开
-void muld(double** matrix, double* vector, double* result, int n) {
-    // 初始化结果数组
+void muld(const Matrix& matrix, const double* vector, double* result) {
+    gemv_unrolled<8, 1>(matrix, vector, result);
+}
+
+typedef void (*MatVecKernel)(const Matrix& matrix, const double* vector, double* result);
+
+bool results_match(const double* expected, const double* actual, int n) {
     for (int j = 0; j < n; j++) {
-        result[j] = 0.0;
-    }
-    
-    // 按行访问矩阵元素，利用空间局部性，同时展开循环
-    int i = 0;
-    for (; i < n-7; i += 8) {
-        double v0 = vector[i];
-        double v1 = vector[i+1];
-        double v2 = vector[i+2];
-        double v3 = vector[i+3];
-        double v4 = vector[i+4];
-        double v5 = vector[i+5];
-        double v6 = vector[i+6];
-        double v7 = vector[i+7];
-        
-        for (int j = 0; j < n; j++) {
-            result[j] += matrix[i][j] * v0 +
-                         matrix[i+1][j] * v1 +
-                         matrix[i+2][j] * v2 +
-                         matrix[i+3][j] * v3 +
-                         matrix[i+4][j] * v4 +
-                         matrix[i+5][j] * v5 +
-                         matrix[i+6][j] * v6 +
-                         matrix[i+7][j] * v7;
-        }
-    }
-    
-    // 处理剩余元素
-    for (; i < n; i++) {
-        double vi = vector[i];
-        for (int j = 0; j < n; j++) {
-            result[j] += matrix[i][j] * vi;
+        if (abs(expected[j] - actual[j]) > 1e-10) {
+            return false;
         }
     }
+    return true;
 }
 
 // 测试基础矩阵乘法：平凡算法与Cache优化对比
-void test_basic_mul(int* sizes, int* test_counts, int sizes_count, const char* output_file) {
+// 用bench_run计时(预热、自适应重复、扣除计时开销)，时间列为单次调用的中位数，
+// 每个算法另有最小值/均值/分位数/标准差等统计列，完整统计同时写入同名的JSON文件
+void test_basic_mul(int* sizes, int sizes_count, const char* output_file, MatrixLayout layout,
+                    const BenchOptions& options) {
     ofstream out_file(output_file);
     if (!out_file.is_open()) {
         cout << "无法创建文件: " << output_file << endl;
         return;
     }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    // 矩阵(连续布局)、输入向量和两个结果向量都从内存池中分配，容量按最大规模一次预留
+    int max_n = 0;
+    for (int i = 0; i < sizes_count; i++) {
+        if (sizes[i] > max_n) max_n = sizes[i];
+    }
+    BufferArena arena(arena_matrix_bytes(max_n) + 3 * arena_array_bytes(max_n), options.pages);
     
     // 写入CSV文件头
-    out_file << "矩阵大小,平凡算法(秒),Cache优化(秒),加速比,结果正确性" << endl;
+    write_topology_header(out_file);
+    out_file << "# 内存池: " << arena.summary() << endl;
+    out_file << "矩阵大小,平凡算法(秒),Cache优化(秒),加速比,结果正确性,存储布局";
+    write_bench_csv_header(out_file, "平凡算法");
+    write_bench_csv_header(out_file, "Cache优化");
+    write_perf_csv_header(out_file, "平凡算法");
+    write_perf_csv_header(out_file, "Cache优化");
+    out_file << endl;
     
     // 控制台表头
-    cout << "\n基础矩阵乘法算法性能比较:" << endl;
-    cout << "规模\t平凡算法(秒)\tCache优化(秒)\t加速比\t结果正确性" << endl;
-    cout << "------\t-----------\t-----------\t------\t----------" << endl;
+    cout << "\n基础矩阵乘法算法性能比较 (" << layout_name(layout) << "布局, 单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "内存池: " << arena.summary() << endl;
+    cout << "规模\t平凡算法(秒)\tCache优化(秒)\t加速比\t置信区间\t\t结果正确性" << endl;
     
     for (int i = 0; i < sizes_count; i++) {
         int n = sizes[i];
-        int test_count = test_counts[i];
-        cout << "测试矩阵大小: " << n << "x" << n << " (" << test_count << "次)" << endl;
         
-        // 分配内存
-        double** matrix = new double*[n];
-        for (int j = 0; j < n; j++) {
-            matrix[j] = new double[n];
-        }
-        double* vector = new double[n];
-        double* result_naive = new double[n];
-        double* result_cache = new double[n];
+        // 从内存池中切出矩阵和向量
+        arena.reset();
+        Matrix matrix = alloc_matrix(arena, n, layout);
+        double* vector = arena.alloc(n);
+        double* result_naive = arena.alloc(n);
+        double* result_cache = arena.alloc(n);
         
         // 生成测试数据
-        generate_data(matrix, vector, n);
+        generate_data(matrix, vector);
         
         // 验证结果是否正确（只需验证一次）
-        mula(matrix, vector, result_naive, n);
-        mulb(matrix, vector, result_cache, n);
-        
-        bool correct = true;
-        for (int j = 0; j < n; j++) {
-            if (abs(result_naive[j] - result_cache[j]) > 1e-10) {
-                correct = false;
-                break;
-            }
-        }
-        
-        // 测试平凡算法 - 累计所有测试时间
-        double total_time_naive = 0.0;
-        for (int t = 0; t < test_count; t++) {
-            double start_time = get_time();
-            mula(matrix, vector, result_naive, n);
-            total_time_naive += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == test_count-1) {
-                cout << "  平凡算法进度: " << t+1 << "/" << test_count << endl;
-            }
-        }
+        mula(matrix, vector, result_naive);
+        mulb(matrix, vector, result_cache);
+        bool correct = results_match(result_naive, result_cache, n);
         
-        // 测试Cache优化算法 - 累计所有测试时间
-        double total_time_cache = 0.0;
-        for (int t = 0; t < test_count; t++) {
-            double start_time = get_time();
-            mulb(matrix, vector, result_cache, n);
-            total_time_cache += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == test_count-1) {
-                cout << "  Cache优化算法进度: " << t+1 << "/" << test_count << endl;
-            }
-        }
+        BenchStats naive = bench_run([&] { mula(matrix, vector, result_naive); }, options);
+        BenchStats cache = bench_run([&] { mulb(matrix, vector, result_cache); }, options);
+        report.add("basic", "mula", n, naive);
+        roofline.add("basic", "mula", n, gemv_work(n), naive.median);
+        report.add("basic", "mulb", n, cache);
+        roofline.add("basic", "mulb", n, gemv_work(n), cache.median);
         
         // 计算加速比
-        double speedup = total_time_naive / total_time_cache;
+        double speedup = naive.median / cache.median;
         
         // 输出结果到控制台
         cout << n << "\t" 
-             << fixed << setprecision(6) << total_time_naive << "\t\t" 
-             << total_time_cache << "\t\t"
-             << setprecision(2) << speedup << "x\t"
+             << scientific << setprecision(3) << naive.median << "\t" 
+             << cache.median << "\t"
+             << fixed << setprecision(2) << speedup << "x\t"
+             << "±" << naive.ci * 100 << "%/±" << cache.ci * 100 << "%\t"
              << (correct ? "正确" : "错误")
              << endl;
         
         // 写入CSV文件
         out_file << n << "," 
-                 << fixed << setprecision(6) << total_time_naive << "," 
-                 << total_time_cache << ","
-                 << setprecision(3) << speedup << ","
-                 << (correct ? "正确" : "错误")
-                 << endl;
+                 << scientific << setprecision(6) << naive.median << "," 
+                 << cache.median << ","
+                 << fixed << setprecision(3) << speedup << ","
+                 << (correct ? "正确" : "错误") << ","
+                 << layout_name(layout);
+        write_bench_csv(out_file, naive);
+        write_bench_csv(out_file, cache);
+        write_perf_csv(out_file, naive.counters, (double)n * n);
+        write_perf_csv(out_file, cache.counters, (double)n * n);
+        out_file << endl;
         
-        // 释放内存
-        for (int j = 0; j < n; j++) {
-            delete[] matrix[j];
-        }
-        delete[] matrix;
-        delete[] vector;
-        delete[] result_naive;
-        delete[] result_cache;
+        // 旧布局的矩阵不在内存池中，单独释放
+        free_matrix(matrix);
     }
     
+    report.write_csv_note(out_file);
     out_file.close();
-    cout << "基础矩阵乘法测试结果已保存到: " << output_file << endl;
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "基础矩阵乘法测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
 }
 
-// 测试进阶矩阵乘法：平凡算法与循环展开算法对比
-void test_advanced_mul(int* sizes, int* test_counts, int sizes_count, const char* output_file) {
+// 测试进阶矩阵乘法：平凡算法与编译期展开内核的参数网格(展开行数 x 累加链条数)对比，记录每个规模的最优配置
+// 4路/8路展开即单链的4行/8行配置(mulc/muld)，单独保留这两列；时间均为bench_run给出的单次调用中位数
+void test_advanced_mul(int* sizes, int sizes_count, const char* output_file, MatrixLayout layout,
+                       const BenchOptions& options) {
     ofstream out_file(output_file);
     if (!out_file.is_open()) {
         cout << "无法创建文件: " << output_file << endl;
         return;
     }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    // 矩阵(连续布局)、输入向量和两个结果向量都从内存池中分配，容量按最大规模一次预留
+    int max_n = 0;
+    for (int i = 0; i < sizes_count; i++) {
+        if (sizes[i] > max_n) max_n = sizes[i];
+    }
+    BufferArena arena(arena_matrix_bytes(max_n) + 3 * arena_array_bytes(max_n), options.pages);
+    // 网格中配置很多，每个配置的计时时间上限取总上限的1/4
+    BenchOptions grid_options = options;
+    grid_options.max_seconds = options.max_seconds / 4;
     
-    // 写入CSV文件头
-    out_file << "矩阵大小,平凡算法(秒),4路展开(秒),8路展开(秒),4路展开加速比,8路展开加速比,结果正确性" << endl;
+    const vector<UnrolledGemv>& grid = gemv_unroll_grid();
+    int grid_size = grid.size();
+    int index4 = 0, index8 = 0;
+    for (int c = 0; c < grid_size; c++) {
+        if (grid[c].unroll == 4 && grid[c].accumulators == 1) index4 = c;
+        if (grid[c].unroll == 8 && grid[c].accumulators == 1) index8 = c;
+    }
+    
+    // 写入CSV文件头，最后是网格中每个配置的时间
+    write_topology_header(out_file);
+    out_file << "# 内存池: " << arena.summary() << endl;
+    out_file << "矩阵大小,平凡算法(秒),4路展开(秒),8路展开(秒),4路展开加速比,8路展开加速比,结果正确性,存储布局,"
+             << "最优展开行数,最优累加链数,最优展开(秒),最优展开加速比";
+    for (const UnrolledGemv& config : grid) {
+        out_file << "," << config.unroll << "行" << config.accumulators << "链(秒)";
+    }
+    write_bench_csv_header(out_file, "平凡算法");
+    write_bench_csv_header(out_file, "最优展开");
+    write_perf_csv_header(out_file, "平凡算法");
+    write_perf_csv_header(out_file, "最优展开");
+    out_file << endl;
     
     // 控制台表头
-    cout << "\n进阶矩阵乘法算法性能比较:" << endl;
-    cout << "规模\t平凡算法(秒)\t4路展开(秒)\t8路展开(秒)\t4路加速比\t8路加速比\t结果正确性" << endl;
-    cout << "------\t-----------\t-----------\t-----------\t----------\t----------\t----------" << endl;
+    cout << "\n进阶矩阵乘法算法性能比较 (" << layout_name(layout) << "布局, " << grid_size << "种展开配置):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "内存池: " << arena.summary() << endl;
+    cout << "规模\t平凡算法(秒)\t4路展开(秒)\t8路展开(秒)\t最优配置\t最优(秒)\t最优加速比\t结果正确性" << endl;
     
+    double* times = new double[grid_size];
+    BenchStats* stats = new BenchStats[grid_size];
     for (int i = 0; i < sizes_count; i++) {
         int n = sizes[i];
-        int test_count = test_counts[i];
-        cout << "测试矩阵大小: " << n << "x" << n << " (" << test_count << "次)" << endl;
         
-        // 分配内存
-        double** matrix = new double*[n];
-        for (int j = 0; j < n; j++) {
-            matrix[j] = new double[n];
-        }
-        double* vector = new double[n];
-        double* result_naive = new double[n];
-        double* result_unroll4 = new double[n];
-        double* result_unroll8 = new double[n];
+        // 从内存池中切出矩阵和向量
+        arena.reset();
+        Matrix matrix = alloc_matrix(arena, n, layout);
+        double* vector = arena.alloc(n);
+        double* result_naive = arena.alloc(n);
+        double* result_unrolled = arena.alloc(n);
         
         // 生成测试数据
-        generate_data(matrix, vector, n);
+        generate_data(matrix, vector);
         
         // 验证结果是否正确（只需验证一次）
-        mula(matrix, vector, result_naive, n);
-        mulc(matrix, vector, result_unroll4, n);
-        muld(matrix, vector, result_unroll8, n);
-        
-        bool correct4 = true, correct8 = true;
-        for (int j = 0; j < n; j++) {
-            if (abs(result_naive[j] - result_unroll4[j]) > 1e-10) {
-                correct4 = false;
-                break;
-            }
-            if (abs(result_naive[j] - result_unroll8[j]) > 1e-10) {
-                correct8 = false;
-                break;
-            }
-        }
-        
-        // 测试平凡算法 - 累计所有测试时间
-        double total_time_naive = 0.0;
-        for (int t = 0; t < test_count; t++) {
-            double start_time = get_time();
-            mula(matrix, vector, result_naive, n);
-            total_time_naive += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == test_count-1) {
-                cout << "  平凡算法进度: " << t+1 << "/" << test_count << endl;
+        mula(matrix, vector, result_naive);
+        bool correct = true;
+        for (int c = 0; c < grid_size; c++) {
+            grid[c].kernel(matrix, vector, result_unrolled);
+            if (!results_match(result_naive, result_unrolled, n)) {
+                correct = false;
+                cout << "  " << grid[c].unroll << "行" << grid[c].accumulators << "链结果错误" << endl;
             }
         }
         
-        // 测试4路循环展开 - 累计所有测试时间
-        double total_time_unroll4 = 0.0;
-        for (int t = 0; t < test_count; t++) {
-            double start_time = get_time();
-            mulc(matrix, vector, result_unroll4, n);
-            total_time_unroll4 += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == test_count-1) {
-                cout << "  4路展开算法进度: " << t+1 << "/" << test_count << endl;
-            }
-        }
+        BenchStats naive = bench_run([&] { mula(matrix, vector, result_naive); }, options);
+        report.add("advanced", "mula", n, naive);
+        roofline.add("advanced", "mula", n, gemv_work(n), naive.median);
+        double total_time_naive = naive.median;
         
-        // 测试8路循环展开 - 累计所有测试时间
-        double total_time_unroll8 = 0.0;
-        for (int t = 0; t < test_count; t++) {
-            double start_time = get_time();
-            muld(matrix, vector, result_unroll8, n);
-            total_time_unroll8 += (get_time() - start_time);
-            
-            // 输出进度
-            if ((t+1) % 10 == 0 || t == test_count-1) {
-                cout << "  8路展开算法进度: " << t+1 << "/" << test_count << endl;
-            }
+        // 扫描展开参数网格
+        int best = 0;
+        for (int c = 0; c < grid_size; c++) {
+            UnrolledGemvKernel kernel = grid[c].kernel;
+            stats[c] = bench_run([&] { kernel(matrix, vector, result_unrolled); }, grid_options);
+            times[c] = stats[c].median;
+            if (times[c] < times[best]) best = c;
+            string name = to_string(grid[c].unroll) + "x" + to_string(grid[c].accumulators);
+            report.add("advanced", name.c_str(), n, stats[c]);
+            roofline.add("advanced", name.c_str(), n, gemv_work(n), stats[c].median);
         }
         
         // 计算加速比
-        double speedup4 = total_time_naive / total_time_unroll4;
-        double speedup8 = total_time_naive / total_time_unroll8;
+        double speedup4 = total_time_naive / times[index4];
+        double speedup8 = total_time_naive / times[index8];
+        double speedup_best = total_time_naive / times[best];
         
         // 输出结果到控制台
         cout << n << "\t" 
-             << fixed << setprecision(6) << total_time_naive << "\t\t" 
-             << total_time_unroll4 << "\t\t"
-             << total_time_unroll8 << "\t\t"
-             << setprecision(2) << speedup4 << "x\t\t"
-             << speedup8 << "x\t\t"
-             << (correct4 && correct8 ? "正确" : "错误")
+             << scientific << setprecision(3) << total_time_naive << "\t" 
+             << times[index4] << "\t"
+             << times[index8] << "\t"
+             << grid[best].unroll << "行" << grid[best].accumulators << "链\t\t"
+             << times[best] << "\t"
+             << fixed << setprecision(2) << speedup_best << "x\t\t"
+             << (correct ? "正确" : "错误")
              << endl;
         
         // 写入CSV文件
         out_file << n << "," 
-                 << fixed << setprecision(6) << total_time_naive << "," 
-                 << total_time_unroll4 << ","
-                 << total_time_unroll8 << ","
-                 << setprecision(3) << speedup4 << ","
+                 << scientific << setprecision(6) << total_time_naive << "," 
+                 << times[index4] << ","
+                 << times[index8] << ","
+                 << fixed << setprecision(3) << speedup4 << ","
                  << speedup8 << ","
-                 << (correct4 && correct8 ? "正确" : "错误")
-                 << endl;
-        
-        // 释放内存
-        for (int j = 0; j < n; j++) {
-            delete[] matrix[j];
+                 << (correct ? "正确" : "错误") << ","
+                 << layout_name(layout) << ","
+                 << grid[best].unroll << ","
+                 << grid[best].accumulators << ","
+                 << scientific << setprecision(6) << times[best] << ","
+                 << fixed << setprecision(3) << speedup_best;
+        out_file << scientific << setprecision(6);
+        for (int c = 0; c < grid_size; c++) {
+            out_file << "," << times[c];
         }
-        delete[] matrix;
-        delete[] vector;
-        delete[] result_naive;
-        delete[] result_unroll4;
-        delete[] result_unroll8;
+        write_bench_csv(out_file, naive);
+        write_bench_csv(out_file, stats[best]);
+        write_perf_csv(out_file, naive.counters, (double)n * n);
+        write_perf_csv(out_file, stats[best].counters, (double)n * n);
+        out_file << fixed << endl;
+        
+        // 旧布局的矩阵不在内存池中，单独释放
+        free_matrix(matrix);
     }
+    delete[] times;
+    delete[] stats;
     
+    report.write_csv_note(out_file);
     out_file.close();
-    cout << "进阶矩阵乘法测试结果已保存到: " << output_file << endl;
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "进阶矩阵乘法测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
 }
 
-int main() {
-    srand(time(NULL));
+// 存储布局对比：同一规模下分别用旧布局(double**)和连续对齐布局运行平凡算法与Cache优化算法
+// 时间为bench_run给出的单次调用中位数，完整统计写入同名的JSON文件
+void test_layout_mul(int* sizes, int sizes_count, const char* output_file, const BenchOptions& options) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    BenchReport report(options);
+    RooflineReport roofline(options);
     
-    // 定义测试规模和对应的测试次数
-    vector<int> test_sizes;
-    vector<int> test_counts;
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "矩阵大小,行距,旧布局平凡算法(秒),连续布局平凡算法(秒),旧布局Cache优化(秒),连续布局Cache优化(秒),"
+             << "平凡算法布局加速比,Cache优化布局加速比,结果正确性" << endl;
     
-    for (int i = 1; i <= 10; i += 1) {
-        test_sizes.push_back(i);
-        test_counts.push_back(200);      // 非常小的矩阵，测试200次
-    }
-    // 超小矩阵 - 从1到100，步长10
-    for (int i = 11; i <= 100; i += 4) {
-        test_sizes.push_back(i);
-        test_counts.push_back(200);      // 非常小的矩阵，测试200次
+    // 控制台表头
+    cout << "\n存储布局性能比较 (单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "规模\t旧布局平凡(秒)\t连续布局平凡(秒)\t旧布局Cache(秒)\t连续布局Cache(秒)\t平凡加速比\tCache加速比\t结果正确性" << endl;
+    
+    for (int i = 0; i < sizes_count; i++) {
+        int n = sizes[i];
+        
+        Matrix legacy = alloc_matrix(n, LAYOUT_LEGACY);
+        Matrix contiguous = alloc_matrix(n, LAYOUT_CONTIGUOUS);
+        double* vector = new double[n];
+        double* result_legacy = new double[n];
+        double* result_contiguous = new double[n];
+        
+        generate_data(legacy, vector);
+        generate_data(contiguous, vector);
+        
+        // 验证两种布局结果一致
+        mula(legacy, vector, result_legacy);
+        mulb(contiguous, vector, result_contiguous);
+        bool correct = results_match(result_legacy, result_contiguous, n);
+        mulb(legacy, vector, result_legacy);
+        correct = correct && results_match(result_legacy, result_contiguous, n);
+        
+        BenchStats naive_legacy = bench_run([&] { mula(legacy, vector, result_legacy); }, options);
+        BenchStats naive_contiguous = bench_run([&] { mula(contiguous, vector, result_contiguous); }, options);
+        BenchStats cache_legacy = bench_run([&] { mulb(legacy, vector, result_legacy); }, options);
+        BenchStats cache_contiguous = bench_run([&] { mulb(contiguous, vector, result_contiguous); }, options);
+        report.add("layout", "mula_legacy", n, naive_legacy);
+        report.add("layout", "mula_contiguous", n, naive_contiguous);
+        report.add("layout", "mulb_legacy", n, cache_legacy);
+        report.add("layout", "mulb_contiguous", n, cache_contiguous);
+        roofline.add("layout", "mula_legacy", n, gemv_work(n), naive_legacy.median);
+        roofline.add("layout", "mula_contiguous", n, gemv_work(n), naive_contiguous.median);
+        roofline.add("layout", "mulb_legacy", n, gemv_work(n), cache_legacy.median);
+        roofline.add("layout", "mulb_contiguous", n, gemv_work(n), cache_contiguous.median);
+        double time_naive_legacy = naive_legacy.median;
+        double time_naive_contiguous = naive_contiguous.median;
+        double time_cache_legacy = cache_legacy.median;
+        double time_cache_contiguous = cache_contiguous.median;
+        
+        double speedup_naive = time_naive_legacy / time_naive_contiguous;
+        double speedup_cache = time_cache_legacy / time_cache_contiguous;
+        
+        // 输出结果到控制台
+        cout << n << "\t"
+             << scientific << setprecision(3) << time_naive_legacy << "\t"
+             << time_naive_contiguous << "\t\t"
+             << time_cache_legacy << "\t"
+             << time_cache_contiguous << "\t\t"
+             << fixed << setprecision(2) << speedup_naive << "x\t\t"
+             << speedup_cache << "x\t\t"
+             << (correct ? "正确" : "错误")
+             << endl;
+        
+        // 写入CSV文件
+        out_file << n << "," << contiguous.ld << ","
+                 << scientific << setprecision(6) << time_naive_legacy << ","
+                 << time_naive_contiguous << ","
+                 << time_cache_legacy << ","
+                 << time_cache_contiguous << ","
+                 << fixed << setprecision(3) << speedup_naive << ","
+                 << speedup_cache << ","
+                 << (correct ? "正确" : "错误")
+                 << endl;
+        
+        // 释放内存
+        free_matrix(legacy);
+        free_matrix(contiguous);
+        delete[] vector;
+        delete[] result_legacy;
+        delete[] result_contiguous;
     }
     
-    // 小矩阵 - 从110到200，步长10
-    for (int i = 110; i <= 200; i += 10) {
-        test_sizes.push_back(i);
-        test_counts.push_back(150);      // 很小的矩阵，测试150次
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "存储布局测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// 多线程扩展性测试：对每个规模扫描线程数，比较列划分、行划分与自动选择的划分
+// 加速比和并行效率均相对单线程mulb计算，时间为bench_run给出的单次调用中位数
+void test_parallel_mul(int* sizes, int sizes_count, const char* output_file, MatrixLayout layout,
+                       int max_threads, const BenchOptions& options) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
     }
+    BenchReport report(options);
+    RooflineReport roofline(options);
     
-    // L1缓存临界点附近(240-260)细粒度采样 - L1缓存约512KB，矩阵临界点约250
-    for (int i = 240; i <= 260; i += 1) {
-        test_sizes.push_back(i);
-        test_counts.push_back(100);      // L1缓存临界点，适当测试次数
+    // 线程数按2的幂扫描，最后补上max_threads
+    vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
     }
+    thread_counts.push_back(max_threads);
     
-    // 中小矩阵 - 从280到500，步长20
-    for (int i = 280; i <= 500; i += 20) {
-        test_sizes.push_back(i);
-        test_counts.push_back(50);       // 中小矩阵，测试50次
+    // 每种线程数只创建一次线程池，避免把线程创建开销计入测试
+    vector<ThreadPool*> pools;
+    for (int t : thread_counts) {
+        pools.push_back(new ThreadPool(t));
     }
     
-    // 中等矩阵 - 从550到800，步长50
-    for (int i = 550; i <= 800; i += 20) {
-        test_sizes.push_back(i);
-        test_counts.push_back(30);       // 中等矩阵，测试30次
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "矩阵大小,线程数,Cache优化(秒),列划分(秒),行划分(秒),自动划分,自动划分(秒),加速比,并行效率,结果正确性" << endl;
+    
+    // 控制台表头
+    cout << "\n多线程矩阵乘法扩展性测试 (" << layout_name(layout) << "布局, 最多" << max_threads << "线程, 单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "规模\t线程数\tCache优化(秒)\t列划分(秒)\t行划分(秒)\t自动划分\t加速比\t并行效率\t结果正确性" << endl;
+    
+    for (int i = 0; i < sizes_count; i++) {
+        int n = sizes[i];
+        
+        Matrix matrix = alloc_matrix(n, layout);
+        double* vector = new double[n];
+        double* result_cache = new double[n];
+        double* result_parallel = new double[n];
+        double* partials = alloc_aligned(partials_size(n, max_threads));
+        
+        generate_data(matrix, vector);
+        mulb(matrix, vector, result_cache);
+        BenchStats cache = bench_run([&] { mulb(matrix, vector, result_cache); }, options);
+        report.add("parallel", "mulb", n, cache);
+        roofline.add("parallel", "mulb", n, gemv_work(n), cache.median);
+        double time_cache = cache.median;
+        
+        for (size_t p = 0; p < pools.size(); p++) {
+            ThreadPool& pool = *pools[p];
+            int threads = pool.size();
+            
+            // 验证两种划分的结果
+            bool correct = true;
+            mulb_parallel(matrix, vector, result_parallel, pool, partials, PARTITION_COLUMNS);
+            correct = correct && results_match(result_cache, result_parallel, n);
+            mulb_parallel(matrix, vector, result_parallel, pool, partials, PARTITION_ROWS);
+            correct = correct && results_match(result_cache, result_parallel, n);
+            
+            auto run_partition = [&](GemvPartition partition, const char* name) {
+                BenchStats stats = bench_run([&] {
+                    mulb_parallel(matrix, vector, result_parallel, pool, partials, partition);
+                }, options);
+                char kernel[64];
+                snprintf(kernel, sizeof(kernel), "%s_t%d", name, threads);
+                report.add("parallel", kernel, n, stats);
+                roofline.add("parallel", kernel, n, gemv_work(n), stats.median);
+                return stats.median;
+            };
+            double time_columns = run_partition(PARTITION_COLUMNS, "columns");
+            double time_rows = run_partition(PARTITION_ROWS, "rows");
+            
+            GemvPartition chosen = choose_partition(n, threads);
+            double time_auto = chosen == PARTITION_ROWS ? time_rows : time_columns;
+            if (chosen == PARTITION_SERIAL) {
+                time_auto = run_partition(PARTITION_SERIAL, "serial");
+            }
+            double speedup = time_cache / time_auto;
+            double efficiency = speedup / threads;
+            
+            // 输出结果到控制台
+            cout << n << "\t" << threads << "\t"
+                 << scientific << setprecision(3) << time_cache << "\t"
+                 << time_columns << "\t"
+                 << time_rows << "\t"
+                 << partition_name(chosen) << "\t\t"
+                 << fixed << setprecision(2) << speedup << "x\t"
+                 << efficiency << "\t\t"
+                 << (correct ? "正确" : "错误")
+                 << endl;
+            
+            // 写入CSV文件
+            out_file << n << "," << threads << ","
+                     << scientific << setprecision(6) << time_cache << ","
+                     << time_columns << ","
+                     << time_rows << ","
+                     << partition_name(chosen) << ","
+                     << time_auto << ","
+                     << fixed << setprecision(3) << speedup << ","
+                     << efficiency << ","
+                     << (correct ? "正确" : "错误")
+                     << endl;
+        }
+        
+        // 释放内存
+        free_matrix(matrix);
+        delete[] vector;
+        delete[] result_cache;
+        delete[] result_parallel;
+        free_aligned(partials);
     }
     
-    // L2缓存临界点附近(950-1050)细粒度采样 - L2缓存约8MB，矩阵临界点约1000
-    for (int i = 990; i <= 1010; i += 1) {
-        test_sizes.push_back(i);
-        test_counts.push_back(20);       // L2缓存临界点，降低测试次数
+    for (ThreadPool* pool : pools) {
+        delete pool;
     }
     
-    // 大矩阵 - 从1100到1300，步长50
-    for (int i = 1100; i <= 1300; i += 50) {
-        test_sizes.push_back(i);
-        test_counts.push_back(15);       // 大矩阵，测试15次
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "多线程矩阵乘法测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// SIMD微内核测试：行累加顺序与转置点积顺序，对比mulb和muld
+// 点积顺序使用的转置副本在计时前生成，不计入时间；时间为bench_run给出的单次调用中位数
+void test_simd_mul(int* sizes, int sizes_count, const char* output_file, MatrixLayout layout, SimdLevel level,
+                   const BenchOptions& options) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
     }
+    BenchReport report(options);
+    RooflineReport roofline(options);
     
-    // L3缓存临界点附近(1400-1440)细粒度采样 - L3缓存约16MB，矩阵临界点约1420
-    for (int i = 1400; i <= 1440; i += 2) {
-        test_sizes.push_back(i);
-        test_counts.push_back(10);       // L3缓存临界点，最少测试次数
+    GemvSimdKernel axpy_kernel = gemv_axpy_kernel(level);
+    GemvSimdKernel dot_kernel = gemv_dot_kernel(level);
+    // level只是上限，CSV记录实际选中的指令集
+    SimdLevel used = gemv_simd_level(level);
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "矩阵大小,Cache优化(秒),8路展开(秒),SIMD行累加(秒),SIMD点积(秒),"
+             << "行累加相对Cache优化加速比,行累加相对8路展开加速比,点积相对Cache优化加速比,点积相对8路展开加速比,"
+             << "指令集,结果正确性" << endl;
+    
+    // 控制台表头
+    cout << "\nSIMD微内核性能比较 (" << layout_name(layout) << "布局, 指令集上限"
+         << simd_level_name(level) << ", 实际使用" << simd_level_name(used) << ", 单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "规模\tCache优化(秒)\t8路展开(秒)\tSIMD行累加(秒)\tSIMD点积(秒)\t行累加加速比\t点积加速比\t结果正确性" << endl;
+    
+    for (int i = 0; i < sizes_count; i++) {
+        int n = sizes[i];
+        
+        Matrix matrix = alloc_matrix(n, layout);
+        Matrix transposed = alloc_matrix(n, layout);
+        double* vector = new double[n];
+        double* result_cache = new double[n];
+        double* result_simd = new double[n];
+        
+        generate_data(matrix, vector);
+        transpose_matrix(matrix, transposed);
+        
+        // 验证结果是否正确（只需验证一次）
+        mulb(matrix, vector, result_cache);
+        axpy_kernel(matrix, vector, result_simd);
+        bool correct = results_match(result_cache, result_simd, n);
+        dot_kernel(transposed, vector, result_simd);
+        correct = correct && results_match(result_cache, result_simd, n);
+        
+        BenchStats cache = bench_run([&] { mulb(matrix, vector, result_cache); }, options);
+        BenchStats unroll8 = bench_run([&] { muld(matrix, vector, result_cache); }, options);
+        BenchStats axpy = bench_run([&] { axpy_kernel(matrix, vector, result_simd); }, options);
+        BenchStats dot = bench_run([&] { dot_kernel(transposed, vector, result_simd); }, options);
+        report.add("simd", "mulb", n, cache);
+        report.add("simd", "muld", n, unroll8);
+        report.add("simd", "axpy", n, axpy);
+        report.add("simd", "dot", n, dot);
+        roofline.add("simd", "mulb", n, gemv_work(n), cache.median);
+        roofline.add("simd", "muld", n, gemv_work(n), unroll8.median);
+        roofline.add("simd", "axpy", n, gemv_work(n), axpy.median);
+        roofline.add("simd", "dot", n, gemv_work(n), dot.median);
+        double time_cache = cache.median;
+        double time_unroll8 = unroll8.median;
+        double time_axpy = axpy.median;
+        double time_dot = dot.median;
+        
+        // 输出结果到控制台
+        cout << n << "\t"
+             << scientific << setprecision(3) << time_cache << "\t"
+             << time_unroll8 << "\t"
+             << time_axpy << "\t"
+             << time_dot << "\t"
+             << fixed << setprecision(2) << time_cache / time_axpy << "x\t\t"
+             << time_cache / time_dot << "x\t\t"
+             << (correct ? "正确" : "错误")
+             << endl;
+        
+        // 写入CSV文件
+        out_file << n << ","
+                 << scientific << setprecision(6) << time_cache << ","
+                 << time_unroll8 << ","
+                 << time_axpy << ","
+                 << time_dot << ","
+                 << fixed << setprecision(3) << time_cache / time_axpy << ","
+                 << time_unroll8 / time_axpy << ","
+                 << time_cache / time_dot << ","
+                 << time_unroll8 / time_dot << ","
+                 << simd_level_name(used) << ","
+                 << (correct ? "正确" : "错误")
+                 << endl;
+        
+        // 释放内存
+        free_matrix(matrix);
+        free_matrix(transposed);
+        delete[] vector;
+        delete[] result_cache;
+        delete[] result_simd;
     }
     
-    // 超大矩阵 - 从1450到1700，步长50
-    for (int i = 1450; i <= 1700; i += 50) {
-        test_sizes.push_back(i);
-        test_counts.push_back(5);        // 超大矩阵，最少测试次数
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "SIMD微内核测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// 二维分块测试：分块参数由检测到的L1/L2大小计算，对比mulb；时间为bench_run给出的单次调用中位数
+void test_tiled_mul(int* sizes, int sizes_count, const char* output_file, MatrixLayout layout,
+                    const BenchOptions& options) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
     }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    
+    const CacheTopology& topo = cache_topology();
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "矩阵大小,Cache优化(秒),分块(秒),加速比,列块宽度,行块高度,结果正确性" << endl;
+    
+    // 控制台表头
+    cout << "\n二维分块矩阵乘法性能比较 (" << layout_name(layout) << "布局, L1d="
+         << topo.l1d / 1024 << "KB, L2=" << topo.l2 / 1024 << "KB, 单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "规模\tCache优化(秒)\t分块(秒)\t加速比\t列块宽度\t行块高度\t结果正确性" << endl;
     
-    // 将vector转换为数组
-    int sizes_count = test_sizes.size();
-    int* sizes = new int[sizes_count];
-    int* counts = new int[sizes_count];
     for (int i = 0; i < sizes_count; i++) {
-        sizes[i] = test_sizes[i];
-        counts[i] = test_counts[i];
+        int n = sizes[i];
+        
+        Matrix matrix = alloc_matrix(n, layout);
+        double* vector = new double[n];
+        double* result_cache = new double[n];
+        double* result_tiled = new double[n];
+        
+        generate_data(matrix, vector);
+        GemvTiling tiling = gemv_tiling_for(n, topo);
+        
+        // 验证结果是否正确（只需验证一次）
+        mulb(matrix, vector, result_cache);
+        mul_tiled(matrix, vector, result_tiled, tiling);
+        bool correct = results_match(result_cache, result_tiled, n);
+        
+        BenchStats cache = bench_run([&] { mulb(matrix, vector, result_cache); }, options);
+        BenchStats tiled = bench_run([&] { mul_tiled_auto(matrix, vector, result_tiled); }, options);
+        report.add("tiled", "mulb", n, cache);
+        report.add("tiled", "tiled", n, tiled);
+        roofline.add("tiled", "mulb", n, gemv_work(n), cache.median);
+        roofline.add("tiled", "tiled", n, gemv_work(n), tiled.median);
+        double time_cache = cache.median;
+        double time_tiled = tiled.median;
+        double speedup = time_cache / time_tiled;
+        
+        // 输出结果到控制台
+        cout << n << "\t"
+             << scientific << setprecision(3) << time_cache << "\t"
+             << time_tiled << "\t"
+             << fixed << setprecision(2) << speedup << "x\t"
+             << tiling.tile_cols << "\t\t"
+             << tiling.panel_rows << "\t\t"
+             << (correct ? "正确" : "错误")
+             << endl;
+        
+        // 写入CSV文件
+        out_file << n << ","
+                 << scientific << setprecision(6) << time_cache << ","
+                 << time_tiled << ","
+                 << fixed << setprecision(3) << speedup << ","
+                 << tiling.tile_cols << ","
+                 << tiling.panel_rows << ","
+                 << (correct ? "正确" : "错误")
+                 << endl;
+        
+        // 释放内存
+        free_matrix(matrix);
+        delete[] vector;
+        delete[] result_cache;
+        delete[] result_tiled;
     }
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "二维分块测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
 
-    cout << "========== 矩阵向量乘法性能优化测试 ==========" << endl;
-    cout << "优化测试规模方案，专注于缓存临界点，共" << sizes_count << "个规模点" << endl;
-    cout << "L1缓存临界点(~250), L2缓存临界点(~1000), L3缓存临界点(~1420)" << endl;
-
-    // 测试基础算法：平凡算法vs缓存优化
-    test_basic_mul(sizes, counts, sizes_count, "jichu_matrix.csv");
+// 批量矩阵向量乘法测试：同一矩阵乘k个向量，对比k次单独的mulb
+// 有效GFLOP/s按每个向量2*n*n次浮点运算计算，时间为bench_run给出的k个向量一次调用的中位数
+void test_batch_mul(int* sizes, int sizes_count, const char* output_file, MatrixLayout layout,
+                    const BenchOptions& options) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    BenchReport report(options);
+    RooflineReport roofline(options);
     
-    // 测试进阶算法：平凡算法vs循环展开
-    test_advanced_mul(sizes, counts, sizes_count, "jinjie_matrix.csv");
+    const int batch_ks[] = {1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64};
+    const int batch_k_count = sizeof(batch_ks) / sizeof(batch_ks[0]);
+    const int max_k = 64;
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "矩阵大小,向量个数,逐个Cache优化(秒),批量(秒),逐个Cache优化(GFLOP/s),批量(GFLOP/s),加速比,结果正确性" << endl;
+    
+    // 控制台表头
+    cout << "\n批量矩阵向量乘法性能比较 (" << layout_name(layout) << "布局, 单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "规模\t向量个数\t逐个(秒)\t批量(秒)\t逐个(GFLOP/s)\t批量(GFLOP/s)\t加速比\t结果正确性" << endl;
+    
+    for (int i = 0; i < sizes_count; i++) {
+        int n = sizes[i];
+        
+        Matrix matrix = alloc_matrix(n, layout);
+        double* vectors[max_k];
+        double* results_single[max_k];
+        double* results_batch[max_k];
+        double* unused = new double[n];
+        generate_data(matrix, unused);
+        for (int c = 0; c < max_k; c++) {
+            vectors[c] = new double[n];
+            results_single[c] = new double[n];
+            results_batch[c] = new double[n];
+            for (int r = 0; r < n; r++) {
+                vectors[c][r] = (r * (c + 1)) % 5 + 1.0;  // 每个向量取不同的固定值
+            }
+        }
+        
+        for (int kk = 0; kk < batch_k_count; kk++) {
+            int k = batch_ks[kk];
+            
+            // 验证结果是否正确（只需验证一次）
+            mul_batch(matrix, vectors, results_batch, k);
+            bool correct = true;
+            for (int c = 0; c < k; c++) {
+                mulb(matrix, vectors[c], results_single[c]);
+                correct = correct && results_match(results_single[c], results_batch[c], n);
+            }
+            
+            // k次单独的mulb与一次批量调用
+            BenchStats single = bench_run([&] {
+                for (int c = 0; c < k; c++) {
+                    mulb(matrix, vectors[c], results_single[c]);
+                }
+            }, options);
+            BenchStats batch = bench_run([&] { mul_batch(matrix, vectors, results_batch, k); }, options);
+            char kernel[64];
+            snprintf(kernel, sizeof(kernel), "mulb_x%d", k);
+            report.add("batch", kernel, n, single);
+            roofline.add("batch", kernel, n, gemv_batch_work(n, k, k), single.median);
+            snprintf(kernel, sizeof(kernel), "batch_x%d", k);
+            report.add("batch", kernel, n, batch);
+            roofline.add("batch", kernel, n, gemv_batch_work(n, k, 1), batch.median);
+            double time_single = single.median;
+            double time_batch = batch.median;
+            
+            double flops = 2.0 * n * n * k;
+            double gflops_single = flops / time_single / 1.0e9;
+            double gflops_batch = flops / time_batch / 1.0e9;
+            double speedup = time_single / time_batch;
+            
+            // 输出结果到控制台
+            cout << n << "\t" << k << "\t\t"
+                 << scientific << setprecision(3) << time_single << "\t"
+                 << time_batch << "\t"
+                 << fixed << setprecision(2) << gflops_single << "\t\t"
+                 << gflops_batch << "\t\t"
+                 << speedup << "x\t"
+                 << (correct ? "正确" : "错误")
+                 << endl;
+            
+            // 写入CSV文件
+            out_file << n << "," << k << ","
+                     << scientific << setprecision(6) << time_single << ","
+                     << time_batch << ","
+                     << fixed << setprecision(3) << gflops_single << ","
+                     << gflops_batch << ","
+                     << speedup << ","
+                     << (correct ? "正确" : "错误")
+                     << endl;
+        }
+        
+        // 释放内存
+        free_matrix(matrix);
+        delete[] unused;
+        for (int c = 0; c < max_k; c++) {
+            delete[] vectors[c];
+            delete[] results_single[c];
+            delete[] results_batch[c];
+        }
+    }
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "批量矩阵向量乘法测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// ---------------- 稀疏矩阵向量乘法 ----------------
+
+// 相对误差比较，用于Matrix Market文件中的非整数数据(各格式的加法顺序不同)
+bool results_close(const double* expected, const double* actual, int n) {
+    for (int j = 0; j < n; j++) {
+        if (abs(expected[j] - actual[j]) > 1e-12 * (abs(expected[j]) + 1.0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 在generate_data的基础上只保留约density比例的元素，其余置0；保留哪些元素由位置的哈希决定
+void generate_sparse_data(Matrix& matrix, double* vector, double density) {
+    generate_data(matrix, vector);
+    int n = matrix.n;
+    uint32_t threshold = (uint32_t)(density * 4294967295.0);
+    for (int i = 0; i < n; i++) {
+        double* row = matrix.row(i);
+        for (int j = 0; j < n; j++) {
+            uint32_t h = (uint32_t)(((uint64_t)i * n + j) * 0x9E3779B97F4A7C15ULL >> 32);
+            if (h >= threshold) row[j] = 0.0;
+        }
+    }
+}
+
+// ELL补齐后超过CSR的这个倍数时不再测试ELL(行长差别大时补齐的元素会占满内存)
+const double ELL_MAX_EXPANSION = 4.0;
+
+// 对一个CSR矩阵测试三种格式的单线程与多线程版本，写一行结果
+// dense_time为同一矩阵稠密存储时mulb的单次时间，没有稠密版本时传0
+void run_sparse_case(ofstream& out_file, BenchReport& report, RooflineReport& roofline, const BenchOptions& options,
+                     ThreadPool& pool, const char* source, const char* distribution, CsrMatrix& csr,
+                     double dense_time) {
+    int rows = csr.rows;
+    double* x = new double[csr.cols];
+    double* expected = new double[rows];
+    double* y = new double[rows];
+    for (int j = 0; j < csr.cols; j++) {
+        x[j] = j % 5 + 1.0;
+    }
+    spmv_csr_scalar(csr, x, expected, 0, rows);
+    
+    int max_len = 0;
+    for (int r = 0; r < rows; r++) {
+        max_len = max(max_len, csr.row_ptr[r + 1] - csr.row_ptr[r]);
+    }
+    bool use_ell = (double)max_len * rows <= ELL_MAX_EXPANSION * csr.nnz + 64.0 * rows;
+    EllMatrix ell;
+    if (use_ell) ell = ell_from_csr(csr);
+    SellMatrix sell = sell_from_csr(csr, 32 * SELL_C);
+    
+    // 先验证结果，再计时；各时间为bench_run给出的单次乘法中位数
+    bool correct = true;
+    auto check = [&]() {
+        correct = correct && results_close(expected, y, rows);
+        fill(y, y + rows, 0.0);
+    };
+    spmv_csr(csr, x, y); check();
+    spmv_sell(sell, x, y); check();
+    spmv_csr_parallel(pool, csr, x, y); check();
+    spmv_sell_parallel(pool, sell, x, y); check();
+    if (use_ell) {
+        spmv_ell(ell, x, y); check();
+        spmv_ell_parallel(pool, ell, x, y); check();
+    }
+    
+    // 同一规模下有多个矩阵(不同密度、行长分布)，测试名中带上行长分布和非零元个数以区分
+    string test = string("sparse/") + distribution + "/nnz" + to_string(csr.nnz);
+    // 屋顶线按各格式实际存储的字节数(含下标和补齐)计算读取量
+    auto time_format = [&](const char* kernel, size_t matrix_bytes, auto call) {
+        BenchStats stats = bench_run(call, options);
+        report.add(test.c_str(), kernel, rows, stats);
+        roofline.add(test.c_str(), kernel, rows, spmv_work((double)matrix_bytes, rows, csr.cols, csr.nnz),
+                     stats.median);
+        return stats.median;
+    };
+    double time_csr = time_format("csr", csr_bytes(csr), [&] { spmv_csr(csr, x, y); });
+    double time_sell = time_format("sell", sell_bytes(sell), [&] { spmv_sell(sell, x, y); });
+    double time_csr_par = time_format("csr_parallel", csr_bytes(csr), [&] { spmv_csr_parallel(pool, csr, x, y); });
+    double time_sell_par = time_format("sell_parallel", sell_bytes(sell),
+                                       [&] { spmv_sell_parallel(pool, sell, x, y); });
+    double time_ell = 0.0, time_ell_par = 0.0;
+    if (use_ell) {
+        time_ell = time_format("ell", ell_bytes(ell), [&] { spmv_ell(ell, x, y); });
+        time_ell_par = time_format("ell_parallel", ell_bytes(ell), [&] { spmv_ell_parallel(pool, ell, x, y); });
+    }
+    
+    double flops = 2.0 * csr.nnz;
+    double nnz = csr.nnz > 0 ? csr.nnz : 1;
+    
+    // 输出结果到控制台
+    cout << rows << "\t" << source << "\t" << distribution << "\t" << csr.nnz << "\t"
+         << fixed << setprecision(1) << (double)csr.nnz / rows << "\t" << max_len << "\t"
+         << setprecision(2) << flops / time_csr / 1.0e9 << "\t";
+    if (use_ell) cout << flops / time_ell / 1.0e9;
+    else cout << "-";
+    cout << "\t" << flops / time_sell / 1.0e9 << "\t"
+         << flops / time_sell_par / 1.0e9 << "\t\t"
+         << csr_bytes(csr) / nnz << "/";
+    if (use_ell) cout << ell_bytes(ell) / nnz;
+    else cout << "-";
+    cout << "/" << sell_bytes(sell) / nnz << "\t";
+    if (dense_time > 0) cout << setprecision(2) << dense_time / time_csr << "x";
+    else cout << "-";
+    cout << "\t" << (correct ? "正确" : "错误") << endl;
+    
+    // 写入CSV文件，未测试的项留空
+    auto optional = [&](bool present, double value) {
+        out_file << ",";
+        if (present) out_file << value;
+    };
+    out_file << rows << "," << source << "," << distribution << "," << csr.nnz << ","
+             << fixed << setprecision(2) << (double)csr.nnz / rows << "," << max_len
+             << setprecision(9);
+    optional(dense_time > 0, dense_time);
+    out_file << "," << time_csr;
+    optional(use_ell, time_ell);
+    out_file << "," << time_sell << "," << time_csr_par;
+    optional(use_ell, time_ell_par);
+    out_file << "," << time_sell_par << setprecision(3);
+    out_file << "," << flops / time_csr / 1.0e9;
+    optional(use_ell, flops / time_ell / 1.0e9);
+    out_file << "," << flops / time_sell / 1.0e9 << "," << flops / time_csr_par / 1.0e9;
+    optional(use_ell, flops / time_ell_par / 1.0e9);
+    out_file << "," << flops / time_sell_par / 1.0e9;
+    out_file << "," << csr_bytes(csr) / nnz;
+    optional(use_ell, ell_bytes(ell) / nnz);
+    out_file << "," << sell_bytes(sell) / nnz;
+    optional(dense_time > 0, dense_time / time_csr);
+    out_file << "," << (correct ? "正确" : "错误") << endl;
+    
+    if (use_ell) free_ell(ell);
+    free_sell(sell);
+    delete[] x;
+    delete[] expected;
+    delete[] y;
+}
+
+// 稀疏矩阵向量乘法测试：扫描规模与密度，比较CSR/ELLPACK/SELL-C-σ的单线程与多线程版本
+// 稠密转换：generate_data生成的矩阵按密度置零后转换，同时给出稠密mulb的时间作对比；
+// 随机生成：更大的规模，行长相同或服从指数分布(行长差别大时ELL补齐代价高，SELL排序后补齐很少)
+void test_sparse_mul(const char* output_file, int num_threads, const char* mtx_path, const BenchOptions& options) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    ThreadPool pool(num_threads);
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "矩阵大小,数据来源,行长分布,非零元个数,平均行长,最长行,稠密mulb(秒),"
+             << "CSR(秒),ELL(秒),SELL(秒),CSR并行(秒),ELL并行(秒),SELL并行(秒),"
+             << "CSR(GFLOP/s),ELL(GFLOP/s),SELL(GFLOP/s),CSR并行(GFLOP/s),ELL并行(GFLOP/s),SELL并行(GFLOP/s),"
+             << "CSR(字节/非零元),ELL(字节/非零元),SELL(字节/非零元),CSR相对稠密加速比,结果正确性" << endl;
+    
+    // 控制台表头
+    cout << "\n稀疏矩阵向量乘法性能比较 (" << simd_level_name(detect_simd_level()) << ", 并行"
+         << pool.size() << "线程, SELL-" << SELL_C << "-" << 32 * SELL_C << ", 单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "规模\t来源\t行长\t非零元\t平均行长\t最长行\tCSR\tELL\tSELL\tSELL并行(GFLOP/s)\t字节/非零元(CSR/ELL/SELL)\t相对稠密\t结果正确性" << endl;
+    
+    // 稠密转换：与稠密mulb对比
+    const int dense_sizes[] = {1024, 2048, 4096};
+    const double densities[] = {0.001, 0.01, 0.05, 0.2};
+    for (int n : dense_sizes) {
+        Matrix matrix = alloc_matrix(n, LAYOUT_CONTIGUOUS);
+        double* vector = new double[n];
+        double* result = new double[n];
+        for (double density : densities) {
+            generate_sparse_data(matrix, vector, density);
+            BenchStats dense = bench_run([&] { mulb(matrix, vector, result); }, options);
+            CsrMatrix csr = csr_from_dense(matrix);
+            string test = string("sparse/均匀/nnz") + to_string(csr.nnz);
+            report.add(test.c_str(), "dense_mulb", n, dense);
+            roofline.add(test.c_str(), "dense_mulb", n, gemv_work(n), dense.median);
+            run_sparse_case(out_file, report, roofline, options, pool, "稠密转换", "均匀", csr, dense.median);
+            free_csr(csr);
+        }
+        free_matrix(matrix);
+        delete[] vector;
+        delete[] result;
+    }
+    
+    // 随机生成：每行平均4/16/64个非零元
+    const int random_sizes[] = {1 << 16, 1 << 19};
+    const int row_lengths[] = {4, 16, 64};
+    for (int n : random_sizes) {
+        for (int len : row_lengths) {
+            for (int skewed = 0; skewed <= 1; skewed++) {
+                CsrMatrix csr = csr_random(n, (double)len / n, skewed, n + len);
+                run_sparse_case(out_file, report, roofline, options, pool, "随机生成", skewed ? "指数分布" : "均匀", csr, 0.0);
+                free_csr(csr);
+            }
+        }
+    }
+    
+    // Matrix Market文件
+    if (mtx_path != nullptr) {
+        CsrMatrix csr = csr_from_matrix_market(mtx_path);
+        if (csr.rows == 0) {
+            cout << "无法读取Matrix Market文件: " << mtx_path << endl;
+        } else {
+            run_sparse_case(out_file, report, roofline, options, pool, mtx_path, "文件", csr, 0.0);
+            free_csr(csr);
+        }
+    }
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "稀疏矩阵向量乘法测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// 流式矩阵文件的精确结果：元素(i*n+j)%10+1只取决于(i*n)%10和j，向量元素i%5+1只取决于i%5，
+// 先统计各(i*n%10, i%5)组合出现的行数，再对每一列按组合求和，O(50n)即可得到结果
+void stream_expected_result(int n, double* expected) {
+    double counts[10][5] = {};
+    for (int i = 0; i < n; i++) {
+        counts[((size_t)i * n) % 10][i % 5] += 1.0;
+    }
+    for (int j = 0; j < n; j++) {
+        double sum = 0.0;
+        for (int a = 0; a < 10; a++) {
+            for (int b = 0; b < 5; b++) {
+                sum += counts[a][b] * ((a + j) % 10 + 1.0) * (b + 1.0);
+            }
+        }
+        expected[j] = sum;
+    }
+}
+
+// 外存矩阵向量乘法测试：矩阵放在文件中按行面板流式读入，结果向量常驻内存
+// 每次运行前把文件移出页缓存，时间拆分为等待I/O和计算两部分
+// 外部文件没有已知结果，以第一种I/O方式的结果为准；各方式的加法顺序相同，结果应逐位一致
+// 屋顶线按端到端时间记录，反映包括I/O在内的整体带宽相对内存峰值的位置
+void test_stream_mul(const char* path, int n, bool generated, const vector<StreamIo>& ios, size_t panel_bytes,
+                     const BenchOptions& options, const char* output_file) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    
+    RooflineReport roofline(options);
+    int panel_rows = stream_panel_rows(n, panel_bytes);
+    double* vector = new double[n];
+    double* result = new double[n];
+    double* expected = new double[n];
+    for (int i = 0; i < n; i++) {
+        vector[i] = i % 5 + 1.0;
+    }
+    bool has_expected = generated;
+    if (generated) stream_expected_result(n, expected);
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "矩阵大小,I/O方式,面板行数,端到端(秒),端到端(GB/s),等待I/O(秒),计算(秒),计算(GFLOP/s),结果正确性" << endl;
+    
+    // 控制台表头
+    cout << "\n外存矩阵向量乘法: " << path << " (" << n << "x" << n << ", "
+         << (size_t)n * n * sizeof(double) / (1 << 20) << "MB, 面板" << panel_rows << "行)" << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "I/O方式\t端到端(秒)\t端到端(GB/s)\t等待I/O(秒)\t计算(秒)\t计算(GFLOP/s)\t结果正确性" << endl;
+    
+    for (StreamIo io : ios) {
+        drop_file_cache(path);
+        StreamStats stats = mul_stream(path, n, vector, result, io, panel_rows);
+        if (!stats.ok) {
+            cout << stream_io_name(io) << "\t" << stats.error << "，跳过" << endl;
+            continue;
+        }
+        
+        if (!has_expected) {
+            memcpy(expected, result, n * sizeof(double));
+            has_expected = true;
+        }
+        bool correct = stats.bytes == (size_t)n * n * sizeof(double) && results_match(expected, result, n);
+        double gbs = stats.bytes / stats.seconds / 1.0e9;
+        double gflops = 2.0 * n * n / stats.compute_seconds / 1.0e9;
+        roofline.add("stream", stream_io_name(io), n, gemv_work(n), stats.seconds);
+        
+        // 输出结果到控制台，mmap下等待缺页的时间包含在计算时间内
+        cout << stream_io_name(io) << "\t"
+             << fixed << setprecision(3) << stats.seconds << "\t\t"
+             << setprecision(2) << gbs << "\t\t";
+        if (io == IO_MMAP) cout << "-";
+        else cout << setprecision(3) << stats.wait_seconds;
+        cout << "\t\t" << setprecision(3) << stats.compute_seconds << "\t\t"
+             << setprecision(2) << gflops << "\t\t"
+             << (correct ? "正确" : "错误") << endl;
+        
+        // 写入CSV文件
+        out_file << n << "," << stream_io_name(io) << "," << panel_rows << ","
+                 << fixed << setprecision(6) << stats.seconds << ","
+                 << setprecision(3) << gbs << ",";
+        if (io != IO_MMAP) out_file << setprecision(6) << stats.wait_seconds;
+        out_file << "," << setprecision(6) << stats.compute_seconds << ","
+                 << setprecision(3) << gflops << ","
+                 << (correct ? "正确" : "错误") << endl;
+    }
+    
+    delete[] vector;
+    delete[] result;
+    delete[] expected;
+    
+    out_file.close();
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "外存矩阵向量乘法测试结果已保存到: " << output_file << ", " << roofline_file << endl;
+}
+
+// ---------------- 混合精度存储 ----------------
+
+// [0,1)均匀分布的矩阵和向量，由位置的哈希决定；整数数据在低精度格式下往往能精确表示，误差没有意义
+void generate_uniform_data(Matrix& matrix, double* vector) {
+    int n = matrix.n;
+    for (int i = 0; i < n; i++) {
+        double* row = matrix.row(i);
+        for (int j = 0; j < n; j++) {
+            uint64_t h = ((uint64_t)i * n + j + 1) * 0x9E3779B97F4A7C15ULL;
+            row[j] = (h >> 11) * (1.0 / 9007199254740992.0);
+        }
+        uint64_t h = ((uint64_t)i + 1) * 0xD1B54A32D192ED03ULL;
+        vector[i] = (h >> 11) * (1.0 / 9007199254740992.0);
+    }
+}
+
+// 对一种存储格式测试一行：转换后计时，误差相对于双精度mulb的结果
+// time_double为mulb的单次时间
+template <typename T>
+void run_mixed_case(ofstream& out_file, BenchReport& report, RooflineReport& roofline, const BenchOptions& options,
+                    const Matrix& matrix, const double* vector, const double* reference, double time_double) {
+    int n = matrix.n;
+    StoredMatrix<T> stored = convert_matrix<T>(matrix);
+    double* result = new double[n];
+    
+    gemv_mixed(stored, vector, result);
+    double max_error = 0.0;
+    for (int j = 0; j < n; j++) {
+        double error = abs(result[j] - reference[j]) / abs(reference[j]);
+        if (error > max_error) max_error = error;
+    }
+    
+    BenchStats mixed = bench_run([&] { gemv_mixed(stored, vector, result); }, options);
+    double time_mixed = mixed.median;
+    // int8的每行缩放因子也计入读取的字节数
+    double matrix_bytes = (double)n * n * sizeof(T) + (stored.scales != nullptr ? (double)n * sizeof(double) : 0.0);
+    report.add("mixed", storage_name<T>(), n, mixed);
+    roofline.add("mixed", storage_name<T>(), n, gemv_stored_work(n, matrix_bytes), time_mixed);
+    double bytes_per_element = matrix_bytes / ((double)n * n);
+    double gbs = matrix_bytes / time_mixed / 1.0e9;
+    double speedup = time_double / time_mixed;
+    
+    // 输出结果到控制台
+    cout << n << "\t" << storage_name<T>() << "\t"
+         << fixed << setprecision(2) << bytes_per_element << "\t\t"
+         << scientific << setprecision(3) << time_double << "\t"
+         << time_mixed << "\t"
+         << fixed << setprecision(2) << gbs << "\t\t"
+         << speedup << "x\t"
+         << scientific << setprecision(2) << max_error << fixed << endl;
+    
+    // 写入CSV文件
+    out_file << n << "," << storage_name<T>() << ","
+             << fixed << setprecision(3) << bytes_per_element << ","
+             << scientific << setprecision(6) << time_double << ","
+             << time_mixed << ","
+             << fixed << setprecision(3) << gbs << ","
+             << speedup << ","
+             << scientific << setprecision(3) << max_error << fixed << endl;
+    
+    delete[] result;
+    free_stored(stored);
+}
+
+// 混合精度测试：矩阵以double/float/fp16/bf16/int8存储，转换为double后累加
+// 矩阵向量乘法受内存带宽限制，存储越窄，规模超出缓存后加速越明显；误差为max_j |y_j-ref_j|/|ref_j|
+void test_mixed_mul(int* sizes, int sizes_count, const char* output_file, const BenchOptions& options) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "矩阵大小,存储格式,每元素字节数,double mulb(秒),混合精度(秒),有效带宽(GB/s),加速比,最大相对误差" << endl;
+    
+    // 控制台表头
+    cout << "\n混合精度矩阵向量乘法 (" << simd_level_name(detect_simd_level())
+         << (f16c_supported() ? "+F16C" : ", 无F16C时使用标量版本") << ", 单次调用中位数):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "规模\t格式\t字节/元素\tmulb(秒)\t混合精度(秒)\tGB/s\t\t加速比\t最大相对误差" << endl;
+    
+    for (int i = 0; i < sizes_count; i++) {
+        int n = sizes[i];
+        
+        Matrix matrix = alloc_matrix(n, LAYOUT_CONTIGUOUS);
+        double* vector = new double[n];
+        double* reference = new double[n];
+        generate_uniform_data(matrix, vector);
+        
+        mulb(matrix, vector, reference);
+        BenchStats mulb_stats = bench_run([&] { mulb(matrix, vector, reference); }, options);
+        report.add("mixed", "mulb", n, mulb_stats);
+        roofline.add("mixed", "mulb", n, gemv_work(n), mulb_stats.median);
+        double time_double = mulb_stats.median;
+        
+        run_mixed_case<double>(out_file, report, roofline, options, matrix, vector, reference, time_double);
+        run_mixed_case<float>(out_file, report, roofline, options, matrix, vector, reference, time_double);
+        run_mixed_case<half_t>(out_file, report, roofline, options, matrix, vector, reference, time_double);
+        run_mixed_case<bf16_t>(out_file, report, roofline, options, matrix, vector, reference, time_double);
+        run_mixed_case<int8_t>(out_file, report, roofline, options, matrix, vector, reference, time_double);
+        
+        free_matrix(matrix);
+        delete[] vector;
+        delete[] reference;
+    }
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "混合精度矩阵向量乘法测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// ---------------- 增量更新 ----------------
+
+// 增量更新的一种操作：每次调用更新batch个向量元素或batch行
+struct IncrementalCase {
+    const char* name;
+    bool rows;
+    int batch;
+};
+
+// 从state开始的伪随机序列，返回[0,1)
+double incremental_random(uint64_t& state) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double max_relative_error(const double* expected, const double* actual, int n) {
+    double worst = 0.0;
+    for (int j = 0; j < n; j++) {
+        double error = fabs(actual[j] - expected[j]) / (fabs(expected[j]) > 0.0 ? fabs(expected[j]) : 1.0);
+        if (error > worst) worst = error;
+    }
+    return worst;
+}
+
+// 增量更新测试：比较每次更新的代价与一次全量mulb，数据为[0,1)均匀分布(整数数据的修正没有舍入，看不出误差)
+// 计时期间关闭自动重算，均摊列按每n个更新重算一次(默认间隔)折算；
+// 误差为连续n个更新、不重算时相对于同一状态下全量mulb的最大相对误差，结果正确性检查重算后与mulb逐位一致
+void test_incremental_mul(int* sizes, int sizes_count, const char* output_file, const BenchOptions& options) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    BenchReport report(options);
+    
+    const IncrementalCase cases[] = {
+        {"vector", false, 1}, {"vector", false, 8}, {"vector", false, 64},
+        {"row", true, 1}, {"row", true, 8},
+    };
+    const int pool_rows = 64;   // 预先生成的新行，更新时轮流使用
+    const int stream = 4096;    // 预先生成的更新序列长度
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "矩阵大小,更新对象,每次调用更新数,每次调用(秒),每个更新(秒),mulb(秒),加速比,均摊重算后每个更新(秒),"
+             << "n次更新后最大相对误差,结果正确性";
+    write_bench_csv_header(out_file, "每次调用");
+    out_file << endl;
+    
+    // 控制台表头
+    cout << "\n增量矩阵向量乘法 (单次调用中位数, 加速比=mulb时间/每个更新的时间):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "规模\t对象\t批量\t每个更新(秒)\tmulb(秒)\t加速比\t\t均摊(秒)\t误差\t\t结果正确性" << endl;
+    
+    for (int s = 0; s < sizes_count; s++) {
+        int n = sizes[s];
+        IncrementalGemv gemv(n);
+        generate_uniform_data(gemv.matrix(), gemv.vector());
+        gemv.recompute();
+        
+        double* reference = new double[n];
+        BenchStats full = bench_run([&] { mulb(gemv.matrix(), gemv.vector(), reference); }, options);
+        report.add("incremental", "mulb", n, full);
+        
+        uint64_t state = (uint64_t)n;
+        int* indices = new int[stream];
+        double* values = new double[stream];
+        for (int k = 0; k < stream; k++) {
+            indices[k] = (int)(incremental_random(state) * n);
+            values[k] = incremental_random(state);
+        }
+        double* row_data = new double[(size_t)pool_rows * n];
+        const double* rows[pool_rows];
+        for (int r = 0; r < pool_rows; r++) {
+            for (int j = 0; j < n; j++) {
+                row_data[(size_t)r * n + j] = incremental_random(state);
+            }
+            rows[r] = row_data + (size_t)r * n;
+        }
+        
+        for (const IncrementalCase& c : cases) {
+            // 每次调用取更新序列的下一段，到末尾时回到开头；回到开头时所有值加1，
+            // 否则重放的值与vector中的当前值相同，delta为0的更新会跳过axpy，测得的时间偏低
+            int cursor = 0;
+            auto apply = [&] {
+                if (cursor + c.batch > stream) {
+                    for (int k = 0; k < stream; k++) {
+                        values[k] += 1.0;
+                    }
+                    cursor = 0;
+                }
+                if (!c.rows && c.batch == 1) gemv.update_vector(indices[cursor], values[cursor]);
+                else if (!c.rows) gemv.update_vector(indices + cursor, values + cursor, c.batch);
+                else if (c.batch == 1) gemv.update_row(indices[cursor], rows[cursor % pool_rows]);
+                else gemv.update_rows(indices + cursor, rows + cursor % (pool_rows - c.batch + 1), c.batch);
+                cursor += c.batch;
+            };
+            
+            gemv.set_recompute_interval(0);
+            BenchStats stats = bench_run(apply, options);
+            char kernel[64];
+            snprintf(kernel, sizeof(kernel), "%s_x%d", c.name, c.batch);
+            report.add("incremental", kernel, n, stats);
+            
+            // 从刚重算过的状态开始连续做n个更新，不重算，与全量mulb比较
+            gemv.recompute();
+            for (int done = 0; done < n; done += c.batch) {
+                apply();
+            }
+            mulb(gemv.matrix(), gemv.vector(), reference);
+            double drift = max_relative_error(reference, gemv.result(), n);
+            gemv.recompute();
+            bool correct = memcmp(reference, gemv.result(), (size_t)n * sizeof(double)) == 0;
+            gemv.set_recompute_interval(n);
+            
+            double per_update = stats.median / c.batch;
+            double speedup = full.median / per_update;
+            double amortized = per_update + full.median / n;
+            
+            // 输出结果到控制台
+            cout << n << "\t" << (c.rows ? "行" : "向量") << "\t" << c.batch << "\t"
+                 << scientific << setprecision(3) << per_update << "\t"
+                 << full.median << "\t"
+                 << fixed << setprecision(1) << speedup << "x\t\t"
+                 << scientific << setprecision(3) << amortized << "\t"
+                 << setprecision(2) << drift << "\t"
+                 << (correct ? "正确" : "错误")
+                 << endl;
+            
+            // 写入CSV文件
+            out_file << n << "," << (c.rows ? "行" : "向量") << "," << c.batch << ","
+                     << scientific << setprecision(6) << stats.median << ","
+                     << per_update << ","
+                     << full.median << ","
+                     << fixed << setprecision(3) << speedup << ","
+                     << scientific << setprecision(6) << amortized << ","
+                     << setprecision(3) << drift << fixed << ","
+                     << (correct ? "正确" : "错误");
+            write_bench_csv(out_file, stats);
+            out_file << endl;
+        }
+        
+        delete[] reference;
+        delete[] indices;
+        delete[] values;
+        delete[] row_data;
+    }
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    cout << "增量矩阵向量乘法测试结果已保存到: " << output_file << ", " << json_file << endl;
+}
+
+// ---------------- 融合A·x与Aᵀ·w ----------------
+
+// 融合测试：与basic相同的规模扫描，比较分两遍计算y = A·x和z = Aᵀ·w(矩阵读两遍)与一遍融合计算，
+// 单线程和多线程各一组；两种方式使用同一套SIMD内核，只差在矩阵读几遍。参考结果为标量分两遍计算，
+// 数据为generate_data的整数模式(加法顺序不影响结果)
+void test_fused_mul(int* sizes, int sizes_count, const char* output_file, MatrixLayout layout,
+                    const BenchOptions& options, int num_threads) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    BenchReport report(options);
+    RooflineReport roofline(options);
+    ThreadPool pool(num_threads);
+    // 矩阵、两个输入向量、参考结果和计算结果各两个，加上行划分的部分和，容量按最大规模一次预留
+    int max_n = 0;
+    for (int i = 0; i < sizes_count; i++) {
+        if (sizes[i] > max_n) max_n = sizes[i];
+    }
+    BufferArena arena(arena_matrix_bytes(max_n) + 6 * arena_array_bytes(max_n) +
+                      arena_array_bytes(partials_size(max_n, num_threads)), options.pages);
+    SimdLevel level = detect_simd_level();
+    GemvPairKernel ax = gemv_pair_kernel(level, PAIR_AX);
+    GemvPairKernel atw = gemv_pair_kernel(level, PAIR_ATW);
+    GemvPairKernel fused = gemv_pair_kernel(level, PAIR_FUSED);
+    
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    out_file << "# 内存池: " << arena.summary() << endl;
+    out_file << "矩阵大小,分两遍(秒),融合(秒),多线程分两遍(秒),多线程融合(秒),融合加速比,多线程融合加速比,"
+             << "分两遍读写(MB),融合读写(MB),节省读写(%),分两遍带宽(GB/s),融合带宽(GB/s),多线程融合带宽(GB/s),"
+             << "线程数,结果正确性,存储布局";
+    write_bench_csv_header(out_file, "分两遍");
+    write_bench_csv_header(out_file, "融合");
+    write_bench_csv_header(out_file, "多线程分两遍");
+    write_bench_csv_header(out_file, "多线程融合");
+    write_perf_csv_header(out_file, "分两遍");
+    write_perf_csv_header(out_file, "融合");
+    write_perf_csv_header(out_file, "多线程分两遍");
+    write_perf_csv_header(out_file, "多线程融合");
+    out_file << endl;
+    
+    // 控制台表头
+    cout << "\n融合A·x与Aᵀ·w性能比较 (单次调用中位数, SIMD=" << simd_level_name(level) << ", " << num_threads
+         << "线程, " << layout_name(layout) << "布局):" << endl;
+    cout << "计时: " << bench_options_summary(options) << endl;
+    cout << "屋顶线: " << machine_peaks_summary(roofline.peaks()) << endl;
+    cout << "内存池: " << arena.summary() << endl;
+    cout << "规模\t分两遍(秒)\t融合(秒)\t多线程分两遍(秒)\t多线程融合(秒)\t融合加速比\t多线程加速比\t结果正确性" << endl;
+    
+    for (int s = 0; s < sizes_count; s++) {
+        int n = sizes[s];
+        
+        arena.reset();
+        Matrix matrix = alloc_matrix(arena, n, layout);
+        double* w = arena.alloc(n);
+        double* x = arena.alloc(n);
+        double* y_ref = arena.alloc(n);
+        double* z_ref = arena.alloc(n);
+        double* y = arena.alloc(n);
+        double* z = arena.alloc(n);
+        double* partials = arena.alloc(partials_size(n, num_threads));
+        generate_data(matrix, w);
+        for (int j = 0; j < n; j++) {
+            x[j] = j % 3 + 1.0;
+        }
+        
+        // 先验证结果正确性（只需验证一次）
+        gemv_pair(gemv_pair_kernel(SIMD_SCALAR, PAIR_AX), PAIR_AX, matrix, x, nullptr, y_ref, nullptr);
+        gemv_pair(gemv_pair_kernel(SIMD_SCALAR, PAIR_ATW), PAIR_ATW, matrix, nullptr, w, nullptr, z_ref);
+        auto check = [&] {
+            bool ok = results_match(y_ref, y, n) && results_match(z_ref, z, n);
+            memset(y, 0, (size_t)n * sizeof(double));
+            memset(z, 0, (size_t)n * sizeof(double));
+            return ok;
+        };
+        gemv_pair(ax, PAIR_AX, matrix, x, nullptr, y, nullptr);
+        gemv_pair(atw, PAIR_ATW, matrix, nullptr, w, nullptr, z);
+        bool correct_separate = check();
+        gemv_pair(fused, PAIR_FUSED, matrix, x, w, y, z);
+        bool correct_fused = check();
+        gemv_pair_parallel(ax, PAIR_AX, matrix, x, nullptr, y, nullptr, pool, nullptr);
+        gemv_pair_parallel(atw, PAIR_ATW, matrix, nullptr, w, nullptr, z, pool, partials);
+        bool correct_separate_parallel = check();
+        gemv_pair_parallel(fused, PAIR_FUSED, matrix, x, w, y, z, pool, partials);
+        bool correct_fused_parallel = check();
+        
+        BenchStats separate = bench_run([&] {
+            gemv_pair(ax, PAIR_AX, matrix, x, nullptr, y, nullptr);
+            gemv_pair(atw, PAIR_ATW, matrix, nullptr, w, nullptr, z);
+        }, options);
+        BenchStats fused_stats = bench_run([&] { gemv_pair(fused, PAIR_FUSED, matrix, x, w, y, z); }, options);
+        BenchStats separate_parallel = bench_run([&] {
+            gemv_pair_parallel(ax, PAIR_AX, matrix, x, nullptr, y, nullptr, pool, nullptr);
+            gemv_pair_parallel(atw, PAIR_ATW, matrix, nullptr, w, nullptr, z, pool, partials);
+        }, options);
+        BenchStats fused_parallel = bench_run([&] {
+            gemv_pair_parallel(fused, PAIR_FUSED, matrix, x, w, y, z, pool, partials);
+        }, options);
+        RooflineWork two_pass_work = gemv_pair_work(n, 2);
+        RooflineWork fused_work = gemv_pair_work(n, 1);
+        const BenchStats* all[] = {&separate, &fused_stats, &separate_parallel, &fused_parallel};
+        const char* names[] = {"separate", "fused", "separate_parallel", "fused_parallel"};
+        for (int k = 0; k < 4; k++) {
+            report.add("fused", names[k], n, *all[k]);
+            roofline.add("fused", names[k], n, k % 2 == 0 ? two_pass_work : fused_work, all[k]->median);
+        }
+        
+        // 计算加速比、带宽和节省的读写量
+        double speedup = separate.median / fused_stats.median;
+        double speedup_parallel = separate_parallel.median / fused_parallel.median;
+        double saved = (1.0 - fused_work.bytes / two_pass_work.bytes) * 100;
+        
+        string correctness = "";
+        if (correct_separate && correct_fused && correct_separate_parallel && correct_fused_parallel) {
+            correctness = "正确";
+        } else {
+            correctness = "错误";
+            if (!correct_separate) correctness += "-分两遍";
+            if (!correct_fused) correctness += "-融合";
+            if (!correct_separate_parallel) correctness += "-多线程分两遍";
+            if (!correct_fused_parallel) correctness += "-多线程融合";
+        }
+        
+        // 输出结果到控制台
+        cout << n << "\t"
+             << scientific << setprecision(3) << separate.median << "\t"
+             << fused_stats.median << "\t"
+             << separate_parallel.median << "\t\t"
+             << fused_parallel.median << "\t\t"
+             << fixed << setprecision(2) << speedup << "x\t\t"
+             << speedup_parallel << "x\t\t"
+             << correctness << endl;
+        
+        // 写入CSV文件
+        out_file << n << ","
+                 << scientific << setprecision(6) << separate.median << ","
+                 << fused_stats.median << ","
+                 << separate_parallel.median << ","
+                 << fused_parallel.median << ","
+                 << fixed << setprecision(3) << speedup << ","
+                 << speedup_parallel << ","
+                 << two_pass_work.bytes / 1.0e6 << ","
+                 << fused_work.bytes / 1.0e6 << ","
+                 << saved << ","
+                 << two_pass_work.bytes / separate.median / 1.0e9 << ","
+                 << fused_work.bytes / fused_stats.median / 1.0e9 << ","
+                 << fused_work.bytes / fused_parallel.median / 1.0e9 << ","
+                 << num_threads << ","
+                 << correctness << ","
+                 << layout_name(layout);
+        for (int k = 0; k < 4; k++) {
+            write_bench_csv(out_file, *all[k]);
+        }
+        for (int k = 0; k < 4; k++) {
+            write_perf_csv(out_file, all[k]->counters, n);
+        }
+        out_file << endl;
+    }
+    
+    report.write_csv_note(out_file);
+    out_file.close();
+    string json_file = json_path_for(output_file);
+    report.write_json(json_file.c_str());
+    string roofline_file = roofline_path_for(output_file);
+    roofline.write_csv(roofline_file.c_str());
+    cout << "融合矩阵乘法测试结果已保存到: " << output_file << ", " << json_file << ", " << roofline_file << endl;
+}
+
+// ---------------- 常驻服务 ----------------
+
+// 服务和stream模式使用的矩阵规模：给出file时由文件大小决定(n x n个原始double，按行存放)，
+// 文件不存在或大小不是n x n个double时返回0
+int server_matrix_n(const char* file, int n) {
+    if (file == nullptr) return n;
+    size_t count = file_size(file) / sizeof(double);
+    size_t side = (size_t)sqrt((double)count);
+    while (side * side > count) side--;
+    while ((side + 1) * (side + 1) <= count) side++;
+    return side > 0 && side * side == count && file_size(file) == count * sizeof(double) ? (int)side : 0;
+}
+
+// 按行读入矩阵文件(文件行距为n，内存中按填充后的行距存放)
+bool load_matrix_file(const char* file, Matrix& matrix) {
+    ifstream in(file, ios::binary);
+    if (!in.is_open()) return false;
+    for (int i = 0; i < matrix.n; i++) {
+        in.read(reinterpret_cast<char*>(matrix.row(i)), (size_t)matrix.n * sizeof(double));
+    }
+    return (bool)in;
+}
+
+volatile sig_atomic_t serve_stop = 0;
+
+void handle_serve_signal(int) {
+    serve_stop = 1;
+}
+
+// 常驻服务：矩阵放在内存池中(大页、预先触摸)只加载一次，然后一直运行到收到SIGINT/SIGTERM；
+// 每10秒打印一次这段时间的请求数、平均批量和计算线程的忙碌比例
+int run_server_mul(const char* socket_path, const char* file, int n, const GemvServerOptions& options,
+                   PageBacking pages) {
+    if (file == nullptr && n <= 0) {
+        cout << "--serve-n必须为正数" << endl;
+        return 1;
+    }
+    n = server_matrix_n(file, n);
+    if (n <= 0) {
+        cout << "矩阵文件不存在或大小不是n x n个double: " << file << endl;
+        return 1;
+    }
+    BufferArena arena(arena_matrix_bytes(n), pages);
+    Matrix matrix = arena_matrix(arena, n);
+    if (file != nullptr) {
+        if (!load_matrix_file(file, matrix)) {
+            cout << "无法读取矩阵文件: " << file << endl;
+            return 1;
+        }
+    } else {
+        double* unused = new double[n];
+        generate_data(matrix, unused);
+        delete[] unused;
+    }
+
+    GemvServer server(matrix, file == nullptr, options);
+    if (!server.start(socket_path)) {
+        cout << "无法在" << socket_path << "上监听: " << server.error() << endl;
+        return 1;
+    }
+    signal(SIGINT, handle_serve_signal);
+    signal(SIGTERM, handle_serve_signal);
+    cout << "\n矩阵向量乘法服务: " << socket_path << " (" << n << "x" << n << ", "
+         << (file != nullptr ? file : "generate_data") << ")" << endl;
+    cout << "内存池: " << arena.summary() << endl;
+    cout << "计算线程" << options.threads << "个, 最大批量" << options.max_batch << ", 批处理窗口"
+         << options.batch_window_us << "微秒; Ctrl-C停止" << endl;
+
+    GemvServerStats last = server.stats();
+    auto last_time = chrono::steady_clock::now();
+    while (!serve_stop) {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - last_time).count();
+        if (elapsed < 10.0) continue;
+        GemvServerStats now = server.stats();
+        long long requests = now.requests - last.requests;
+        long long batches = now.batches - last.batches;
+        if (requests > 0) {
+            cout << fixed << setprecision(1) << "请求" << requests << "个 (" << requests / elapsed << "/秒), 连接"
+                 << now.connections << "个, 平均批量" << setprecision(2) << (double)requests / batches
+                 << ", 计算忙碌" << setprecision(1) << (now.compute_seconds - last.compute_seconds) / elapsed * 100
+                 << "%" << endl;
+        }
+        last = now;
+        last_time = chrono::steady_clock::now();
+    }
+
+    server.stop();
+    GemvServerStats total = server.stats();
+    cout << "服务已停止，共应答" << total.requests << "个请求，遍历矩阵" << total.batches << "次" << endl;
+    return 0;
+}
+
+// 服务负载测试：本地启动服务(每个批处理窗口 x 客户端数各启动一次)，用闭环客户端施加负载，
+// 输出吞吐量、有效GFLOP/s、平均批量和延迟分位数；延迟为客户端测得的往返时间，包含排队、批处理等待和计算
+// external_socket不为空时改为压测该地址上已运行的服务，窗口和批量由那个服务决定，服务端统计列留空
+void test_server_mul(const char* external_socket, int n, const vector<int>& windows, const vector<int>& clients,
+                     double seconds, const GemvServerOptions& base, const BenchOptions& bench_options,
+                     const char* output_file) {
+    ofstream out_file(output_file);
+    if (!out_file.is_open()) {
+        cout << "无法创建文件: " << output_file << endl;
+        return;
+    }
+    const char* local_socket = "matrix_vector_loadgen.sock";
+    double warmup = seconds * 0.2;
+
+    // 外部服务的规模和矩阵来源由握手得知
+    bool generated = true;
+    if (external_socket != nullptr) {
+        GemvHello hello;
+        int fd = gemv_connect(external_socket, hello);
+        if (fd < 0) {
+            cout << "无法连接到服务: " << external_socket << endl;
+            return;
+        }
+        close(fd);
+        n = (int)hello.n;
+        generated = (hello.flags & GEMV_HELLO_GENERATED) != 0;
+    }
+
+    // 外部服务只测一次，窗口记为-1
+    vector<int> sweep_windows = external_socket == nullptr ? windows : vector<int>(1, -1);
+    BufferArena arena(external_socket == nullptr ? arena_matrix_bytes(n) : 0, bench_options.pages);
+    Matrix matrix;
+    double* vector = new double[n];
+    double* expected = new double[n];
+    for (int i = 0; i < n; i++) {
+        vector[i] = i % 5 + 1.0;
+    }
+    stream_expected_result(n, expected);
+    if (external_socket == nullptr) {
+        matrix = arena_matrix(arena, n);
+        generate_data(matrix, vector);
+    }
+
+    // 写入CSV文件头
+    write_topology_header(out_file);
+    if (external_socket == nullptr) out_file << "# 内存池," << arena.summary() << endl;
+    out_file << "矩阵大小,批处理窗口(微秒),最大批量,计算线程数,客户端数,请求数,吞吐量(请求/秒),有效GFLOP/s,"
+             << "平均批量,P50延迟(微秒),P90延迟(微秒),P99延迟(微秒),最大延迟(微秒),计算忙碌(%),结果正确性" << endl;
+
+    // 控制台表头
+    cout << "\n矩阵向量乘法服务负载测试 (" << n << "x" << n << ", 每个配置" << seconds << "秒, 另预热" << warmup << "秒, "
+         << (external_socket != nullptr ? external_socket : "本地启动服务") << "):" << endl;
+    if (external_socket == nullptr) {
+        double* result = new double[n];
+        mulb(matrix, vector, result);
+        double single = bench_run([&] { mulb(matrix, vector, result); }, bench_options).median;
+        cout << "内存池: " << arena.summary() << endl;
+        cout << "单次mulb约" << fixed << setprecision(1) << single * 1e6 << "微秒, 计算线程" << base.threads
+             << "个, 最大批量" << base.max_batch << endl;
+        delete[] result;
+    }
+    cout << "窗口(微秒)\t客户端\t请求/秒\t\tGFLOP/s\t平均批量\tP50(微秒)\tP99(微秒)\t最大(微秒)\t结果正确性" << endl;
+
+    for (int window : sweep_windows) {
+        for (int c : clients) {
+            GemvServerOptions options = base;
+            options.batch_window_us = window;
+            GemvServer* server = nullptr;
+            const char* path = external_socket;
+            if (external_socket == nullptr) {
+                server = new GemvServer(matrix, true, options);
+                path = local_socket;
+                if (!server->start(path)) {
+                    cout << "无法启动服务: " << server->error() << endl;
+                    delete server;
+                    break;
+                }
+            }
+            GemvLoadResult load = run_gemv_load(path, c, warmup, seconds, vector, generated ? expected : nullptr);
+            GemvServerStats stats;
+            if (server != nullptr) {
+                server->stop();
+                stats = server->stats();
+                delete server;
+            }
+            if (!load.ok || load.requests == 0) {
+                cout << (window >= 0 ? to_string(window) : "-") << "\t\t" << c << "\t"
+                     << (load.ok ? "没有完成的请求" : load.error) << "，跳过" << endl;
+                continue;
+            }
+
+            sort(load.latencies.begin(), load.latencies.end());
+            double throughput = load.requests / load.seconds;
+            double gflops = throughput * 2.0 * n * n / 1.0e9;
+            double p50 = percentile_sorted(load.latencies, 0.5) * 1e6;
+            double p90 = percentile_sorted(load.latencies, 0.9) * 1e6;
+            double p99 = percentile_sorted(load.latencies, 0.99) * 1e6;
+            double worst = load.latencies.back() * 1e6;
+            // 服务端统计覆盖预热和计量两段
+            double mean_batch = stats.batches > 0 ? (double)stats.requests / stats.batches : 0.0;
+            double busy = stats.compute_seconds / (warmup + seconds) * 100;
+            const char* correct = !generated ? "-" : load.correct ? "正确" : "错误";
+
+            // 输出结果到控制台
+            cout << (window >= 0 ? to_string(window) : "-") << "\t\t" << c << "\t"
+                 << fixed << setprecision(1) << throughput << "\t\t"
+                 << setprecision(2) << gflops << "\t";
+            if (server != nullptr) cout << mean_batch;
+            else cout << "-";
+            cout << "\t\t" << setprecision(1) << p50 << "\t\t" << p99 << "\t\t" << worst << "\t\t" << correct << endl;
+
+            // 写入CSV文件
+            out_file << n << ",";
+            if (window >= 0) out_file << window << "," << options.max_batch << "," << options.threads;
+            else out_file << ",,";
+            out_file << "," << c << "," << load.requests << ","
+                     << fixed << setprecision(1) << throughput << ","
+                     << setprecision(3) << gflops << ",";
+            if (window >= 0) out_file << mean_batch;
+            out_file << "," << setprecision(1) << p50 << "," << p90 << "," << p99 << "," << worst << ",";
+            if (window >= 0) out_file << busy;
+            out_file << "," << correct << endl;
+        }
+    }
+
+    delete[] vector;
+    delete[] expected;
+
+    out_file.close();
+    cout << "服务负载测试结果已保存到: " << output_file << endl;
+}
+
+// run模式的内核注册表：第一个为参考内核(平凡算法mula)，新内核在这里登记一行即可参与按命令行选择的测试
+// 只登记直接以Matrix为输入的内核；转置、稀疏和混合精度格式需要预先转换的内核仍由各自的模式测试
+KernelRegistry build_gemv_registry() {
+    KernelRegistry registry;
+    registry.kind = KERNEL_GEMV;
+    registry.default_output = "zixuan_matrix.csv";
+    registry.fill_matrix = generate_data;
+
+    auto serial = [&](const char* name, const char* description, UnrolledGemvKernel kernel) {
+        KernelEntry entry;
+        entry.name = name;
+        entry.description = description;
+        entry.call = [kernel](const KernelArgs& a) {
+            kernel(*a.matrix, a.vector, a.result);
+            return 0.0;
+        };
+        registry.add(entry);
+    };
+    serial("mula", "平凡算法", mula);
+    serial("mulb", "Cache优化", mulb);
+    serial("mulc", "4路展开", mulc);
+    serial("muld", "8路展开", muld);
+    for (const UnrolledGemv& config : gemv_unroll_grid()) {
+        string name = "unroll" + to_string(config.unroll) + "x" + to_string(config.accumulators);
+        string description = to_string(config.unroll) + "行展开" + to_string(config.accumulators) + "条链";
+        serial(name.c_str(), description.c_str(), config.kernel);
+    }
+    if (simd_supported(SIMD_AVX2)) serial("axpy_avx2", "AVX2行累加", gemv_axpy_kernel(SIMD_AVX2));
+    if (simd_supported(SIMD_AVX512)) serial("axpy_avx512", "AVX-512行累加", gemv_axpy_kernel(SIMD_AVX512));
+    serial("tiled", "缓存分块(本机参数)", mul_tiled_auto);
+
+    // 融合内核一遍同时算A·x和Aᵀ·v，Aᵀ·v写入result与参考内核比较，A·x写在scratch里
+    KernelEntry fused;
+    fused.name = "fused";
+    fused.description = "一遍融合A·x与Aᵀ·v";
+    fused.call = [](const KernelArgs& a) {
+        gemv_fused_simd(*a.matrix, a.vector, a.vector, (double*)a.scratch, a.result);
+        return 0.0;
+    };
+    fused.scratch_bytes = [](int n, int) { return (size_t)n * sizeof(double); };
+    fused.work = [](long long n) { return gemv_pair_work(n, 1); };
+    registry.add(fused);
+    fused.name = "fused_parallel";
+    fused.description = "多线程一遍融合A·x与Aᵀ·v";
+    fused.call = [](const KernelArgs& a) {
+        static GemvPairKernel kernel = gemv_pair_kernel(detect_simd_level(), PAIR_FUSED);
+        double* y = (double*)a.scratch;
+        gemv_pair_parallel(kernel, PAIR_FUSED, *a.matrix, a.vector, a.vector, y, a.result, *a.pool,
+                           y + padded_ld(a.matrix->n));
+        return 0.0;
+    };
+    fused.threaded = true;
+    fused.scratch_bytes = [](int n, int threads) {
+        return (padded_ld(n) + partials_size(n, threads)) * sizeof(double);
+    };
+    registry.add(fused);
+
+    KernelEntry parallel;
+    parallel.name = "parallel";
+    parallel.description = "多线程Cache优化(自动划分)";
+    parallel.call = [](const KernelArgs& a) {
+        mulb_parallel(*a.matrix, a.vector, a.result, *a.pool, (double*)a.scratch);
+        return 0.0;
+    };
+    parallel.threaded = true;
+    parallel.scratch_bytes = [](int n, int threads) { return partials_size(n, threads) * sizeof(double); };
+    registry.add(parallel);
+    return registry;
+}
+
+// 用法: matrix_vector [basic] [advanced] [layout] [parallel] [simd] [tiled] [batch] [stream] [sparse] [mixed] [run]
+//                     [incremental] [fused] [serve] [loadgen]
+//                     [--layout=contiguous|legacy] [--threads=N] [--simd=scalar|avx2|avx512]
+//                     stream模式: [--file=路径 | --stream-n=16384] [--io=mmap,pread,direct] [--panel-kb=8192]
+//                     sparse模式: [--mtx=Matrix Market文件] [--threads=N]
+//                     serve模式: [--socket=matrix_vector.sock] [--serve-n=1024 | --file=路径] [--threads=N]
+//                                [--max-batch=32] [--batch-us=100] [--pages=4k|thp|2m|1g]
+//                     loadgen模式: [--socket=已运行的服务] [--serve-n=1024] [--clients=1,2,4,8,16]
+//                                  [--batch-us=0,100,500] [--max-batch=32] [--threads=N] [--duration=1]
+//                     run模式: [--list] [--kernels=mula,axpy_avx512,...] [--sizes=500:1500:100] [--threads=1,2,4]
+//                              [--runs=N] [--pages=4k,2m] [--out=zixuan_matrix.csv] [--roofline=0]
+//                     basic/advanced计时: [--warmup=3] [--min-runs=5] [--max-runs=1000] [--ci=0.01]
+//                                         [--max-seconds=0.5] [--pin=CPU] [--clock=tsc|clock] [--counters=1|0]
+//                                         [--pages=4k|thp|2m|1g]
+// 不指定模式时运行basic和advanced
+int main(int argc, char** argv) {
+    srand(time(NULL));
+    
+    // 缓存临界点按本机检测到的缓存大小计算，而不是写死的250/1000/1420
+    const CacheTopology& topo = cache_topology();
+    
+    // 定义测试规模，各模式的重复次数由bench_run按置信区间自适应决定
+    vector<int> test_sizes;
+    
+    for (int i = 1; i <= 10; i += 1) {
+        test_sizes.push_back(i);
+    }
+    // 超小矩阵 - 从11到100，步长4
+    for (int i = 11; i <= 100; i += 4) {
+        test_sizes.push_back(i);
+    }
+    
+    // 小矩阵 - 从110到200，步长10
+    for (int i = 110; i <= 200; i += 10) {
+        test_sizes.push_back(i);
+    }
+    
+    // 中小矩阵 - 从280到500，步长20
+    for (int i = 280; i <= 500; i += 20) {
+        test_sizes.push_back(i);
+    }
+    
+    // 中等矩阵 - 从550到800，步长20
+    for (int i = 550; i <= 800; i += 20) {
+        test_sizes.push_back(i);
+    }
+    
+    // 大矩阵 - 步长50，至少到1700；L3更大时延伸到L3临界点的1.2倍
+    int max_n = 1700;
+    int l3_n = matrix_boundary(topo, 3);
+    if (l3_n * 6 / 5 > max_n) max_n = l3_n * 6 / 5;
+    for (int i = 850; i <= max_n; i += 50) {
+        test_sizes.push_back(i);
+    }
+    
+    // 各级缓存临界点：n x n矩阵恰好填满该级缓存时的n，附近±4%细粒度采样
+    for (int level = 1; level <= 3; level++) {
+        int boundary = matrix_boundary(topo, level);
+        if (boundary > 0) {
+            add_samples_around(test_sizes, boundary, 0.04, 20);
+        }
+    }
+    sort_unique(test_sizes);
+    
+    // 将vector转换为数组
+    int sizes_count = test_sizes.size();
+    int* sizes = new int[sizes_count];
+    for (int i = 0; i < sizes_count; i++) {
+        sizes[i] = test_sizes[i];
+    }
+
+    cout << "========== 矩阵向量乘法性能优化测试 ==========" << endl;
+    cout << "优化测试规模方案，专注于缓存临界点，共" << sizes_count << "个规模点" << endl;
+    cout << "缓存拓扑: " << topology_summary(topo) << endl;
+    cout << "L1缓存临界点(~" << matrix_boundary(topo, 1) << "), L2缓存临界点(~" << matrix_boundary(topo, 2)
+         << "), L3缓存临界点(~" << matrix_boundary(topo, 3) << ")" << endl;
+
+    MatrixLayout layout = strcmp(get_option(argc, argv, "layout", "contiguous"), "legacy") == 0
+                              ? LAYOUT_LEGACY : LAYOUT_CONTIGUOUS;
+    // 按命令行选择内核和规模，只运行这一项
+    if (has_mode(argc, argv, "run")) {
+        int status = run_registry(build_gemv_registry(), test_sizes, argc, argv);
+        delete[] sizes;
+        return status;
+    }
+
+    // 常驻服务：一直运行到收到SIGINT/SIGTERM
+    int server_threads = atoi(get_option(argc, argv, "threads", "0"));
+    GemvServerOptions server_options;
+    server_options.threads = server_threads > 0 ? server_threads : (int)allowed_cpus().size();
+    server_options.max_batch = atoi(get_option(argc, argv, "max-batch", "32"));
+    server_options.batch_window_us = atoi(get_option(argc, argv, "batch-us", "100"));
+    int serve_n = atoi(get_option(argc, argv, "serve-n", "1024"));
+    if (has_mode(argc, argv, "serve")) {
+        PageBacking pages = bench_options_from_cli(argc, argv).pages;
+        int status = run_server_mul(get_option(argc, argv, "socket", "matrix_vector.sock"),
+                                    get_option(argc, argv, "file", nullptr), serve_n, server_options, pages);
+        delete[] sizes;
+        return status;
+    }
+
+    bool run_default = !any_mode(argc, argv);
+    BenchOptions bench_options = bench_options_from_cli(argc, argv);
+
+    // 测试基础算法：平凡算法vs缓存优化
+    if (run_default || has_mode(argc, argv, "basic")) {
+        test_basic_mul(sizes, sizes_count, "jichu_matrix.csv", layout, bench_options);
+    }
+    
+    // 测试进阶算法：平凡算法vs循环展开
+    if (run_default || has_mode(argc, argv, "advanced")) {
+        test_advanced_mul(sizes, sizes_count, "jinjie_matrix.csv", layout, bench_options);
+    }
+    
+    // 存储布局对比：旧布局vs连续对齐布局
+    if (has_mode(argc, argv, "layout")) {
+        test_layout_mul(sizes, sizes_count, "layout_matrix.csv", bench_options);
+    }
+    
+    // 多线程扩展性：扫描线程数，输出加速比和并行效率
+    if (has_mode(argc, argv, "parallel")) {
+        int max_threads = atoi(get_option(argc, argv, "threads", "0"));
+        if (max_threads <= 0) max_threads = (int)allowed_cpus().size();
+        test_parallel_mul(sizes, sizes_count, "bingxing_matrix.csv", layout, max_threads, bench_options);
+    }
+    
+    // SIMD微内核：行累加与转置点积，--simd限制可使用的最宽指令集
+    if (has_mode(argc, argv, "simd")) {
+        const char* simd = get_option(argc, argv, "simd", "");
+        SimdLevel level = detect_simd_level();
+        if (strcmp(simd, "scalar") == 0) level = SIMD_SCALAR;
+        else if (strcmp(simd, "avx2") == 0) level = SIMD_AVX2;
+        else if (strcmp(simd, "avx512") == 0) level = SIMD_AVX512;
+        test_simd_mul(sizes, sizes_count, "simd_matrix.csv", layout, level, bench_options);
+    }
+    
+    // 二维分块：分块大小由本机缓存大小决定
+    if (has_mode(argc, argv, "tiled")) {
+        test_tiled_mul(sizes, sizes_count, "tiled_matrix.csv", layout, bench_options);
+    }
+    
+    // 批量矩阵向量乘法：k=1..64，只在各级缓存临界点和L3之外的一个规模上测试
+    if (has_mode(argc, argv, "batch")) {
+        int batch_sizes[4];
+        int batch_sizes_count = 0;
+        for (int level = 1; level <= 3; level++) {
+            int boundary = matrix_boundary(topo, level);
+            if (boundary >= 16) batch_sizes[batch_sizes_count++] = boundary;
+        }
+        batch_sizes[batch_sizes_count++] = max_n;
+        test_batch_mul(batch_sizes, batch_sizes_count, "batch_matrix.csv", layout, bench_options);
+    }
+    
+    // 稀疏矩阵向量乘法：CSR/ELLPACK/SELL-C-σ，可额外测试一个Matrix Market文件
+    if (has_mode(argc, argv, "sparse")) {
+        int max_threads = atoi(get_option(argc, argv, "threads", "0"));
+        if (max_threads <= 0) max_threads = (int)allowed_cpus().size();
+        test_sparse_mul("xishu_matrix.csv", max_threads, get_option(argc, argv, "mtx", nullptr), bench_options);
+    }
+    
+    // 外存矩阵向量乘法：给出--file时规模由文件大小决定(必须恰好是n x n个double)，
+    // 否则按--stream-n生成临时矩阵文件，测完删除
+    if (has_mode(argc, argv, "stream")) {
+        int stream_n = atoi(get_option(argc, argv, "stream-n", "16384"));
+        const char* path = get_option(argc, argv, "file", nullptr);
+        bool generated = path == nullptr;
+        if (!generated) {
+            stream_n = server_matrix_n(path, stream_n);
+            if (stream_n <= 0) {
+                cout << "矩阵文件不存在或大小不是n x n个double: " << path << endl;
+            }
+        } else if (stream_n <= 0) {
+            cout << "--stream-n必须为正数" << endl;
+        } else {
+            path = "matrix_vector_stream.bin";
+            cout << "生成测试矩阵文件 " << path << " (" << stream_n << "x" << stream_n << ")..." << endl;
+            if (!write_matrix_file(path, stream_n)) {
+                cout << "无法创建文件: " << path << endl;
+                stream_n = 0;
+            }
+        }
+        
+        vector<StreamIo> ios;
+        for (const string& item : split_list(get_option(argc, argv, "io", "mmap,pread,direct"))) {
+            if (item == "mmap") ios.push_back(IO_MMAP);
+            else if (item == "pread") ios.push_back(IO_PREAD);
+            else if (item == "direct") ios.push_back(IO_DIRECT);
+        }
+        size_t panel_bytes = (size_t)atoll(get_option(argc, argv, "panel-kb", "8192")) * 1024;
+        if (stream_n > 0) {
+            test_stream_mul(path, stream_n, generated, ios, panel_bytes, bench_options, "liushi_matrix.csv");
+        }
+        if (generated && path != nullptr) remove(path);
+    }
+    
+    // 混合精度存储：在各级缓存临界点、max_n和两倍L3临界点上比较五种存储格式
+    if (has_mode(argc, argv, "mixed")) {
+        vector<int> mixed_sizes;
+        for (int level = 1; level <= 3; level++) {
+            int boundary = matrix_boundary(topo, level);
+            if (boundary >= 16) mixed_sizes.push_back(boundary);
+        }
+        mixed_sizes.push_back(max_n);
+        if (l3_n > 0) mixed_sizes.push_back(l3_n * 2);
+        sort_unique(mixed_sizes);
+        test_mixed_mul(mixed_sizes.data(), (int)mixed_sizes.size(), "hunhe_matrix.csv", bench_options);
+    }
+    
+    // 融合A·x与Aᵀ·w：与basic相同的规模扫描，单线程和多线程各比较分两遍与一遍融合
+    if (has_mode(argc, argv, "fused")) {
+        int fused_threads = atoi(get_option(argc, argv, "threads", "0"));
+        if (fused_threads <= 0) fused_threads = (int)allowed_cpus().size();
+        test_fused_mul(sizes, sizes_count, "ronghe_matrix.csv", layout, bench_options, fused_threads);
+    }
+    
+    // 增量更新：在各级缓存临界点和max_n上比较每次更新与全量mulb的代价
+    if (has_mode(argc, argv, "incremental")) {
+        vector<int> incremental_sizes;
+        for (int level = 1; level <= 3; level++) {
+            int boundary = matrix_boundary(topo, level);
+            if (boundary >= 16) incremental_sizes.push_back(boundary);
+        }
+        incremental_sizes.push_back(max_n);
+        sort_unique(incremental_sizes);
+        test_incremental_mul(incremental_sizes.data(), (int)incremental_sizes.size(), "zengliang_matrix.csv",
+                             bench_options);
+    }
+    
+    // 服务负载测试：扫描批处理窗口和客户端数；给出--socket时压测已运行的服务
+    if (has_mode(argc, argv, "loadgen")) {
+        vector<int> windows;
+        for (const string& item : split_list(get_option(argc, argv, "batch-us", "0,100,500"))) {
+            windows.push_back(atoi(item.c_str()));
+        }
+        vector<int> clients;
+        if (!parse_size_list(get_option(argc, argv, "clients", "1,2,4,8,16"), clients)) {
+            clients = {1};
+        }
+        double seconds = atof(get_option(argc, argv, "duration", "1"));
+        if (get_option(argc, argv, "socket", nullptr) == nullptr && serve_n <= 0) {
+            cout << "--serve-n必须为正数" << endl;
+            delete[] sizes;
+            return 1;
+        }
+        test_server_mul(get_option(argc, argv, "socket", nullptr), serve_n, windows, clients,
+                        seconds > 0 ? seconds : 1.0, server_options, bench_options, "fuwu_matrix.csv");
+    }
     
     // 释放动态分配的内存
     delete[] sizes;
-    delete[] counts;
     
     return 0;
 }
\ No newline at end of file
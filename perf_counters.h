@@ -0,0 +1,242 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 用perf_event_open统计内核调用期间的硬件事件(只计用户态)
+// 事件优先放在一个计数器组中同时启停，读数之间可以直接相比；组内事件多于PMU可用的计数器时内核不会拆开组，
+// 整个组从不被调度(time_running为0)，探测时发现这种情况就改为每个事件单独成组，由内核分时复用，
+// 各自按time_enabled/time_running放大。运行中没有被调度的段(计数器被其他perf用户或NMI watchdog占用)被丢弃，
+// 平均值只除以被调度的段内的调用次数；整次测量都没有被调度时读数标记为不可用，段数计入unscheduled；
+// 打不开的事件(容器、虚拟机无PMU、CPU不支持该事件)标记为不可用，对应的CSV列留空
+
+enum PerfEvent {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,      // L1D读缺失
+    PERF_LLC_MISSES,      // 末级缓存读缺失
+    PERF_DTLB_MISSES,     // dTLB读缺失
+    PERF_STALLED_CYCLES,  // 后端停顿周期(很多Intel CPU不提供该通用事件)
+    PERF_EVENT_COUNT
+};
+
+inline const char* perf_event_name(PerfEvent event) {
+    switch (event) {
+        case PERF_CYCLES: return "cycles";
+        case PERF_INSTRUCTIONS: return "instructions";
+        case PERF_L1D_MISSES: return "l1d_misses";
+        case PERF_LLC_MISSES: return "llc_misses";
+        case PERF_DTLB_MISSES: return "dtlb_misses";
+        case PERF_STALLED_CYCLES: return "stalled_cycles";
+        default: return "unknown";
+    }
+}
+
+// 每次调用的平均事件数，valid[e]为false表示该事件不可用
+struct PerfCounts {
+    bool valid[PERF_EVENT_COUNT] = {};
+    double value[PERF_EVENT_COUNT] = {};
+    int unscheduled = 0;  // 计数器组没有被调度、读数被丢弃的段数
+
+    bool any() const {
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            if (valid[e]) return true;
+        }
+        return false;
+    }
+};
+
+inline void perf_event_attr_for(PerfEvent event, perf_event_attr& attr) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    auto cache_miss = [](uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    switch (event) {
+        case PERF_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_miss(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case PERF_LLC_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_miss(PERF_COUNT_HW_CACHE_LL);
+            break;
+        case PERF_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+            break;
+        default:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+            break;
+    }
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+}
+
+// 当前线程上的计数器：split为false时所有事件在一个组中(第一个能打开的事件作为组长)，为true时每个事件单独成组
+class PerfCounterGroup {
+public:
+    explicit PerfCounterGroup(bool split) {
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            fds_[e] = -1;
+        }
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            int leader = !split && groups_ > 0 ? leaders_[0] : -1;
+            perf_event_attr attr;
+            perf_event_attr_for((PerfEvent)e, attr);
+            if (leader >= 0) attr.disabled = 0;  // 组员随组长启停
+            int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fd < 0) {
+                if (first_errno_ == 0) first_errno_ = errno;
+                continue;
+            }
+            fds_[e] = fd;
+            int g = leader >= 0 ? 0 : groups_++;
+            if (leader < 0) leaders_[g] = fd;
+            order_[g][members_[g]++] = e;
+        }
+    }
+
+    ~PerfCounterGroup() {
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            if (fds_[e] >= 0) close(fds_[e]);
+        }
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    bool available() const { return groups_ > 0; }
+
+    // 第一个打不开的事件的errno(ENOENT: 无PMU或不支持该事件，EACCES/EPERM: perf_event_paranoid限制)
+    int error() const { return first_errno_; }
+
+    void start() {
+        for (int g = 0; g < groups_; g++) {
+            ioctl(leaders_[g], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    // 停止计数并把本段的读数累加到totals，calls为本段内的调用次数；没有被调度的组只记入unscheduled
+    void stop(long long calls) {
+        for (int g = 0; g < groups_; g++) {
+            ioctl(leaders_[g], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+        for (int g = 0; g < groups_; g++) {
+            uint64_t buffer[3 + PERF_EVENT_COUNT];
+            ssize_t got = read(leaders_[g], buffer, sizeof(buffer));
+            ioctl(leaders_[g], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            if (got < (ssize_t)(3 * sizeof(uint64_t)) || (int)buffer[0] != members_[g]) continue;
+            if (buffer[2] == 0) {
+                unscheduled_++;
+                continue;
+            }
+            // 被复用时按运行时间比例放大
+            double scale = buffer[2] < buffer[1] ? (double)buffer[1] / buffer[2] : 1.0;
+            for (int k = 0; k < members_[g]; k++) {
+                int e = order_[g][k];
+                totals_[e] += buffer[3 + k] * scale;
+                calls_[e] += calls;
+            }
+        }
+    }
+
+    // 每个事件的累计读数除以该事件被调度的段内的调用次数，并清零累计值
+    PerfCounts take() {
+        PerfCounts counts;
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            counts.valid[e] = fds_[e] >= 0 && calls_[e] > 0;
+            counts.value[e] = counts.valid[e] ? totals_[e] / calls_[e] : 0.0;
+            totals_[e] = 0.0;
+            calls_[e] = 0;
+        }
+        counts.unscheduled = unscheduled_;
+        unscheduled_ = 0;
+        return counts;
+    }
+
+private:
+    int fds_[PERF_EVENT_COUNT];
+    int leaders_[PERF_EVENT_COUNT] = {};
+    int order_[PERF_EVENT_COUNT][PERF_EVENT_COUNT] = {};  // 第g组内第k个读数对应的事件
+    int members_[PERF_EVENT_COUNT] = {};
+    int groups_ = 0;
+    int first_errno_ = 0;
+    int unscheduled_ = 0;
+    long long calls_[PERF_EVENT_COUNT] = {};
+    double totals_[PERF_EVENT_COUNT] = {};
+};
+
+// 只探测一次：能否打开计数器，第一个打不开的事件的errno(全部能打开时为0)，
+// 以及合在一个组里时能否被调度(不能时split为true，之后的测量每个事件单独成组)
+struct PerfProbe {
+    bool available;
+    int error;
+    bool split;
+};
+
+inline const PerfProbe& perf_probe() {
+    static const PerfProbe probe = [] {
+        PerfCounterGroup group(false);
+        if (!group.available()) return PerfProbe{false, group.error(), false};
+        group.start();
+        volatile double sink = 0.0;
+        for (int i = 0; i < 100000; i++) {
+            sink = sink + i;
+        }
+        group.stop(1);
+        PerfCounts counts = group.take();
+        return PerfProbe{true, group.error(), !counts.any() && counts.unscheduled > 0};
+    }();
+    return probe;
+}
+
+inline bool perf_counters_available() {
+    return perf_probe().available;
+}
+
+// ---------------- 输出 ----------------
+
+// CSV中每个内核的计数器派生列：IPC、每元素的L1D/LLC/dTLB缺失数、后端停顿周期占比
+inline void write_perf_csv_header(std::ostream& out, const char* name) {
+    out << "," << name << "IPC," << name << "L1D缺失/元素," << name << "LLC缺失/元素,"
+        << name << "dTLB缺失/元素," << name << "停顿周期占比";
+}
+
+// elements为每次调用处理的元素数(数组长度或n*n)，不可用的列留空
+inline void write_perf_csv(std::ostream& out, const PerfCounts& counts, double elements) {
+    char buffer[64];
+    auto cell = [&](bool valid, double value) {
+        out << ",";
+        if (!valid) return;
+        snprintf(buffer, sizeof(buffer), "%.4g", value);
+        out << buffer;
+    };
+    bool cycles = counts.valid[PERF_CYCLES] && counts.value[PERF_CYCLES] > 0;
+    cell(cycles && counts.valid[PERF_INSTRUCTIONS],
+         cycles ? counts.value[PERF_INSTRUCTIONS] / counts.value[PERF_CYCLES] : 0.0);
+    cell(counts.valid[PERF_L1D_MISSES], counts.value[PERF_L1D_MISSES] / elements);
+    cell(counts.valid[PERF_LLC_MISSES], counts.value[PERF_LLC_MISSES] / elements);
+    cell(counts.valid[PERF_DTLB_MISSES], counts.value[PERF_DTLB_MISSES] / elements);
+    cell(cycles && counts.valid[PERF_STALLED_CYCLES],
+         cycles ? counts.value[PERF_STALLED_CYCLES] / counts.value[PERF_CYCLES] : 0.0);
+}
@@ -0,0 +1,447 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "bench_harness.h"
+#include "cache_topology.h"
+#include "cpu_features.h"
+#include "matrix.h"
+
+// 屋顶线(roofline)模型：实测本机各级缓存/内存的带宽和双精度浮点峰值，
+// 把每个内核的结果换算为搬运字节数、实际带宽、运算强度(FLOP/字节)和屋顶线占比。
+// 某个运算强度I、数据量落在第l层时，可达性能上限为 min(浮点峰值, I * 第l层读带宽)；
+// 字节数按必需流量估算(每个输入元素读一次、每个输出元素写一次)，不计缓存行浪费和写分配
+
+enum RooflineLevel {
+    ROOF_L1 = 0,
+    ROOF_L2,
+    ROOF_L3,
+    ROOF_MEMORY,
+    ROOF_LEVELS
+};
+
+inline const char* roofline_level_name(int level) {
+    switch (level) {
+        case ROOF_L1: return "L1";
+        case ROOF_L2: return "L2";
+        case ROOF_L3: return "L3";
+        default: return "内存";
+    }
+}
+
+// ---------------- 带宽探测内核 ----------------
+// 类似STREAM：read为只读求和(8个独立累加器，不受加法延迟限制)，triad为a[i] = b[i] + s*c[i]；
+// n为8的倍数(探测数组由本文件分配)
+
+__attribute__((target("avx2,fma")))
+inline double stream_read_avx2(const double* a, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+    __m256d acc4 = _mm256_setzero_pd(), acc5 = _mm256_setzero_pd();
+    __m256d acc6 = _mm256_setzero_pd(), acc7 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm256_add_pd(acc0, _mm256_load_pd(a + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_load_pd(a + i + 4));
+        acc2 = _mm256_add_pd(acc2, _mm256_load_pd(a + i + 8));
+        acc3 = _mm256_add_pd(acc3, _mm256_load_pd(a + i + 12));
+        acc4 = _mm256_add_pd(acc4, _mm256_load_pd(a + i + 16));
+        acc5 = _mm256_add_pd(acc5, _mm256_load_pd(a + i + 20));
+        acc6 = _mm256_add_pd(acc6, _mm256_load_pd(a + i + 24));
+        acc7 = _mm256_add_pd(acc7, _mm256_load_pd(a + i + 28));
+    }
+    for (; i < n; i += 4) {
+        acc0 = _mm256_add_pd(acc0, _mm256_load_pd(a + i));
+    }
+    __m256d acc = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3)),
+                                _mm256_add_pd(_mm256_add_pd(acc4, acc5), _mm256_add_pd(acc6, acc7)));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx512f")))
+inline double stream_read_avx512(const double* a, size_t n) {
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    __m512d acc2 = _mm512_setzero_pd(), acc3 = _mm512_setzero_pd();
+    __m512d acc4 = _mm512_setzero_pd(), acc5 = _mm512_setzero_pd();
+    __m512d acc6 = _mm512_setzero_pd(), acc7 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        acc0 = _mm512_add_pd(acc0, _mm512_load_pd(a + i));
+        acc1 = _mm512_add_pd(acc1, _mm512_load_pd(a + i + 8));
+        acc2 = _mm512_add_pd(acc2, _mm512_load_pd(a + i + 16));
+        acc3 = _mm512_add_pd(acc3, _mm512_load_pd(a + i + 24));
+        acc4 = _mm512_add_pd(acc4, _mm512_load_pd(a + i + 32));
+        acc5 = _mm512_add_pd(acc5, _mm512_load_pd(a + i + 40));
+        acc6 = _mm512_add_pd(acc6, _mm512_load_pd(a + i + 48));
+        acc7 = _mm512_add_pd(acc7, _mm512_load_pd(a + i + 56));
+    }
+    for (; i < n; i += 8) {
+        acc0 = _mm512_add_pd(acc0, _mm512_load_pd(a + i));
+    }
+    __m512d acc = _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3)),
+                                _mm512_add_pd(_mm512_add_pd(acc4, acc5), _mm512_add_pd(acc6, acc7)));
+    double lanes[8];
+    _mm512_storeu_pd(lanes, acc);
+    return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+inline double stream_read_scalar(const double* a, size_t n) {
+    double acc[8] = {};
+    for (size_t i = 0; i < n; i += 8) {
+        for (int k = 0; k < 8; k++) {
+            acc[k] += a[i + k];
+        }
+    }
+    return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+}
+
+__attribute__((target("avx2,fma")))
+inline void stream_triad_avx2(double* a, const double* b, const double* c, double s, size_t n) {
+    __m256d scalar = _mm256_set1_pd(s);
+    for (size_t i = 0; i < n; i += 4) {
+        _mm256_store_pd(a + i, _mm256_fmadd_pd(scalar, _mm256_load_pd(c + i), _mm256_load_pd(b + i)));
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void stream_triad_avx512(double* a, const double* b, const double* c, double s, size_t n) {
+    __m512d scalar = _mm512_set1_pd(s);
+    for (size_t i = 0; i < n; i += 8) {
+        _mm512_store_pd(a + i, _mm512_fmadd_pd(scalar, _mm512_load_pd(c + i), _mm512_load_pd(b + i)));
+    }
+}
+
+inline void stream_triad_scalar(double* a, const double* b, const double* c, double s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        a[i] = b[i] + s * c[i];
+    }
+}
+
+// ---------------- 浮点峰值探测内核 ----------------
+// 10条独立的 acc = acc*a + b 依赖链，足以覆盖FMA延迟(4~5周期)x每周期2条的吞吐；
+// a略小于1、b很小，累加器收敛到b/(1-a)附近，不会溢出或变成非规格化数。
+// 每次迭代10*lanes*2次浮点运算
+
+const int PEAK_CHAINS = 10;
+
+__attribute__((target("sse2")))
+inline double peak_flops_sse2(long long iterations) {
+    __m128d a = _mm_set1_pd(0.999999), b = _mm_set1_pd(1e-6);
+    __m128d x0 = _mm_set1_pd(0.0), x1 = _mm_set1_pd(0.1), x2 = _mm_set1_pd(0.2), x3 = _mm_set1_pd(0.3);
+    __m128d x4 = _mm_set1_pd(0.4), x5 = _mm_set1_pd(0.5), x6 = _mm_set1_pd(0.6), x7 = _mm_set1_pd(0.7);
+    __m128d x8 = _mm_set1_pd(0.8), x9 = _mm_set1_pd(0.9);
+    // SSE2没有FMA，乘法和加法分开发射
+    for (long long it = 0; it < iterations; it++) {
+        x0 = _mm_add_pd(_mm_mul_pd(x0, a), b);
+        x1 = _mm_add_pd(_mm_mul_pd(x1, a), b);
+        x2 = _mm_add_pd(_mm_mul_pd(x2, a), b);
+        x3 = _mm_add_pd(_mm_mul_pd(x3, a), b);
+        x4 = _mm_add_pd(_mm_mul_pd(x4, a), b);
+        x5 = _mm_add_pd(_mm_mul_pd(x5, a), b);
+        x6 = _mm_add_pd(_mm_mul_pd(x6, a), b);
+        x7 = _mm_add_pd(_mm_mul_pd(x7, a), b);
+        x8 = _mm_add_pd(_mm_mul_pd(x8, a), b);
+        x9 = _mm_add_pd(_mm_mul_pd(x9, a), b);
+    }
+    __m128d sum = _mm_add_pd(_mm_add_pd(_mm_add_pd(x0, x1), _mm_add_pd(x2, x3)),
+                             _mm_add_pd(_mm_add_pd(_mm_add_pd(x4, x5), _mm_add_pd(x6, x7)), _mm_add_pd(x8, x9)));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+__attribute__((target("avx2,fma")))
+inline double peak_flops_avx2(long long iterations) {
+    __m256d a = _mm256_set1_pd(0.999999), b = _mm256_set1_pd(1e-6);
+    __m256d x0 = _mm256_set1_pd(0.0), x1 = _mm256_set1_pd(0.1), x2 = _mm256_set1_pd(0.2);
+    __m256d x3 = _mm256_set1_pd(0.3), x4 = _mm256_set1_pd(0.4), x5 = _mm256_set1_pd(0.5);
+    __m256d x6 = _mm256_set1_pd(0.6), x7 = _mm256_set1_pd(0.7), x8 = _mm256_set1_pd(0.8);
+    __m256d x9 = _mm256_set1_pd(0.9);
+    for (long long it = 0; it < iterations; it++) {
+        x0 = _mm256_fmadd_pd(x0, a, b);
+        x1 = _mm256_fmadd_pd(x1, a, b);
+        x2 = _mm256_fmadd_pd(x2, a, b);
+        x3 = _mm256_fmadd_pd(x3, a, b);
+        x4 = _mm256_fmadd_pd(x4, a, b);
+        x5 = _mm256_fmadd_pd(x5, a, b);
+        x6 = _mm256_fmadd_pd(x6, a, b);
+        x7 = _mm256_fmadd_pd(x7, a, b);
+        x8 = _mm256_fmadd_pd(x8, a, b);
+        x9 = _mm256_fmadd_pd(x9, a, b);
+    }
+    __m256d sum = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(x0, x1), _mm256_add_pd(x2, x3)),
+                                _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(x4, x5), _mm256_add_pd(x6, x7)),
+                                              _mm256_add_pd(x8, x9)));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx512f")))
+inline double peak_flops_avx512(long long iterations) {
+    __m512d a = _mm512_set1_pd(0.999999), b = _mm512_set1_pd(1e-6);
+    __m512d x0 = _mm512_set1_pd(0.0), x1 = _mm512_set1_pd(0.1), x2 = _mm512_set1_pd(0.2);
+    __m512d x3 = _mm512_set1_pd(0.3), x4 = _mm512_set1_pd(0.4), x5 = _mm512_set1_pd(0.5);
+    __m512d x6 = _mm512_set1_pd(0.6), x7 = _mm512_set1_pd(0.7), x8 = _mm512_set1_pd(0.8);
+    __m512d x9 = _mm512_set1_pd(0.9);
+    for (long long it = 0; it < iterations; it++) {
+        x0 = _mm512_fmadd_pd(x0, a, b);
+        x1 = _mm512_fmadd_pd(x1, a, b);
+        x2 = _mm512_fmadd_pd(x2, a, b);
+        x3 = _mm512_fmadd_pd(x3, a, b);
+        x4 = _mm512_fmadd_pd(x4, a, b);
+        x5 = _mm512_fmadd_pd(x5, a, b);
+        x6 = _mm512_fmadd_pd(x6, a, b);
+        x7 = _mm512_fmadd_pd(x7, a, b);
+        x8 = _mm512_fmadd_pd(x8, a, b);
+        x9 = _mm512_fmadd_pd(x9, a, b);
+    }
+    __m512d sum = _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(x0, x1), _mm512_add_pd(x2, x3)),
+                                _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(x4, x5), _mm512_add_pd(x6, x7)),
+                                              _mm512_add_pd(x8, x9)));
+    double lanes[8];
+    _mm512_storeu_pd(lanes, sum);
+    return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+// ---------------- 本机峰值 ----------------
+
+struct MachinePeaks {
+    double read_gbs[ROOF_LEVELS] = {};   // 只读带宽(GB/s)，该层不存在时为0；屋顶线用这一组
+    double triad_gbs[ROOF_LEVELS] = {};  // triad带宽，按STREAM惯例每元素24字节(不计写分配)
+    size_t bytes[ROOF_LEVELS] = {};      // 探测该层时的数据量
+    size_t capacity[ROOF_LEVELS] = {};   // 该层容量，内存层为0(不限)
+    double gflops = 0.0;                 // 单核双精度峰值(GFLOP/s)
+    SimdLevel simd = SIMD_SCALAR;
+};
+
+// 数据量working_set(字节)所在的层次：能装下它的最小一级缓存，都装不下时为内存
+inline int roofline_level_for(const MachinePeaks& peaks, double working_set) {
+    for (int level = ROOF_L1; level < ROOF_MEMORY; level++) {
+        if (peaks.capacity[level] > 0 && peaks.read_gbs[level] > 0 && working_set <= peaks.capacity[level]) {
+            return level;
+        }
+    }
+    return ROOF_MEMORY;
+}
+
+// 在level层、运算强度intensity下的性能上限(GFLOP/s)
+inline double roofline_bound(const MachinePeaks& peaks, double intensity, int level) {
+    double memory_bound = intensity * peaks.read_gbs[level];
+    return memory_bound < peaks.gflops ? memory_bound : peaks.gflops;
+}
+
+inline MachinePeaks measure_machine_peaks(const BenchOptions& options) {
+    MachinePeaks peaks;
+    peaks.simd = detect_simd_level();
+    // 探测本身不需要硬件计数器
+    BenchOptions probe_options = options;
+    probe_options.counters = false;
+
+    double (*read)(const double*, size_t) = stream_read_scalar;
+    void (*triad)(double*, const double*, const double*, double, size_t) = stream_triad_scalar;
+    double (*peak)(long long) = peak_flops_sse2;
+    int lanes = 2;
+    if (peaks.simd >= SIMD_AVX512) {
+        read = stream_read_avx512;
+        triad = stream_triad_avx512;
+        peak = peak_flops_avx512;
+        lanes = 8;
+    } else if (peaks.simd >= SIMD_AVX2) {
+        read = stream_read_avx2;
+        triad = stream_triad_avx2;
+        peak = peak_flops_avx2;
+        lanes = 4;
+    }
+
+    // 各级缓存用其容量的一半(留出余量给其他数据)，内存用4倍于最大一级缓存且至少64MB
+    const CacheTopology& topo = cache_topology();
+    size_t largest = topo.l1d;
+    for (int level = ROOF_L1; level < ROOF_MEMORY; level++) {
+        peaks.capacity[level] = topo.level_size(level + 1);
+        if (peaks.capacity[level] > largest) largest = peaks.capacity[level];
+    }
+    size_t memory_bytes = largest * 4 > ((size_t)64 << 20) ? largest * 4 : ((size_t)64 << 20);
+
+    volatile double sink = 0.0;
+    for (int level = ROOF_L1; level < ROOF_LEVELS; level++) {
+        size_t bytes = level == ROOF_MEMORY ? memory_bytes : peaks.capacity[level] / 2;
+        // 大的共享L3中单核实际能用到的往往远小于标称容量(虚拟机中更甚)，只取下一层容量的4倍，
+        // 使探测落在该层的低端，对应刚溢出下一层的数据量
+        if (level > ROOF_L1 && level < ROOF_MEMORY && peaks.capacity[level - 1] * 4 < bytes) {
+            bytes = peaks.capacity[level - 1] * 4;
+        }
+        // 不存在的层次或比上一层还小(检测异常)时跳过
+        if (bytes == 0 || (level > ROOF_L1 && level < ROOF_MEMORY && bytes <= peaks.bytes[level - 1])) continue;
+        // triad的三个数组合计占同样的数据量，长度取64的倍数，保证向量循环没有尾部
+        size_t n = bytes / sizeof(double) / 64 * 64;
+        size_t third = bytes / 3 / sizeof(double) / 64 * 64;
+        if (third == 0) third = 64;
+        double* data = (double*)aligned_alloc(CACHE_LINE, n * sizeof(double));
+        double* b = (double*)aligned_alloc(CACHE_LINE, third * sizeof(double));
+        double* c = (double*)aligned_alloc(CACHE_LINE, third * sizeof(double));
+        for (size_t i = 0; i < n; i++) data[i] = 1.0;
+        for (size_t i = 0; i < third; i++) {
+            b[i] = 1.0;
+            c[i] = 2.0;
+        }
+        BenchStats read_stats = bench_run([&] { sink = read(data, n); }, probe_options);
+        BenchStats triad_stats = bench_run([&] { triad(data, b, c, 3.0, third); }, probe_options);
+        peaks.bytes[level] = n * sizeof(double);
+        peaks.read_gbs[level] = n * sizeof(double) / read_stats.median / 1e9;
+        peaks.triad_gbs[level] = 3.0 * third * sizeof(double) / triad_stats.median / 1e9;
+        free(data);
+        free(b);
+        free(c);
+    }
+
+    const long long iterations = 4096;
+    BenchStats peak_stats = bench_run([&] { sink = peak(iterations); }, probe_options);
+    peaks.gflops = (double)iterations * PEAK_CHAINS * lanes * 2 / peak_stats.median / 1e9;
+    return peaks;
+}
+
+// 进程内只测量一次
+inline const MachinePeaks& machine_peaks(const BenchOptions& options) {
+    static MachinePeaks peaks = measure_machine_peaks(options);
+    return peaks;
+}
+
+inline std::string machine_peaks_summary(const MachinePeaks& peaks) {
+    std::string text;
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "%s峰值%.1f GFLOP/s, 读/triad带宽", simd_level_name(peaks.simd), peaks.gflops);
+    text += buffer;
+    for (int level = ROOF_L1; level < ROOF_LEVELS; level++) {
+        if (peaks.read_gbs[level] <= 0) continue;
+        snprintf(buffer, sizeof(buffer), " %s=%.1f/%.1f", roofline_level_name(level), peaks.read_gbs[level],
+                 peaks.triad_gbs[level]);
+        text += buffer;
+    }
+    return text + " GB/s";
+}
+
+// ---------------- 内核的工作量 ----------------
+
+struct RooflineWork {
+    double bytes;        // 必需的内存流量(字节)
+    double flops;        // 浮点运算次数
+    double working_set;  // 反复调用时驻留的数据量(字节)，决定落在哪一层
+};
+
+// 单次调用耗时seconds的内核达到了屋顶线的百分之几
+inline double roofline_percent(const MachinePeaks& peaks, const RooflineWork& work, double seconds) {
+    int level = roofline_level_for(peaks, work.working_set);
+    return work.flops / seconds / 1e9 / roofline_bound(peaks, work.flops / work.bytes, level) * 100;
+}
+
+// 对n个double求和：读n个元素，每个元素flops_per_element次运算(普通求和1次加法，补偿求和约4次)
+inline RooflineWork sum_work(long long n, double flops_per_element = 1.0) {
+    double bytes = (double)n * sizeof(double);
+    return {bytes, flops_per_element * n, bytes};
+}
+
+// n个double的前缀和：读输入、写输出各一次，每个元素一次加法
+inline RooflineWork scan_work(long long n) {
+    double bytes = 2.0 * n * sizeof(double);
+    return {bytes, (double)n, bytes};
+}
+
+// 多统计量规约：arrays个长度为n的数组共读passes遍，每个元素flops次运算
+inline RooflineWork stats_work(long long n, int arrays, int passes, double flops) {
+    return {(double)passes * n * sizeof(double), flops * n, (double)arrays * n * sizeof(double)};
+}
+
+// 矩阵存储占matrix_bytes字节的n x n矩阵乘向量(混合精度格式按实际存储宽度，含int8的缩放因子)
+inline RooflineWork gemv_stored_work(long long n, double matrix_bytes) {
+    double bytes = matrix_bytes + 2.0 * n * sizeof(double);
+    return {bytes, 2.0 * n * n, bytes};
+}
+
+// n x n矩阵乘向量：读矩阵和输入向量、写结果向量，每个矩阵元素一次乘法一次加法
+inline RooflineWork gemv_work(long long n) {
+    return gemv_stored_work(n, (double)n * n * sizeof(double));
+}
+
+// 同一矩阵乘k个向量：矩阵读passes遍(逐个调用为k遍，批量为1遍)，读k个向量、写k个结果
+inline RooflineWork gemv_batch_work(long long n, int k, int passes) {
+    double vectors = 2.0 * k * n * sizeof(double);
+    double matrix = (double)n * n * sizeof(double);
+    return {passes * matrix + vectors, 2.0 * n * n * k, matrix + vectors};
+}
+
+// 稀疏矩阵向量乘法：读矩阵存储(matrix_bytes，含下标和补齐的元素)和x、写y，每个非零元一次乘加
+inline RooflineWork spmv_work(double matrix_bytes, long long rows, long long cols, long long nnz) {
+    double bytes = matrix_bytes + (double)(rows + cols) * sizeof(double);
+    return {bytes, 2.0 * nnz, bytes};
+}
+
+// 同时计算A·x和Aᵀ·w：矩阵读passes遍，读x、w并写y、z，每个矩阵元素两次乘加
+inline RooflineWork gemv_pair_work(long long n, int passes) {
+    double vectors = 4.0 * n * sizeof(double);
+    double matrix = (double)n * n * sizeof(double);
+    return {passes * matrix + vectors, 4.0 * n * n, matrix + vectors};
+}
+
+// ---------------- 输出 ----------------
+
+// 收集各内核结果的屋顶线数据，写成与主CSV并列的CSV(每个内核每个规模一行)；
+// 开头以"# 峰值"注释行写入测得的峰值，供ht.py画出屋顶
+class RooflineReport {
+public:
+    explicit RooflineReport(const BenchOptions& options) : peaks_(machine_peaks(options)) {}
+
+    const MachinePeaks& peaks() const { return peaks_; }
+
+    void add(const char* test, const char* kernel, long long n, const RooflineWork& work, double seconds) {
+        if (seconds <= 0) return;
+        int level = roofline_level_for(peaks_, work.working_set);
+        double intensity = work.flops / work.bytes;
+        double gflops = work.flops / seconds / 1e9;
+        double bound = roofline_bound(peaks_, intensity, level);
+        char buffer[512];
+        snprintf(buffer, sizeof(buffer), "%s,%s,%lld,%.0f,%.0f,%.6e,%.3f,%.3f,%.4f,%s,%.3f,%.2f", test, kernel, n,
+                 work.bytes, work.flops, seconds, work.bytes / seconds / 1e9, gflops, intensity,
+                 roofline_level_name(level), bound, gflops / bound * 100);
+        rows_.push_back(buffer);
+    }
+
+    bool write_csv(const char* path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) return false;
+        write_topology_header(out);
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "# 峰值,浮点,%.3f,%s\n", peaks_.gflops, simd_level_name(peaks_.simd));
+        out << buffer;
+        for (int level = ROOF_L1; level < ROOF_LEVELS; level++) {
+            if (peaks_.read_gbs[level] <= 0) continue;
+            snprintf(buffer, sizeof(buffer), "# 峰值,%s,%.3f,%.3f,%zu\n", roofline_level_name(level),
+                     peaks_.read_gbs[level], peaks_.triad_gbs[level], peaks_.bytes[level]);
+            out << buffer;
+        }
+        out << "测试,算法,规模,字节数,浮点运算数,时间(秒),带宽(GB/s),GFLOP/s,运算强度(FLOP/B),所在层次,"
+            << "屋顶线上限(GFLOP/s),屋顶线占比(%)\n";
+        for (const std::string& row : rows_) {
+            out << row << "\n";
+        }
+        return (bool)out;
+    }
+
+private:
+    const MachinePeaks& peaks_;
+    std::vector<std::string> rows_;
+};
+
+// 主CSV对应的屋顶线CSV文件名：jichu_sum.csv -> jichu_sum_wudingxian.csv
+inline std::string roofline_path_for(const char* csv_path) {
+    std::string path(csv_path);
+    size_t dot = path.rfind('.');
+    if (dot != std::string::npos) path.erase(dot);
+    return path + "_wudingxian.csv";
+}
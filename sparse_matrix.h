@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+
+// 稀疏矩阵存储格式及转换
+// 三种格式都按"输出行"存储：result[r] = Σ_k values(r,k) * x[col(r,k)]。
+// 从稠密矩阵转换时存的是其转置(第r行为稠密矩阵的第r列)，使稀疏内核的结果与mulb相同；
+// 从Matrix Market文件读入时按文件中的行存储，即普通的 y = A*x
+
+// CSR：每行的非零元连续存放，row_ptr[r]..row_ptr[r+1]为第r行的范围
+struct CsrMatrix {
+    int rows = 0;
+    int cols = 0;
+    int nnz = 0;
+    int* row_ptr = nullptr;   // rows+1个
+    int* col_idx = nullptr;   // nnz个，每行内按列号递增
+    double* values = nullptr; // nnz个
+};
+
+// ELLPACK：所有行补齐到最长行的长度width，按列主序存放(第k个元素的各行相邻)，
+// 连续8行的同一位置可以一次向量加载；短行用值为0、列号为0的元素补齐
+struct EllMatrix {
+    int rows = 0;
+    int cols = 0;
+    int nnz = 0;
+    int rows_padded = 0;      // rows向上取整到SELL_C的倍数
+    int width = 0;
+    int* col_idx = nullptr;   // width * rows_padded个，下标 k*rows_padded + r
+    double* values = nullptr;
+};
+
+// SELL-C-σ：每C行为一个块，块内补齐到块内最长行，块内按列主序存放；
+// 补齐前在每σ行的窗口内按行长降序排序，使同一块中的行长度接近，补齐的元素远少于ELLPACK
+const int SELL_C = 8;
+
+struct SellMatrix {
+    int rows = 0;
+    int cols = 0;
+    int nnz = 0;
+    int sigma = 1;
+    int num_chunks = 0;
+    int* chunk_ptr = nullptr;  // num_chunks+1个，第c块的元素从chunk_ptr[c]开始
+    int* chunk_len = nullptr;  // 第c块补齐后的行长
+    int* perm = nullptr;       // num_chunks*SELL_C个，排序后第k行对应的原始行号，补齐的行为-1
+    int* col_idx = nullptr;    // 下标 chunk_ptr[c] + k*SELL_C + lane
+    double* values = nullptr;
+};
+
+// 64字节对齐的int数组
+inline int* alloc_aligned_ints(size_t count) {
+    size_t bytes = (count * sizeof(int) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    if (bytes == 0) bytes = CACHE_LINE;
+    void* p = aligned_alloc(CACHE_LINE, bytes);
+    if (p == nullptr) throw std::bad_alloc();
+    return static_cast<int*>(p);
+}
+
+inline void free_csr(CsrMatrix& m) {
+    free(m.row_ptr);
+    free(m.col_idx);
+    free(m.values);
+    m = CsrMatrix();
+}
+
+inline void free_ell(EllMatrix& m) {
+    free(m.col_idx);
+    free(m.values);
+    m = EllMatrix();
+}
+
+inline void free_sell(SellMatrix& m) {
+    free(m.chunk_ptr);
+    free(m.chunk_len);
+    free(m.perm);
+    free(m.col_idx);
+    free(m.values);
+    m = SellMatrix();
+}
+
+// 各格式实际占用的字节数(值、下标和行/块指针)，用于计算每个非零元的字节数
+inline size_t csr_bytes(const CsrMatrix& m) {
+    return (size_t)m.nnz * (sizeof(double) + sizeof(int)) + (size_t)(m.rows + 1) * sizeof(int);
+}
+
+inline size_t ell_bytes(const EllMatrix& m) {
+    return (size_t)m.width * m.rows_padded * (sizeof(double) + sizeof(int));
+}
+
+inline size_t sell_bytes(const SellMatrix& m) {
+    size_t elements = m.num_chunks > 0 ? (size_t)m.chunk_ptr[m.num_chunks] : 0;
+    return elements * (sizeof(double) + sizeof(int)) +
+           (size_t)m.num_chunks * (2 * sizeof(int) + SELL_C * sizeof(int));
+}
+
+// 三元组(行, 列, 值)转CSR，同一位置的重复元素相加
+inline CsrMatrix csr_from_triplets(int rows, int cols, std::vector<int>& ti, std::vector<int>& tj,
+                                   std::vector<double>& tv) {
+    CsrMatrix m;
+    m.rows = rows;
+    m.cols = cols;
+    m.row_ptr = alloc_aligned_ints(rows + 1);
+    std::vector<int> counts(rows + 1, 0);
+    for (int r : ti) counts[r + 1]++;
+    for (int r = 0; r < rows; r++) counts[r + 1] += counts[r];
+    std::vector<int> order(ti.size());
+    std::vector<int> next(counts.begin(), counts.end() - 1);
+    for (size_t e = 0; e < ti.size(); e++) order[next[ti[e]]++] = (int)e;
+
+    m.col_idx = alloc_aligned_ints(ti.size());
+    m.values = alloc_aligned(ti.size());
+    int nnz = 0;
+    for (int r = 0; r < rows; r++) {
+        m.row_ptr[r] = nnz;
+        std::sort(order.begin() + counts[r], order.begin() + counts[r + 1],
+                  [&](int a, int b) { return tj[a] < tj[b]; });
+        for (int k = counts[r]; k < counts[r + 1]; k++) {
+            int e = order[k];
+            if (nnz > m.row_ptr[r] && m.col_idx[nnz - 1] == tj[e]) {
+                m.values[nnz - 1] += tv[e];
+            } else {
+                m.col_idx[nnz] = tj[e];
+                m.values[nnz] = tv[e];
+                nnz++;
+            }
+        }
+    }
+    m.row_ptr[rows] = nnz;
+    m.nnz = nnz;
+    return m;
+}
+
+// 稠密矩阵转CSR，存的是转置：第r行为稠密矩阵第r列的非零元
+inline CsrMatrix csr_from_dense(const Matrix& matrix) {
+    int n = matrix.n;
+    CsrMatrix m;
+    m.rows = m.cols = n;
+    m.row_ptr = alloc_aligned_ints(n + 1);
+    // 第一遍统计每列的非零元个数
+    std::vector<int> counts(n, 0);
+    for (int i = 0; i < n; i++) {
+        const double* row = matrix.row(i);
+        for (int j = 0; j < n; j++) {
+            if (row[j] != 0.0) counts[j]++;
+        }
+    }
+    m.row_ptr[0] = 0;
+    for (int j = 0; j < n; j++) m.row_ptr[j + 1] = m.row_ptr[j] + counts[j];
+    m.nnz = m.row_ptr[n];
+    m.col_idx = alloc_aligned_ints(m.nnz);
+    m.values = alloc_aligned(m.nnz);
+    // 第二遍按稠密矩阵的行顺序填入，每个稀疏行内的列号自然递增
+    std::vector<int> next(m.row_ptr, m.row_ptr + n);
+    for (int i = 0; i < n; i++) {
+        const double* row = matrix.row(i);
+        for (int j = 0; j < n; j++) {
+            if (row[j] != 0.0) {
+                m.col_idx[next[j]] = i;
+                m.values[next[j]] = row[j];
+                next[j]++;
+            }
+        }
+    }
+    return m;
+}
+
+// 读取Matrix Market坐标格式(real/integer/pattern，general/symmetric)，失败时返回rows=0
+inline CsrMatrix csr_from_matrix_market(const char* path) {
+    std::ifstream in(path);
+    std::string line;
+    if (!in.is_open() || !std::getline(in, line) || line.compare(0, 14, "%%MatrixMarket") != 0) {
+        return CsrMatrix();
+    }
+    std::string lower = line;
+    for (char& c : lower) c = (char)tolower(c);
+    if (lower.find("coordinate") == std::string::npos || lower.find("complex") != std::string::npos) {
+        return CsrMatrix();
+    }
+    bool pattern = lower.find("pattern") != std::string::npos;
+    bool symmetric = lower.find("symmetric") != std::string::npos;
+    bool skew = lower.find("skew-symmetric") != std::string::npos;
+
+    // 跳过注释行，读取行数、列数、非零元个数
+    while (std::getline(in, line) && (line.empty() || line[0] == '%')) {
+    }
+    int rows = 0, cols = 0;
+    long entries = 0;
+    std::istringstream header(line);
+    if (!(header >> rows >> cols >> entries) || rows <= 0 || cols <= 0) {
+        return CsrMatrix();
+    }
+
+    std::vector<int> ti, tj;
+    std::vector<double> tv;
+    ti.reserve(symmetric ? 2 * entries : entries);
+    tj.reserve(symmetric ? 2 * entries : entries);
+    tv.reserve(symmetric ? 2 * entries : entries);
+    for (long e = 0; e < entries; e++) {
+        int i, j;
+        double v = 1.0;
+        if (!(in >> i >> j)) return CsrMatrix();
+        if (!pattern && !(in >> v)) return CsrMatrix();
+        if (i < 1 || i > rows || j < 1 || j > cols) return CsrMatrix();
+        ti.push_back(i - 1);
+        tj.push_back(j - 1);
+        tv.push_back(v);
+        // 对称矩阵文件只存下三角，补上对称位置
+        if (symmetric && i != j) {
+            ti.push_back(j - 1);
+            tj.push_back(i - 1);
+            tv.push_back(skew ? -v : v);
+        }
+    }
+    return csr_from_triplets(rows, cols, ti, tj, tv);
+}
+
+// 直接生成n x n随机稀疏矩阵(不经过稠密矩阵，可用于稠密存不下的规模)
+// 行长服从均值为density*n的指数分布(skewed=true)或都等于density*n，列号随机且不重复，
+// 值取1..10的整数，与固定规律的向量相乘时任何加法顺序都得到精确结果
+inline CsrMatrix csr_random(int n, double density, bool skewed, unsigned seed) {
+    uint64_t state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    auto next_random = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    double mean = density * n;
+    std::vector<int> lens(n);
+    long total = 0;
+    for (int r = 0; r < n; r++) {
+        double len = mean;
+        if (skewed) {
+            double u = (next_random() >> 11) * (1.0 / 9007199254740992.0);
+            len = -mean * std::log(1.0 - u);
+        }
+        lens[r] = (int)std::lround(len);
+        if (lens[r] < 1) lens[r] = 1;
+        if (lens[r] > n) lens[r] = n;
+        total += lens[r];
+    }
+
+    CsrMatrix m;
+    m.rows = m.cols = n;
+    m.nnz = (int)total;
+    m.row_ptr = alloc_aligned_ints(n + 1);
+    m.col_idx = alloc_aligned_ints(total);
+    m.values = alloc_aligned(total);
+    m.row_ptr[0] = 0;
+    std::vector<int> cols;
+    for (int r = 0; r < n; r++) {
+        // 行长超过n/2时从全部列中去掉若干列，否则随机抽取并去重
+        cols.clear();
+        if (lens[r] * 2 > n) {
+            for (int j = 0; j < n; j++) cols.push_back(j);
+            for (int k = n - 1; k > 0; k--) std::swap(cols[k], cols[next_random() % (k + 1)]);
+            cols.resize(lens[r]);
+        } else {
+            while ((int)cols.size() < lens[r]) {
+                cols.push_back((int)(next_random() % n));
+                if ((int)cols.size() == lens[r]) {
+                    std::sort(cols.begin(), cols.end());
+                    cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+                }
+            }
+        }
+        std::sort(cols.begin(), cols.end());
+        int start = m.row_ptr[r];
+        for (int k = 0; k < lens[r]; k++) {
+            m.col_idx[start + k] = cols[k];
+            m.values[start + k] = (double)(next_random() % 10 + 1);
+        }
+        m.row_ptr[r + 1] = start + lens[r];
+    }
+    return m;
+}
+
+inline EllMatrix ell_from_csr(const CsrMatrix& csr) {
+    EllMatrix m;
+    m.rows = csr.rows;
+    m.cols = csr.cols;
+    m.nnz = csr.nnz;
+    m.rows_padded = (csr.rows + SELL_C - 1) / SELL_C * SELL_C;
+    for (int r = 0; r < csr.rows; r++) {
+        int len = csr.row_ptr[r + 1] - csr.row_ptr[r];
+        if (len > m.width) m.width = len;
+    }
+    size_t total = (size_t)m.width * m.rows_padded;
+    m.col_idx = alloc_aligned_ints(total);
+    m.values = alloc_aligned(total);
+    memset(m.col_idx, 0, total * sizeof(int));
+    memset(m.values, 0, total * sizeof(double));
+    for (int r = 0; r < csr.rows; r++) {
+        for (int k = 0; k < csr.row_ptr[r + 1] - csr.row_ptr[r]; k++) {
+            m.col_idx[(size_t)k * m.rows_padded + r] = csr.col_idx[csr.row_ptr[r] + k];
+            m.values[(size_t)k * m.rows_padded + r] = csr.values[csr.row_ptr[r] + k];
+        }
+    }
+    return m;
+}
+
+// sigma为排序窗口的行数(取SELL_C的倍数)；sigma=1时不排序，sigma>=rows时全局排序
+inline SellMatrix sell_from_csr(const CsrMatrix& csr, int sigma) {
+    SellMatrix m;
+    m.rows = csr.rows;
+    m.cols = csr.cols;
+    m.nnz = csr.nnz;
+    m.sigma = sigma < 1 ? 1 : sigma;
+    m.num_chunks = (csr.rows + SELL_C - 1) / SELL_C;
+    int padded_rows = m.num_chunks * SELL_C;
+
+    m.perm = alloc_aligned_ints(padded_rows);
+    for (int k = 0; k < padded_rows; k++) {
+        m.perm[k] = k < csr.rows ? k : -1;
+    }
+    auto row_len = [&](int r) { return r < 0 ? 0 : csr.row_ptr[r + 1] - csr.row_ptr[r]; };
+    if (m.sigma > 1) {
+        for (int w = 0; w < csr.rows; w += m.sigma) {
+            int w_end = w + m.sigma < csr.rows ? w + m.sigma : csr.rows;
+            std::stable_sort(m.perm + w, m.perm + w_end,
+                             [&](int a, int b) { return row_len(a) > row_len(b); });
+        }
+    }
+
+    m.chunk_ptr = alloc_aligned_ints(m.num_chunks + 1);
+    m.chunk_len = alloc_aligned_ints(m.num_chunks);
+    m.chunk_ptr[0] = 0;
+    for (int c = 0; c < m.num_chunks; c++) {
+        int len = 0;
+        for (int lane = 0; lane < SELL_C; lane++) {
+            len = std::max(len, row_len(m.perm[c * SELL_C + lane]));
+        }
+        m.chunk_len[c] = len;
+        m.chunk_ptr[c + 1] = m.chunk_ptr[c] + len * SELL_C;
+    }
+
+    size_t total = m.chunk_ptr[m.num_chunks];
+    m.col_idx = alloc_aligned_ints(total);
+    m.values = alloc_aligned(total);
+    memset(m.col_idx, 0, total * sizeof(int));
+    memset(m.values, 0, total * sizeof(double));
+    for (int c = 0; c < m.num_chunks; c++) {
+        for (int lane = 0; lane < SELL_C; lane++) {
+            int r = m.perm[c * SELL_C + lane];
+            for (int k = 0; k < row_len(r); k++) {
+                size_t pos = m.chunk_ptr[c] + (size_t)k * SELL_C + lane;
+                m.col_idx[pos] = csr.col_idx[csr.row_ptr[r] + k];
+                m.values[pos] = csr.values[csr.row_ptr[r] + k];
+            }
+        }
+    }
+    return m;
+}
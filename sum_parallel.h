@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "cache_topology.h"
+#include "sum_simd.h"
+#include "thread_pool.h"
+
+// 多线程NUMA感知数组求和
+// 线程按NUMA节点分组：前一组线程全部绑定在节点0，依次类推，数组按线程顺序连续划分，
+// 因此每个节点负责数组中连续的一段。初始化也由负责该段的线程完成(首次触摸)，
+// Linux在首次写入时把物理页分配在写入线程所在节点，之后求和时每个线程只读本地内存
+
+// 每个线程的部分和独占一个缓存行，避免相邻线程写部分和时的伪共享
+struct alignas(64) ThreadPartial {
+    double sum = 0.0;
+    double seconds = 0.0;  // 该线程处理自己那段的耗时
+};
+
+// 按页划分，使每个物理页只被一个线程首次触摸
+const int PAGE_DOUBLES = 4096 / sizeof(double);
+
+// 线程在NUMA节点间的分配
+struct NumaPlacement {
+    std::vector<int> thread_cpus;   // 第t号线程绑定的CPU
+    std::vector<int> thread_nodes;  // 第t号线程所在的节点序号
+    int num_nodes = 1;
+};
+
+// 把num_threads个线程均分到各节点，只使用本进程允许运行的CPU
+inline NumaPlacement numa_placement(int num_threads) {
+    std::vector<int> allowed = allowed_cpus();
+    std::vector<std::vector<int>> nodes;
+    for (const std::vector<int>& node_cpus : numa_node_cpus()) {
+        std::vector<int> usable;
+        for (int c : node_cpus) {
+            for (int a : allowed) {
+                if (a == c) usable.push_back(c);
+            }
+        }
+        if (!usable.empty()) nodes.push_back(usable);
+    }
+    if (nodes.empty()) nodes.push_back(allowed);
+
+    NumaPlacement placement;
+    placement.num_nodes = (int)nodes.size() < num_threads ? (int)nodes.size() : num_threads;
+    for (int node = 0; node < placement.num_nodes; node++) {
+        int count = num_threads / placement.num_nodes + (node < num_threads % placement.num_nodes ? 1 : 0);
+        for (int k = 0; k < count; k++) {
+            placement.thread_cpus.push_back(nodes[node][k % nodes[node].size()]);
+            placement.thread_nodes.push_back(node);
+        }
+    }
+    return placement;
+}
+
+// 第tid号线程负责的数组区间
+inline void thread_chunk(int n, int num_threads, int tid, int& begin, int& end) {
+    split_range(n, num_threads, tid, PAGE_DOUBLES, begin, end);
+}
+
+// 首次触摸初始化：每个线程写自己负责的那段，数据与generate_data相同
+// arr必须是尚未写过的新分配内存，否则页已分配在之前写入的线程所在节点
+inline void first_touch_generate(ThreadPool& pool, double* arr, int n) {
+    int num_threads = pool.size();
+    pool.run([&](int tid) {
+        int begin, end;
+        thread_chunk(n, num_threads, tid, begin, end);
+        for (int i = begin; i < end; i++) {
+            arr[i] = i % 10 + 1.0;
+        }
+    });
+}
+
+// 并行求和：每个线程用SIMD内核累加自己那段，部分和按线程顺序规约
+inline double sum_parallel(ThreadPool& pool, const double* arr, int n, ThreadPartial* partials) {
+    int num_threads = pool.size();
+    pool.run([&](int tid) {
+        int begin, end;
+        thread_chunk(n, num_threads, tid, begin, end);
+        auto start = std::chrono::steady_clock::now();
+        partials[tid].sum = sum_simd(arr + begin, end - begin);
+        partials[tid].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    });
+    double sum = 0.0;
+    for (int t = 0; t < num_threads; t++) {
+        sum += partials[t].sum;
+    }
+    return sum;
+}
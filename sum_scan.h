@@ -0,0 +1,242 @@
+#pragma once
+
+#include <atomic>
+#include <immintrin.h>
+#include <new>
+#include <sched.h>
+
+#include "cache_topology.h"
+#include "cpu_features.h"
+#include "sum_parallel.h"
+#include "thread_pool.h"
+
+// 前缀和(扫描)：包含型 out[i] = carry + in[0] + ... + in[i]，不包含型 out[i] = carry + in[0] + ... + in[i-1]
+// 所有内核返回carry加上全部元素之和(即下一段的起始值)，in和out可以是同一数组
+//
+// SIMD版本在寄存器内做对数步扫描(AVX2每向量2步，AVX-512每向量3步移位相加)，再加上前一个向量的进位，
+// 进位是唯一的串行依赖；加法顺序与顺序扫描不同，结果只在舍入误差内一致(整数数据逐位一致)
+//
+// 多线程版本：
+// - 两遍(先规约再扫描)：每个线程先对自己那段求和，部分和串行前缀后作为各段的起始值，再各自扫描；
+//   输入读两遍，每段超出缓存时第二遍仍要从内存读
+// - 回看(decoupled look-back)：数组切成缓存大小的块，线程按顺序领取块，先求块和并发布，
+//   再向前查看前面块的状态得到起始值(遇到已发布包含前缀的块即可停止)，扫描仍在缓存中的块并发布包含前缀；
+//   只需一遍读内存，线程之间只通过每块的状态标志同步
+
+enum ScanKind {
+    SCAN_INCLUSIVE,
+    SCAN_EXCLUSIVE
+};
+
+inline const char* scan_kind_name(ScanKind kind) {
+    return kind == SCAN_EXCLUSIVE ? "不包含型" : "包含型";
+}
+
+typedef double (*ScanKernel)(const double* in, double* out, int n, double carry, ScanKind kind);
+
+inline double scan_scalar(const double* in, double* out, int n, double carry, ScanKind kind) {
+    if (kind == SCAN_INCLUSIVE) {
+        for (int i = 0; i < n; i++) {
+            carry += in[i];
+            out[i] = carry;
+        }
+    } else {
+        for (int i = 0; i < n; i++) {
+            double x = in[i];
+            out[i] = carry;
+            carry += x;
+        }
+    }
+    return carry;
+}
+
+__attribute__((target("avx2")))
+inline double scan_avx2(const double* in, double* out, int n, double carry, ScanKind kind) {
+    __m256d zero = _mm256_setzero_pd();
+    __m256d base = _mm256_set1_pd(carry);
+    bool inclusive = kind == SCAN_INCLUSIVE;
+    int i = 0;
+    for (; i + 7 < n; i += 8) {
+        // 两个向量的寄存器内扫描互不依赖，只有加进位是串行的
+        __m256d x0 = _mm256_loadu_pd(in + i);
+        __m256d x1 = _mm256_loadu_pd(in + i + 4);
+        // 左移1个通道：[0, a, b, c]
+        x0 = _mm256_add_pd(x0, _mm256_blend_pd(_mm256_permute4x64_pd(x0, 0x90), zero, 0x1));
+        x1 = _mm256_add_pd(x1, _mm256_blend_pd(_mm256_permute4x64_pd(x1, 0x90), zero, 0x1));
+        // 左移2个通道：[0, 0, a, b]
+        x0 = _mm256_add_pd(x0, _mm256_permute2f128_pd(x0, x0, 0x08));
+        x1 = _mm256_add_pd(x1, _mm256_permute2f128_pd(x1, x1, 0x08));
+
+        __m256d p0 = _mm256_add_pd(x0, base);
+        __m256d base0 = _mm256_permute4x64_pd(p0, 0xFF);
+        __m256d p1 = _mm256_add_pd(x1, base0);
+        __m256d base1 = _mm256_permute4x64_pd(p1, 0xFF);
+        if (inclusive) {
+            _mm256_storeu_pd(out + i, p0);
+            _mm256_storeu_pd(out + i + 4, p1);
+        } else {
+            // 不包含型：包含前缀右移一个通道，0号通道为进入该向量前的进位
+            _mm256_storeu_pd(out + i, _mm256_blend_pd(_mm256_permute4x64_pd(p0, 0x90), base, 0x1));
+            _mm256_storeu_pd(out + i + 4, _mm256_blend_pd(_mm256_permute4x64_pd(p1, 0x90), base0, 0x1));
+        }
+        base = base1;
+    }
+    // 处理剩余元素
+    return scan_scalar(in + i, out + i, n - i, _mm256_cvtsd_f64(base), kind);
+}
+
+__attribute__((target("avx512f")))
+inline double scan_avx512(const double* in, double* out, int n, double carry, ScanKind kind) {
+    const __m512i shift1 = _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 0);
+    const __m512i shift2 = _mm512_set_epi64(5, 4, 3, 2, 1, 0, 0, 0);
+    const __m512i shift4 = _mm512_set_epi64(3, 2, 1, 0, 0, 0, 0, 0);
+    const __m512i last = _mm512_set1_epi64(7);
+    __m512d base = _mm512_set1_pd(carry);
+    bool inclusive = kind == SCAN_INCLUSIVE;
+    int i = 0;
+    for (; i + 15 < n; i += 16) {
+        // 两个向量的寄存器内扫描互不依赖，只有加进位是串行的；移位用带零掩码的通道置换
+        __m512d x0 = _mm512_loadu_pd(in + i);
+        __m512d x1 = _mm512_loadu_pd(in + i + 8);
+        x0 = _mm512_add_pd(x0, _mm512_maskz_permutexvar_pd(0xFE, shift1, x0));
+        x1 = _mm512_add_pd(x1, _mm512_maskz_permutexvar_pd(0xFE, shift1, x1));
+        x0 = _mm512_add_pd(x0, _mm512_maskz_permutexvar_pd(0xFC, shift2, x0));
+        x1 = _mm512_add_pd(x1, _mm512_maskz_permutexvar_pd(0xFC, shift2, x1));
+        x0 = _mm512_add_pd(x0, _mm512_maskz_permutexvar_pd(0xF0, shift4, x0));
+        x1 = _mm512_add_pd(x1, _mm512_maskz_permutexvar_pd(0xF0, shift4, x1));
+
+        __m512d p0 = _mm512_add_pd(x0, base);
+        __m512d base0 = _mm512_maskz_permutexvar_pd(0xFF, last, p0);
+        __m512d p1 = _mm512_add_pd(x1, base0);
+        __m512d base1 = _mm512_maskz_permutexvar_pd(0xFF, last, p1);
+        if (inclusive) {
+            _mm512_storeu_pd(out + i, p0);
+            _mm512_storeu_pd(out + i + 8, p1);
+        } else {
+            // 不包含型：包含前缀右移一个通道，0号通道为进入该向量前的进位
+            _mm512_storeu_pd(out + i, _mm512_mask_permutexvar_pd(base, 0xFE, shift1, p0));
+            _mm512_storeu_pd(out + i + 8, _mm512_mask_permutexvar_pd(base0, 0xFE, shift1, p1));
+        }
+        base = base1;
+    }
+    // 处理剩余元素
+    return scan_scalar(in + i, out + i, n - i, _mm512_cvtsd_f64(base), kind);
+}
+
+// 返回指定指令集的扫描函数；SSE2每个向量只有2个通道，不单独实现，与标量相同
+inline ScanKernel scan_kernel_for(SimdLevel level) {
+    if (!simd_supported(level)) return nullptr;
+    switch (level) {
+        case SIMD_AVX2: return scan_avx2;
+        case SIMD_AVX512: return scan_avx512;
+        default: return scan_scalar;
+    }
+}
+
+// 运行时分派：首次调用时根据cpuid选出最宽的可用版本
+inline double scan_simd(const double* in, double* out, int n, double carry, ScanKind kind) {
+    static ScanKernel kernel = scan_kernel_for(detect_simd_level());
+    return kernel(in, out, n, carry, kind);
+}
+
+// ---------------- 多线程 ----------------
+
+// 低于该元素数时唤醒线程的开销超过扫描本身，多线程版本直接在调用线程上做SIMD扫描
+const int SCAN_PARALLEL_MIN = 1 << 16;
+
+// 两遍扫描：partials至少pool.size()个；各段按页划分(同sum_parallel)
+inline double scan_two_pass(ThreadPool& pool, const double* in, double* out, int n, ScanKind kind,
+                            ThreadPartial* partials) {
+    int num_threads = pool.size();
+    if (num_threads == 1 || n < SCAN_PARALLEL_MIN) return scan_simd(in, out, n, 0.0, kind);
+    pool.run([&](int tid) {
+        int begin, end;
+        thread_chunk(n, num_threads, tid, begin, end);
+        partials[tid].sum = sum_simd(in + begin, end - begin);
+    });
+    // 部分和的不包含前缀即各段的起始值
+    double carry = 0.0;
+    for (int t = 0; t < num_threads; t++) {
+        double sum = partials[t].sum;
+        partials[t].sum = carry;
+        carry += sum;
+    }
+    pool.run([&](int tid) {
+        int begin, end;
+        thread_chunk(n, num_threads, tid, begin, end);
+        scan_simd(in + begin, out + begin, end - begin, partials[tid].sum, kind);
+    });
+    return carry;
+}
+
+// 回看扫描中每块的状态，独占一个缓存行
+struct alignas(64) ScanTileState {
+    std::atomic<int> flag{0};  // 0: 未发布, 1: aggregate可用, 2: inclusive可用
+    double aggregate = 0.0;    // 本块元素之和
+    double inclusive = 0.0;    // 到本块末尾为止的包含前缀
+};
+
+const int SCAN_TILE_NONE = 0;
+const int SCAN_TILE_AGGREGATE = 1;
+const int SCAN_TILE_INCLUSIVE = 2;
+
+// 块大小：输入块和输出块合计约占L2的一半，使扫描时输入块仍在L2中；按页对齐
+inline int scan_tile_doubles(const CacheTopology& topo) {
+    int tile = (int)(topo.l2 / 4 / sizeof(double)) / PAGE_DOUBLES * PAGE_DOUBLES;
+    return tile < PAGE_DOUBLES ? PAGE_DOUBLES : tile;
+}
+
+inline int scan_tile_count(int n, int tile) {
+    return (n + tile - 1) / tile;
+}
+
+// 回看扫描所需的状态缓冲区大小(字节)，另加一个缓存行存放领取计数器
+inline size_t scan_lookback_bytes(int n) {
+    return (scan_tile_count(n, scan_tile_doubles(cache_topology())) + 1) * sizeof(ScanTileState);
+}
+
+// 单遍回看扫描：scratch至少scan_lookback_bytes(n)字节
+inline double scan_lookback(ThreadPool& pool, const double* in, double* out, int n, ScanKind kind, void* scratch) {
+    if (pool.size() == 1 || n < SCAN_PARALLEL_MIN) return scan_simd(in, out, n, 0.0, kind);
+    int tile = scan_tile_doubles(cache_topology());
+    int tiles = scan_tile_count(n, tile);
+    ScanTileState* states = (ScanTileState*)scratch;
+    for (int t = 0; t <= tiles; t++) {
+        new (&states[t]) ScanTileState();
+    }
+    // 最后一个状态的flag用作领取计数器：按顺序领取保证前面的块都已有线程在处理，回看不会死等
+    std::atomic<int>& next = states[tiles].flag;
+
+    pool.run([&](int) {
+        while (true) {
+            int t = next.fetch_add(1, std::memory_order_relaxed);
+            if (t >= tiles) break;
+            int begin = t * tile;
+            int count = n - begin < tile ? n - begin : tile;
+            ScanTileState& state = states[t];
+
+            double carry = 0.0;
+            if (t > 0) {
+                state.aggregate = sum_simd(in + begin, count);
+                state.flag.store(SCAN_TILE_AGGREGATE, std::memory_order_release);
+                // 向前累加前面各块的aggregate，直到遇到已发布inclusive的块
+                for (int p = t - 1; p >= 0; p--) {
+                    int flag;
+                    int spins = 0;
+                    while ((flag = states[p].flag.load(std::memory_order_acquire)) == SCAN_TILE_NONE) {
+                        _mm_pause();
+                        if (++spins % 1024 == 0) sched_yield();
+                    }
+                    if (flag == SCAN_TILE_INCLUSIVE) {
+                        carry += states[p].inclusive;
+                        break;
+                    }
+                    carry += states[p].aggregate;
+                }
+            }
+            state.inclusive = scan_simd(in + begin, out + begin, count, carry, kind);
+            state.flag.store(SCAN_TILE_INCLUSIVE, std::memory_order_release);
+        }
+    });
+    return states[tiles - 1].inclusive;
+}
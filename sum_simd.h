@@ -0,0 +1,240 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include "cpu_features.h"
+
+// 手写向量化求和，每个指令集版本使用4个独立的向量累加器，
+// 使循环不再受单个累加器加法延迟的限制(加法延迟约4周期，每周期可发射2条加法)
+// 各版本通过target属性单独编译，运行时根据cpuid选择，同一二进制可在不同主机上运行
+
+__attribute__((target("sse2")))
+inline double sum_sse2(const double* arr, int n) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    __m128d acc2 = _mm_setzero_pd();
+    __m128d acc3 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 7 < n; i += 8) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(arr + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(arr + i + 2));
+        acc2 = _mm_add_pd(acc2, _mm_loadu_pd(arr + i + 4));
+        acc3 = _mm_add_pd(acc3, _mm_loadu_pd(arr + i + 6));
+    }
+    __m128d acc = _mm_add_pd(_mm_add_pd(acc0, acc1), _mm_add_pd(acc2, acc3));
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    double sum = lanes[0] + lanes[1];
+
+    // 处理剩余元素
+    for (; i < n; i++) {
+        sum += arr[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2")))
+inline double sum_avx2(const double* arr, int n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd();
+    __m256d acc3 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 15 < n; i += 16) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(arr + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(arr + i + 4));
+        acc2 = _mm256_add_pd(acc2, _mm256_loadu_pd(arr + i + 8));
+        acc3 = _mm256_add_pd(acc3, _mm256_loadu_pd(arr + i + 12));
+    }
+    __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+
+    // 处理剩余元素
+    for (; i < n; i++) {
+        sum += arr[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+inline double sum_avx512(const double* arr, int n) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    __m512d acc2 = _mm512_setzero_pd();
+    __m512d acc3 = _mm512_setzero_pd();
+    int i = 0;
+    for (; i + 31 < n; i += 32) {
+        acc0 = _mm512_add_pd(acc0, _mm512_loadu_pd(arr + i));
+        acc1 = _mm512_add_pd(acc1, _mm512_loadu_pd(arr + i + 8));
+        acc2 = _mm512_add_pd(acc2, _mm512_loadu_pd(arr + i + 16));
+        acc3 = _mm512_add_pd(acc3, _mm512_loadu_pd(arr + i + 24));
+    }
+    // 不足32个的尾部用掩码加载，避免逐个标量累加
+    for (; i < n; i += 8) {
+        __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8)((1u << (n - i)) - 1);
+        acc0 = _mm512_add_pd(acc0, _mm512_maskz_loadu_pd(mask, arr + i));
+    }
+    __m512d acc = _mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3));
+    double lanes[8];
+    _mm512_storeu_pd(lanes, acc);
+    return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+typedef double (*SumKernel)(const double* arr, int n);
+
+// 返回指定指令集的求和函数，不支持时返回nullptr
+inline SumKernel sum_kernel_for(SimdLevel level) {
+    if (!simd_supported(level)) return nullptr;
+    switch (level) {
+        case SIMD_SSE2: return sum_sse2;
+        case SIMD_AVX2: return sum_avx2;
+        case SIMD_AVX512: return sum_avx512;
+        default: return nullptr;
+    }
+}
+
+// 运行时分派：首次调用时根据cpuid选出最宽的可用版本
+inline double sum_simd(const double* arr, int n) {
+    static SumKernel kernel = sum_kernel_for(detect_simd_level());
+    if (kernel == nullptr) {
+        double sum = 0.0;
+        for (int i = 0; i < n; i++) sum += arr[i];
+        return sum;
+    }
+    return kernel(arr, n);
+}
+
+// ---------------- 补偿求和(Kahan-Babuska/Neumaier) ----------------
+// 每个累加器旁边再保存一个补偿项c，用TwoSum求出每次加法的舍入误差并累加到c：
+//   t = s + x;  z = t - s;  c += (s - (t - z)) + (x - z);  s = t
+// TwoSum对任意大小关系都精确，不需要Neumaier原版中比较|s|与|x|的分支，可以直接向量化。
+// 误差界与n无关(约为2eps加上n*eps^2乘以条件数)，代价是每个元素多5次加法；
+// 数据超出缓存后仍受内存带宽限制，速度与普通向量化求和相近
+
+// 把各通道的(s, c)合并成一个结果，合并本身也用TwoSum
+inline double combine_compensated(const double* sums, const double* comps, int count) {
+    double s = 0.0;
+    double c = 0.0;
+    for (int k = 0; k < count; k++) {
+        double t = s + sums[k];
+        double z = t - s;
+        c += (s - (t - z)) + (sums[k] - z);
+        s = t;
+        c += comps[k];
+    }
+    return s + c;
+}
+
+// 标量Neumaier求和，作为不支持AVX2时的回退
+inline double sum_neumaier(const double* arr, int n) {
+    double s = 0.0;
+    double c = 0.0;
+    for (int i = 0; i < n; i++) {
+        double t = s + arr[i];
+        double z = t - s;
+        c += (s - (t - z)) + (arr[i] - z);
+        s = t;
+    }
+    return s + c;
+}
+
+// 向量版TwoSum：s += x，舍入误差累加到c
+__attribute__((target("avx2")))
+inline void two_sum_avx2(__m256d& s, __m256d& c, __m256d x) {
+    __m256d t = _mm256_add_pd(s, x);
+    __m256d z = _mm256_sub_pd(t, s);
+    c = _mm256_add_pd(c, _mm256_add_pd(_mm256_sub_pd(s, _mm256_sub_pd(t, z)), _mm256_sub_pd(x, z)));
+    s = t;
+}
+
+__attribute__((target("avx2")))
+inline double sum_compensated_avx2(const double* arr, int n) {
+    __m256d s0 = _mm256_setzero_pd(), c0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd(), c1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd(), c2 = _mm256_setzero_pd();
+    __m256d s3 = _mm256_setzero_pd(), c3 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 15 < n; i += 16) {
+        __m256d x0 = _mm256_loadu_pd(arr + i);
+        __m256d x1 = _mm256_loadu_pd(arr + i + 4);
+        __m256d x2 = _mm256_loadu_pd(arr + i + 8);
+        __m256d x3 = _mm256_loadu_pd(arr + i + 12);
+        two_sum_avx2(s0, c0, x0);
+        two_sum_avx2(s1, c1, x1);
+        two_sum_avx2(s2, c2, x2);
+        two_sum_avx2(s3, c3, x3);
+    }
+    double sums[17], comps[17];
+    _mm256_storeu_pd(sums, s0);      _mm256_storeu_pd(comps, c0);
+    _mm256_storeu_pd(sums + 4, s1);  _mm256_storeu_pd(comps + 4, c1);
+    _mm256_storeu_pd(sums + 8, s2);  _mm256_storeu_pd(comps + 8, c2);
+    _mm256_storeu_pd(sums + 12, s3); _mm256_storeu_pd(comps + 12, c3);
+
+    // 剩余元素用标量补偿求和，作为第17个通道
+    sums[16] = 0.0;
+    comps[16] = 0.0;
+    for (; i < n; i++) {
+        double t = sums[16] + arr[i];
+        double z = t - sums[16];
+        comps[16] += (sums[16] - (t - z)) + (arr[i] - z);
+        sums[16] = t;
+    }
+    return combine_compensated(sums, comps, 17);
+}
+
+__attribute__((target("avx512f")))
+inline void two_sum_avx512(__m512d& s, __m512d& c, __m512d x) {
+    __m512d t = _mm512_add_pd(s, x);
+    __m512d z = _mm512_sub_pd(t, s);
+    c = _mm512_add_pd(c, _mm512_add_pd(_mm512_sub_pd(s, _mm512_sub_pd(t, z)), _mm512_sub_pd(x, z)));
+    s = t;
+}
+
+__attribute__((target("avx512f")))
+inline double sum_compensated_avx512(const double* arr, int n) {
+    __m512d s0 = _mm512_setzero_pd(), c0 = _mm512_setzero_pd();
+    __m512d s1 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+    __m512d s2 = _mm512_setzero_pd(), c2 = _mm512_setzero_pd();
+    __m512d s3 = _mm512_setzero_pd(), c3 = _mm512_setzero_pd();
+    int i = 0;
+    for (; i + 31 < n; i += 32) {
+        __m512d x0 = _mm512_loadu_pd(arr + i);
+        __m512d x1 = _mm512_loadu_pd(arr + i + 8);
+        __m512d x2 = _mm512_loadu_pd(arr + i + 16);
+        __m512d x3 = _mm512_loadu_pd(arr + i + 24);
+        two_sum_avx512(s0, c0, x0);
+        two_sum_avx512(s1, c1, x1);
+        two_sum_avx512(s2, c2, x2);
+        two_sum_avx512(s3, c3, x3);
+    }
+    // 尾部掩码加载，被屏蔽的通道加0，TwoSum对加0是精确的
+    for (; i < n; i += 8) {
+        __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8)((1u << (n - i)) - 1);
+        __m512d x = _mm512_maskz_loadu_pd(mask, arr + i);
+        two_sum_avx512(s0, c0, x);
+    }
+    double sums[32], comps[32];
+    _mm512_storeu_pd(sums, s0);      _mm512_storeu_pd(comps, c0);
+    _mm512_storeu_pd(sums + 8, s1);  _mm512_storeu_pd(comps + 8, c1);
+    _mm512_storeu_pd(sums + 16, s2); _mm512_storeu_pd(comps + 16, c2);
+    _mm512_storeu_pd(sums + 24, s3); _mm512_storeu_pd(comps + 24, c3);
+    return combine_compensated(sums, comps, 32);
+}
+
+// 返回指定指令集的补偿求和函数，只有AVX2和AVX-512版本，其余返回nullptr
+inline SumKernel compensated_kernel_for(SimdLevel level) {
+    if (!simd_supported(level)) return nullptr;
+    switch (level) {
+        case SIMD_AVX2: return sum_compensated_avx2;
+        case SIMD_AVX512: return sum_compensated_avx512;
+        default: return nullptr;
+    }
+}
+
+// 运行时分派，不支持AVX2时退回标量Neumaier
+inline double sum_compensated(const double* arr, int n) {
+    static SumKernel kernel = compensated_kernel_for(detect_simd_level());
+    if (kernel == nullptr) return sum_neumaier(arr, n);
+    return kernel(arr, n);
+}
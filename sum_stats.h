@@ -0,0 +1,470 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <immintrin.h>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include "cpu_features.h"
+#include "sum_parallel.h"
+#include "thread_pool.h"
+
+// 融合多统计量规约：一遍读数组同时求和、最小/最大值及其下标、平方和、与第二个数组的点积
+// 分别调用各自的循环时，超出缓存的数组每个统计量都要从内存完整读一遍；融合后只读一遍，
+// 受内存带宽限制时总时间接近单个统计量的时间
+//
+// 要算的统计量由位掩码选择；每种掩码由模板在编译期生成一个内核(不需要的累加器和比较不会出现在循环里)，
+// 运行时按掩码查表。每个指令集版本都用两组独立的累加器，最小/最大值逐通道比较并记录下标；
+// 相等时取下标较小者(与顺序扫描的第一次出现一致)，NaN不参与最小/最大值
+
+enum StatFlag {
+    STAT_SUM = 1,
+    STAT_MIN = 2,
+    STAT_MAX = 4,
+    STAT_ARGMIN = 8,   // 隐含STAT_MIN
+    STAT_ARGMAX = 16,  // 隐含STAT_MAX
+    STAT_SUMSQ = 32,   // 平方和
+    STAT_DOT = 64      // 与第二个数组y的点积
+};
+
+const unsigned STAT_ALL = 127;
+const int STAT_FLAG_COUNT = 7;
+
+inline const char* stat_flag_name(unsigned flag) {
+    switch (flag) {
+        case STAT_SUM: return "sum";
+        case STAT_MIN: return "min";
+        case STAT_MAX: return "max";
+        case STAT_ARGMIN: return "argmin";
+        case STAT_ARGMAX: return "argmax";
+        case STAT_SUMSQ: return "sumsq";
+        case STAT_DOT: return "dot";
+        default: return "unknown";
+    }
+}
+
+// 逗号分隔的统计量名称(all为全部)，无法识别时返回0
+inline unsigned parse_stat_mask(const std::string& text) {
+    unsigned mask = 0;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        std::string item = text.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        unsigned flag = item == "all" ? STAT_ALL : 0;
+        for (int b = 0; b < STAT_FLAG_COUNT; b++) {
+            if (item == stat_flag_name(1u << b)) flag = 1u << b;
+        }
+        if (flag == 0) return 0;
+        mask |= flag;
+        if (comma == std::string::npos) break;
+        start = comma + 1;
+    }
+    return mask;
+}
+
+inline std::string stat_mask_name(unsigned mask) {
+    std::string name;
+    for (int b = 0; b < STAT_FLAG_COUNT; b++) {
+        if (!(mask & (1u << b))) continue;
+        if (!name.empty()) name += "+";
+        name += stat_flag_name(1u << b);
+    }
+    return name;
+}
+
+// 未选择的统计量保持初始值；数组为空时min为+inf、max为-inf、下标为-1
+struct alignas(64) ArrayStats {
+    double sum = 0.0;
+    double sumsq = 0.0;
+    double dot = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    long long argmin = -1;
+    long long argmax = -1;
+};
+
+// 把紧接在a之后、起始下标为offset的一段的结果b合并到a中
+inline void merge_stats(ArrayStats& a, const ArrayStats& b, long long offset) {
+    a.sum += b.sum;
+    a.sumsq += b.sumsq;
+    a.dot += b.dot;
+    if (b.min < a.min || (a.argmin < 0 && b.argmin >= 0 && !(a.min < b.min))) {
+        a.min = b.min;
+        a.argmin = b.argmin >= 0 ? b.argmin + offset : -1;
+    }
+    if (b.max > a.max || (a.argmax < 0 && b.argmax >= 0 && !(a.max > b.max))) {
+        a.max = b.max;
+        a.argmax = b.argmax >= 0 ? b.argmax + offset : -1;
+    }
+}
+
+// 向量通道的最值和下标规约：值相等时取下标较小者
+inline void reduce_lanes(const double* values, const long long* indices, int lanes, bool minimum,
+                         double& best, long long& best_index) {
+    for (int l = 0; l < lanes; l++) {
+        double v = values[l];
+        bool better = minimum ? v < best : v > best;
+        if (better || (v == best && indices[l] >= 0 && (best_index < 0 || indices[l] < best_index))) {
+            best = v;
+            best_index = indices[l];
+        }
+    }
+}
+
+// 8个通道两两相加
+inline double lane_total8(const double* lanes) {
+    return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+template <unsigned Mask>
+inline ArrayStats stats_scalar(const double* x, const double* y, int n) {
+    constexpr bool want_min = Mask & (STAT_MIN | STAT_ARGMIN);
+    constexpr bool want_max = Mask & (STAT_MAX | STAT_ARGMAX);
+    ArrayStats s;
+    for (int i = 0; i < n; i++) {
+        double v = x[i];
+        if constexpr ((Mask & STAT_SUM) != 0) s.sum += v;
+        if constexpr ((Mask & STAT_SUMSQ) != 0) s.sumsq += v * v;
+        if constexpr ((Mask & STAT_DOT) != 0) s.dot += v * y[i];
+        if constexpr (want_min) {
+            if (v < s.min) {
+                s.min = v;
+                if constexpr ((Mask & STAT_ARGMIN) != 0) s.argmin = i;
+            }
+        }
+        if constexpr (want_max) {
+            if (v > s.max) {
+                s.max = v;
+                if constexpr ((Mask & STAT_ARGMAX) != 0) s.argmax = i;
+            }
+        }
+    }
+    return s;
+}
+
+template <unsigned Mask>
+__attribute__((target("avx2,fma")))
+inline ArrayStats stats_avx2(const double* x, const double* y, int n) {
+    constexpr bool want_min = Mask & (STAT_MIN | STAT_ARGMIN);
+    constexpr bool want_max = Mask & (STAT_MAX | STAT_ARGMAX);
+    constexpr bool want_index = Mask & (STAT_ARGMIN | STAT_ARGMAX);
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d sum0 = zero, sum1 = zero, sq0 = zero, sq1 = zero, dot0 = zero, dot1 = zero;
+    __m256d min0 = _mm256_set1_pd(std::numeric_limits<double>::infinity()), min1 = min0;
+    __m256d max0 = _mm256_set1_pd(-std::numeric_limits<double>::infinity()), max1 = max0;
+    __m256i minidx0 = _mm256_set1_epi64x(-1), minidx1 = minidx0, maxidx0 = minidx0, maxidx1 = minidx0;
+    __m256i idx0 = _mm256_set_epi64x(3, 2, 1, 0);
+    __m256i idx1 = _mm256_set_epi64x(7, 6, 5, 4);
+    const __m256i step = _mm256_set1_epi64x(8);
+    int i = 0;
+    for (; i + 7 < n; i += 8) {
+        __m256d a = _mm256_loadu_pd(x + i);
+        __m256d b = _mm256_loadu_pd(x + i + 4);
+        if constexpr ((Mask & STAT_SUM) != 0) {
+            sum0 = _mm256_add_pd(sum0, a);
+            sum1 = _mm256_add_pd(sum1, b);
+        }
+        if constexpr ((Mask & STAT_SUMSQ) != 0) {
+            sq0 = _mm256_fmadd_pd(a, a, sq0);
+            sq1 = _mm256_fmadd_pd(b, b, sq1);
+        }
+        if constexpr ((Mask & STAT_DOT) != 0) {
+            dot0 = _mm256_fmadd_pd(a, _mm256_loadu_pd(y + i), dot0);
+            dot1 = _mm256_fmadd_pd(b, _mm256_loadu_pd(y + i + 4), dot1);
+        }
+        if constexpr (want_min) {
+            if constexpr ((Mask & STAT_ARGMIN) != 0) {
+                __m256d m0 = _mm256_cmp_pd(a, min0, _CMP_LT_OQ);
+                __m256d m1 = _mm256_cmp_pd(b, min1, _CMP_LT_OQ);
+                min0 = _mm256_blendv_pd(min0, a, m0);
+                min1 = _mm256_blendv_pd(min1, b, m1);
+                minidx0 = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(minidx0), _mm256_castsi256_pd(idx0), m0));
+                minidx1 = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(minidx1), _mm256_castsi256_pd(idx1), m1));
+            } else {
+                // 第一个操作数为NaN时minpd返回第二个操作数，NaN被跳过
+                min0 = _mm256_min_pd(a, min0);
+                min1 = _mm256_min_pd(b, min1);
+            }
+        }
+        if constexpr (want_max) {
+            if constexpr ((Mask & STAT_ARGMAX) != 0) {
+                __m256d m0 = _mm256_cmp_pd(a, max0, _CMP_GT_OQ);
+                __m256d m1 = _mm256_cmp_pd(b, max1, _CMP_GT_OQ);
+                max0 = _mm256_blendv_pd(max0, a, m0);
+                max1 = _mm256_blendv_pd(max1, b, m1);
+                maxidx0 = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(maxidx0), _mm256_castsi256_pd(idx0), m0));
+                maxidx1 = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(maxidx1), _mm256_castsi256_pd(idx1), m1));
+            } else {
+                max0 = _mm256_max_pd(a, max0);
+                max1 = _mm256_max_pd(b, max1);
+            }
+        }
+        if constexpr (want_index) {
+            idx0 = _mm256_add_epi64(idx0, step);
+            idx1 = _mm256_add_epi64(idx1, step);
+        }
+    }
+
+    ArrayStats s;
+    double lanes[8];
+    long long indices[8];
+    if constexpr ((Mask & STAT_SUM) != 0) {
+        _mm256_storeu_pd(lanes, _mm256_add_pd(sum0, sum1));
+        s.sum = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+    }
+    if constexpr ((Mask & STAT_SUMSQ) != 0) {
+        _mm256_storeu_pd(lanes, _mm256_add_pd(sq0, sq1));
+        s.sumsq = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+    }
+    if constexpr ((Mask & STAT_DOT) != 0) {
+        _mm256_storeu_pd(lanes, _mm256_add_pd(dot0, dot1));
+        s.dot = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+    }
+    if constexpr (want_min) {
+        _mm256_storeu_pd(lanes, min0);
+        _mm256_storeu_pd(lanes + 4, min1);
+        _mm256_storeu_si256((__m256i*)indices, minidx0);
+        _mm256_storeu_si256((__m256i*)(indices + 4), minidx1);
+        reduce_lanes(lanes, indices, 8, true, s.min, s.argmin);
+    }
+    if constexpr (want_max) {
+        _mm256_storeu_pd(lanes, max0);
+        _mm256_storeu_pd(lanes + 4, max1);
+        _mm256_storeu_si256((__m256i*)indices, maxidx0);
+        _mm256_storeu_si256((__m256i*)(indices + 4), maxidx1);
+        reduce_lanes(lanes, indices, 8, false, s.max, s.argmax);
+    }
+
+    // 处理剩余元素
+    merge_stats(s, stats_scalar<Mask>(x + i, (Mask & STAT_DOT) != 0 ? y + i : y, n - i), i);
+    return s;
+}
+
+template <unsigned Mask>
+__attribute__((target("avx512f")))
+inline ArrayStats stats_avx512(const double* x, const double* y, int n) {
+    constexpr bool want_min = Mask & (STAT_MIN | STAT_ARGMIN);
+    constexpr bool want_max = Mask & (STAT_MAX | STAT_ARGMAX);
+    constexpr bool want_index = Mask & (STAT_ARGMIN | STAT_ARGMAX);
+    const __m512d zero = _mm512_setzero_pd();
+    __m512d sum0 = zero, sum1 = zero, sq0 = zero, sq1 = zero, dot0 = zero, dot1 = zero;
+    __m512d min0 = _mm512_set1_pd(std::numeric_limits<double>::infinity()), min1 = min0;
+    __m512d max0 = _mm512_set1_pd(-std::numeric_limits<double>::infinity()), max1 = max0;
+    __m512i minidx0 = _mm512_set1_epi64(-1), minidx1 = minidx0, maxidx0 = minidx0, maxidx1 = minidx0;
+    __m512i idx0 = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    __m512i idx1 = _mm512_set_epi64(15, 14, 13, 12, 11, 10, 9, 8);
+    const __m512i step = _mm512_set1_epi64(16);
+    int i = 0;
+    for (; i + 15 < n; i += 16) {
+        __m512d a = _mm512_loadu_pd(x + i);
+        __m512d b = _mm512_loadu_pd(x + i + 8);
+        if constexpr ((Mask & STAT_SUM) != 0) {
+            sum0 = _mm512_add_pd(sum0, a);
+            sum1 = _mm512_add_pd(sum1, b);
+        }
+        if constexpr ((Mask & STAT_SUMSQ) != 0) {
+            sq0 = _mm512_fmadd_pd(a, a, sq0);
+            sq1 = _mm512_fmadd_pd(b, b, sq1);
+        }
+        if constexpr ((Mask & STAT_DOT) != 0) {
+            dot0 = _mm512_fmadd_pd(a, _mm512_loadu_pd(y + i), dot0);
+            dot1 = _mm512_fmadd_pd(b, _mm512_loadu_pd(y + i + 8), dot1);
+        }
+        if constexpr (want_min) {
+            if constexpr ((Mask & STAT_ARGMIN) != 0) {
+                __mmask8 m0 = _mm512_cmp_pd_mask(a, min0, _CMP_LT_OQ);
+                __mmask8 m1 = _mm512_cmp_pd_mask(b, min1, _CMP_LT_OQ);
+                min0 = _mm512_mask_mov_pd(min0, m0, a);
+                min1 = _mm512_mask_mov_pd(min1, m1, b);
+                minidx0 = _mm512_mask_mov_epi64(minidx0, m0, idx0);
+                minidx1 = _mm512_mask_mov_epi64(minidx1, m1, idx1);
+            } else {
+                min0 = _mm512_mask_min_pd(min0, 0xFF, a, min0);
+                min1 = _mm512_mask_min_pd(min1, 0xFF, b, min1);
+            }
+        }
+        if constexpr (want_max) {
+            if constexpr ((Mask & STAT_ARGMAX) != 0) {
+                __mmask8 m0 = _mm512_cmp_pd_mask(a, max0, _CMP_GT_OQ);
+                __mmask8 m1 = _mm512_cmp_pd_mask(b, max1, _CMP_GT_OQ);
+                max0 = _mm512_mask_mov_pd(max0, m0, a);
+                max1 = _mm512_mask_mov_pd(max1, m1, b);
+                maxidx0 = _mm512_mask_mov_epi64(maxidx0, m0, idx0);
+                maxidx1 = _mm512_mask_mov_epi64(maxidx1, m1, idx1);
+            } else {
+                max0 = _mm512_mask_max_pd(max0, 0xFF, a, max0);
+                max1 = _mm512_mask_max_pd(max1, 0xFF, b, max1);
+            }
+        }
+        if constexpr (want_index) {
+            idx0 = _mm512_add_epi64(idx0, step);
+            idx1 = _mm512_add_epi64(idx1, step);
+        }
+    }
+    // 不足16个的尾部用掩码加载，并入第一组累加器；被掩掉的通道加载为0，且不参与比较
+    for (; i < n; i += 8) {
+        __mmask8 tail = n - i >= 8 ? 0xFF : (__mmask8)((1u << (n - i)) - 1);
+        __m512d a = _mm512_maskz_loadu_pd(tail, x + i);
+        if constexpr ((Mask & STAT_SUM) != 0) sum0 = _mm512_add_pd(sum0, a);
+        if constexpr ((Mask & STAT_SUMSQ) != 0) sq0 = _mm512_fmadd_pd(a, a, sq0);
+        if constexpr ((Mask & STAT_DOT) != 0) dot0 = _mm512_fmadd_pd(a, _mm512_maskz_loadu_pd(tail, y + i), dot0);
+        if constexpr (want_min) {
+            __mmask8 m = _mm512_mask_cmp_pd_mask(tail, a, min0, _CMP_LT_OQ);
+            min0 = _mm512_mask_mov_pd(min0, m, a);
+            if constexpr ((Mask & STAT_ARGMIN) != 0) minidx0 = _mm512_mask_mov_epi64(minidx0, m, idx0);
+        }
+        if constexpr (want_max) {
+            __mmask8 m = _mm512_mask_cmp_pd_mask(tail, a, max0, _CMP_GT_OQ);
+            max0 = _mm512_mask_mov_pd(max0, m, a);
+            if constexpr ((Mask & STAT_ARGMAX) != 0) maxidx0 = _mm512_mask_mov_epi64(maxidx0, m, idx0);
+        }
+        if constexpr (want_index) idx0 = _mm512_add_epi64(idx0, _mm512_set1_epi64(8));
+    }
+
+    ArrayStats s;
+    double lanes[16];
+    long long indices[16];
+    if constexpr ((Mask & STAT_SUM) != 0) {
+        _mm512_storeu_pd(lanes, _mm512_add_pd(sum0, sum1));
+        s.sum = lane_total8(lanes);
+    }
+    if constexpr ((Mask & STAT_SUMSQ) != 0) {
+        _mm512_storeu_pd(lanes, _mm512_add_pd(sq0, sq1));
+        s.sumsq = lane_total8(lanes);
+    }
+    if constexpr ((Mask & STAT_DOT) != 0) {
+        _mm512_storeu_pd(lanes, _mm512_add_pd(dot0, dot1));
+        s.dot = lane_total8(lanes);
+    }
+    if constexpr (want_min) {
+        _mm512_storeu_pd(lanes, min0);
+        _mm512_storeu_pd(lanes + 8, min1);
+        _mm512_storeu_si512(indices, minidx0);
+        _mm512_storeu_si512(indices + 8, minidx1);
+        reduce_lanes(lanes, indices, 16, true, s.min, s.argmin);
+    }
+    if constexpr (want_max) {
+        _mm512_storeu_pd(lanes, max0);
+        _mm512_storeu_pd(lanes + 8, max1);
+        _mm512_storeu_si512(indices, maxidx0);
+        _mm512_storeu_si512(indices + 8, maxidx1);
+        reduce_lanes(lanes, indices, 16, false, s.max, s.argmax);
+    }
+    return s;
+}
+
+// ---------------- 分派 ----------------
+
+// x为输入，y仅在选择STAT_DOT时使用(长度同x)
+typedef ArrayStats (*StatsKernel)(const double* x, const double* y, int n);
+
+// 每个指令集一张表，下标为掩码，表项为该掩码在编译期生成的内核
+template <size_t... M>
+inline const StatsKernel* stats_scalar_table(std::index_sequence<M...>) {
+    static const StatsKernel table[] = {stats_scalar<M>...};
+    return table;
+}
+
+template <size_t... M>
+inline const StatsKernel* stats_avx2_table(std::index_sequence<M...>) {
+    static const StatsKernel table[] = {stats_avx2<M>...};
+    return table;
+}
+
+template <size_t... M>
+inline const StatsKernel* stats_avx512_table(std::index_sequence<M...>) {
+    static const StatsKernel table[] = {stats_avx512<M>...};
+    return table;
+}
+
+// 返回指定指令集的内核表，不支持时返回nullptr；SSE2使用标量版本
+inline const StatsKernel* stats_table_for(SimdLevel level) {
+    if (!simd_supported(level)) return nullptr;
+    switch (level) {
+        case SIMD_AVX2: return stats_avx2_table(std::make_index_sequence<STAT_ALL + 1>());
+        case SIMD_AVX512: return stats_avx512_table(std::make_index_sequence<STAT_ALL + 1>());
+        default: return stats_scalar_table(std::make_index_sequence<STAT_ALL + 1>());
+    }
+}
+
+// 运行时分派：首次调用时根据cpuid选出最宽的可用版本
+inline ArrayStats array_stats(const double* x, const double* y, int n, unsigned mask) {
+    static const StatsKernel* table = [] {
+        const StatsKernel* best = stats_table_for(SIMD_AVX512);
+        if (best == nullptr) best = stats_table_for(SIMD_AVX2);
+        if (best == nullptr) best = stats_table_for(SIMD_SCALAR);
+        return best;
+    }();
+    return table[mask & STAT_ALL](x, y, n);
+}
+
+// 分别调用时实际要调用的统计量：argmin/argmax已经给出最值，不再单独调用min/max
+inline unsigned stats_separate_mask(unsigned mask) {
+    mask &= STAT_ALL;
+    if (mask & STAT_ARGMIN) mask &= ~(unsigned)STAT_MIN;
+    if (mask & STAT_ARGMAX) mask &= ~(unsigned)STAT_MAX;
+    return mask;
+}
+
+// 对比基准：每个选中的统计量单独调用一次(各自读一遍数组)，结果合并成一个ArrayStats
+inline ArrayStats array_stats_separate(const double* x, const double* y, int n, unsigned mask) {
+    ArrayStats s;
+    mask = stats_separate_mask(mask);
+    for (int b = 0; b < STAT_FLAG_COUNT; b++) {
+        unsigned flag = 1u << b;
+        if (!(mask & flag)) continue;
+        ArrayStats one = array_stats(x, y, n, flag);
+        switch (flag) {
+            case STAT_SUM: s.sum = one.sum; break;
+            case STAT_SUMSQ: s.sumsq = one.sumsq; break;
+            case STAT_DOT: s.dot = one.dot; break;
+            case STAT_MIN: s.min = one.min; break;
+            case STAT_MAX: s.max = one.max; break;
+            case STAT_ARGMIN: s.min = one.min; s.argmin = one.argmin; break;
+            case STAT_ARGMAX: s.max = one.max; s.argmax = one.argmax; break;
+        }
+    }
+    return s;
+}
+
+// 读数组的遍数：融合时x只读一遍，分别调用时每个实际调用的统计量读一遍(默认all为5遍)；点积另读y一遍
+inline int stats_passes(unsigned mask, bool fused) {
+    int passes = fused ? 1 : __builtin_popcount(stats_separate_mask(mask));
+    return (mask & STAT_DOT) ? passes + 1 : passes;
+}
+
+// 每个元素的运算次数：加法、比较各1次，平方和与点积各2次(乘加)
+inline double stats_flops_per_element(unsigned mask) {
+    double flops = 0.0;
+    if (mask & STAT_SUM) flops += 1;
+    if (mask & (STAT_MIN | STAT_ARGMIN)) flops += 1;
+    if (mask & (STAT_MAX | STAT_ARGMAX)) flops += 1;
+    if (mask & STAT_SUMSQ) flops += 2;
+    if (mask & STAT_DOT) flops += 2;
+    return flops;
+}
+
+// 低于该元素数时唤醒线程的开销超过规约本身，多线程版本直接在调用线程上计算
+const int STATS_PARALLEL_MIN = 1 << 16;
+
+// 多线程融合规约：每个线程对自己那段(按页划分，同sum_parallel)做一遍融合规约，结果按线程顺序合并；
+// partials至少pool.size()个
+inline ArrayStats array_stats_parallel(ThreadPool& pool, const double* x, const double* y, int n, unsigned mask,
+                                       ArrayStats* partials) {
+    int num_threads = pool.size();
+    if (num_threads == 1 || n < STATS_PARALLEL_MIN) return array_stats(x, y, n, mask);
+    pool.run([&](int tid) {
+        int begin, end;
+        thread_chunk(n, num_threads, tid, begin, end);
+        partials[tid] = array_stats(x + begin, y != nullptr ? y + begin : nullptr, end - begin, mask);
+    });
+    ArrayStats s = partials[0];
+    for (int t = 1; t < num_threads; t++) {
+        int begin, end;
+        thread_chunk(n, num_threads, t, begin, end);
+        merge_stats(s, partials[t], begin);
+    }
+    return s;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "sum_simd.h"
+
+// 编译期展开的求和内核：每次迭代处理UNROLL个元素，分给ACC个独立累加器
+// (第k个元素加到第k%ACC个累加器上，同一累加器内的元素先从左到右相加再累加)。
+// ACC=1时与手写的4路/8路展开加法顺序完全相同；ACC>1时多条加法依赖链并行，
+// 不再受单个累加器加法延迟的限制，但加法顺序改变，结果可能与平凡算法相差几个ulp
+
+// 第FIRST、FIRST+STRIDE、FIRST+2*STRIDE...个元素从左到右相加
+template <size_t FIRST, size_t STRIDE, size_t... Ks>
+inline double strided_sum(const double* p, std::index_sequence<Ks...>) {
+    return (... + p[FIRST + Ks * STRIDE]);
+}
+
+template <int UNROLL, size_t... As>
+inline void accumulate_block(const double* p, double* acc, std::index_sequence<As...>) {
+    constexpr size_t ACC = sizeof...(As);
+    ((acc[As] += strided_sum<As, ACC>(p, std::make_index_sequence<UNROLL / ACC>())), ...);
+}
+
+template <size_t... As>
+inline double combine_accumulators(const double* acc, std::index_sequence<As...>) {
+    return (... + acc[As]);
+}
+
+template <int UNROLL, int ACC>
+inline double sum_unrolled(const double* arr, int n) {
+    static_assert(UNROLL >= 1 && ACC >= 1 && UNROLL % ACC == 0, "展开路数必须是累加器个数的整数倍");
+    double acc[ACC] = {};
+    int i = 0;
+    for (; i + UNROLL - 1 < n; i += UNROLL) {
+        accumulate_block<UNROLL>(arr + i, acc, std::make_index_sequence<ACC>());
+    }
+    double sum = combine_accumulators(acc, std::make_index_sequence<ACC>());
+
+    // 处理剩余元素
+    for (; i < n; i++) {
+        sum += arr[i];
+    }
+    return sum;
+}
+
+// ---------------- 参数网格 ----------------
+
+struct UnrolledSum {
+    int unroll;
+    int accumulators;
+    SumKernel kernel;
+};
+
+template <int UNROLL, int ACC>
+inline void add_sum_config(std::vector<UnrolledSum>& grid) {
+    if constexpr (UNROLL % ACC == 0) grid.push_back({UNROLL, ACC, sum_unrolled<UNROLL, ACC>});
+}
+
+template <int UNROLL, int... ACCS>
+inline void add_sum_configs(std::vector<UnrolledSum>& grid) {
+    (add_sum_config<UNROLL, ACCS>(grid), ...);
+}
+
+// 展开路数1/2/4/6/8/12/16与能整除它的累加器个数的全部组合，按展开路数、累加器个数排序
+inline const std::vector<UnrolledSum>& sum_unroll_grid() {
+    static const std::vector<UnrolledSum> grid = [] {
+        std::vector<UnrolledSum> g;
+        add_sum_configs<1, 1>(g);
+        add_sum_configs<2, 1, 2>(g);
+        add_sum_configs<4, 1, 2, 4>(g);
+        add_sum_configs<6, 1, 2, 3, 6>(g);
+        add_sum_configs<8, 1, 2, 4, 8>(g);
+        add_sum_configs<12, 1, 2, 3, 4, 6, 12>(g);
+        add_sum_configs<16, 1, 2, 4, 8, 16>(g);
+        return g;
+    }();
+    return grid;
+}
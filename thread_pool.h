@@ -0,0 +1,160 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+// 当前进程允许运行的CPU列表(受taskset/容器cpuset限制)
+// 第一次调用时读取一次并缓存：之后调用线程可能被线程池或ScopedPin绑定到单个CPU，
+// 再读sched_getaffinity(0)得到的只是该线程收窄后的亲和性
+inline std::vector<int> allowed_cpus() {
+    static const std::vector<int> snapshot = [] {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int c = 0; c < CPU_SETSIZE; c++) {
+                if (CPU_ISSET(c, &set)) cpus.push_back(c);
+            }
+        }
+        if (cpus.empty()) cpus.push_back(0);
+        return cpus;
+    }();
+    return snapshot;
+}
+
+// 将线程绑定到指定CPU，失败时保持原亲和性
+inline bool pin_thread(pthread_t thread, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+// 固定线程数的线程池，run()在所有线程上执行同一任务并等待全部完成
+// 调用线程作为0号线程参与计算，工作线程编号为1..size()-1
+// pin为true时第t号线程绑定到第t个允许的CPU(超出CPU数时循环使用)；
+// 调用线程的亲和性在析构时恢复(同ScopedPin)
+class ThreadPool {
+public:
+    explicit ThreadPool(int num_threads, bool pin = true)
+        : num_threads_(num_threads < 1 ? 1 : num_threads) {
+        std::vector<int> cpus = allowed_cpus();
+        std::vector<int> thread_cpus;
+        for (int t = 0; t < num_threads_; t++) {
+            thread_cpus.push_back(cpus[t % cpus.size()]);
+        }
+        start(pin ? &thread_cpus : nullptr);
+    }
+
+    // 第t号线程绑定到thread_cpus[t]，线程数等于列表长度
+    explicit ThreadPool(const std::vector<int>& thread_cpus)
+        : num_threads_(thread_cpus.empty() ? 1 : (int)thread_cpus.size()) {
+        start(thread_cpus.empty() ? nullptr : &thread_cpus);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            generation_++;
+        }
+        start_cv_.notify_all();
+        for (std::thread& w : workers_) {
+            w.join();
+        }
+        if (caller_pinned_) pthread_setaffinity_np(caller_, sizeof(caller_mask_), &caller_mask_);
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return num_threads_; }
+
+    void run(const std::function<void(int)>& task) {
+        if (num_threads_ == 1) {
+            task(0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &task;
+            pending_ = num_threads_ - 1;
+            generation_++;
+        }
+        start_cv_.notify_all();
+        task(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] { return pending_ == 0; });
+        task_ = nullptr;
+    }
+
+private:
+    void start(const std::vector<int>* thread_cpus) {
+        if (thread_cpus != nullptr) {
+            caller_ = pthread_self();
+            CPU_ZERO(&caller_mask_);
+            if (pthread_getaffinity_np(caller_, sizeof(caller_mask_), &caller_mask_) == 0) {
+                caller_pinned_ = pin_thread(caller_, (*thread_cpus)[0]);
+            }
+        }
+        for (int t = 1; t < num_threads_; t++) {
+            workers_.emplace_back(&ThreadPool::worker_loop, this, t);
+            if (thread_cpus != nullptr) {
+                pin_thread(workers_.back().native_handle(), (*thread_cpus)[t]);
+            }
+        }
+    }
+
+    void worker_loop(int tid) {
+        unsigned long seen = 0;
+        while (true) {
+            const std::function<void(int)>* task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_cv_.wait(lock, [this, seen] { return generation_ != seen; });
+                seen = generation_;
+                if (stop_) return;
+                task = task_;
+            }
+            (*task)(tid);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_--;
+            }
+            done_cv_.notify_one();
+        }
+    }
+
+    int num_threads_;
+    pthread_t caller_;
+    cpu_set_t caller_mask_;
+    bool caller_pinned_ = false;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(int)>* task_ = nullptr;
+    unsigned long generation_ = 0;
+    int pending_ = 0;
+    bool stop_ = false;
+};
+
+// 把[0, total)均分给num_parts段，返回第part段的[begin, end)
+// align>1时段边界按align对齐(如按缓存行划分结果向量，避免伪共享)
+inline void split_range(int total, int num_parts, int part, int align, int& begin, int& end) {
+    int units = (total + align - 1) / align;
+    int base = units / num_parts;
+    int extra = units % num_parts;
+    int first = part * base + (part < extra ? part : extra);
+    int count = base + (part < extra ? 1 : 0);
+    begin = first * align;
+    end = (first + count) * align;
+    if (begin > total) begin = total;
+    if (end > total) end = total;
+}